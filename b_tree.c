@@ -0,0 +1,783 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "b_tree.h"
+#include "memory.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The size of a cache line in bytes, the alignment of the nodes
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * The smallest capacity of a node, so splits and merges always leave non empty nodes
+ */
+#define MIN_CAPACITY 3
+
+/**
+ * The largest height of a tree, enough for any tree that fits in memory since every branch has at least two children
+ */
+#define MAX_HEIGHT 64
+
+/**
+ * The header of a node
+ * A leaf is followed by its values, a branch by its children and then by its separators.
+ * Separator i is a copy of the smallest value below child i + 1, so it is always equal to a value in the tree.
+ */
+struct b_tree_node{
+
+  /**
+   * The number of values of a leaf or separators of a branch
+   */
+  unsigned int count;
+
+  /**
+   * Whether the node is a leaf
+   */
+  bool leaf;
+
+  /**
+   * The previous leaf, only used for leaves
+   */
+  struct b_tree_node * previous;
+
+  /**
+   * The next leaf, only used for leaves
+   */
+  struct b_tree_node * next;
+};
+
+/**
+ * The default free function (does nothing)
+ */
+static void default_free_value(struct b_tree * tree, void * value){}
+
+/*
+ * Helper methods
+ */
+
+static inline struct b_tree_node ** get_children(struct b_tree_node * node){
+  return (struct b_tree_node **)(node + 1);
+}
+
+/**
+ * Returns the values of a leaf or the separators of a branch
+ */
+static inline char * get_items(const struct b_tree * tree, struct b_tree_node * node){
+  if(node->leaf){
+    return (char *)(node + 1);
+  }else{
+    return (char *)(get_children(node) + tree->branch_capacity + 1);
+  }
+}
+
+static inline char * get_item(const struct b_tree * tree, struct b_tree_node * node, size_t index){
+  return get_items(tree, node) + index * tree->item_size;
+}
+
+static inline size_t get_capacity(const struct b_tree * tree, struct b_tree_node * node){
+  return node->leaf ? tree->leaf_capacity : tree->branch_capacity;
+}
+
+/**
+ * Returns the smallest number of items a node other than the root must hold
+ * Splitting a full branch leaves (capacity - 1) / 2 separators in the new one.
+ */
+static inline size_t get_minimum(const struct b_tree * tree, struct b_tree_node * node){
+  return node->leaf ? tree->leaf_capacity / 2 : (tree->branch_capacity - 1) / 2;
+}
+
+static struct b_tree_node * create_node(struct b_tree * tree, bool leaf){
+  struct b_tree_node * node = malloc_aligned_checked(CACHE_LINE_SIZE, tree->node_size);
+  node->count = 0;
+  node->leaf = leaf;
+  node->previous = NULL;
+  node->next = NULL;
+  return node;
+}
+
+/**
+ * Binary searches the items of a node
+ * @param found set to true if the item at the returned index is equal to the value
+ * @return the index of the first item not smaller than the value
+ */
+static size_t search(const struct b_tree * tree, struct b_tree_node * node, void * value, bool * found){
+  char * items = get_items(tree, node);
+  size_t low = 0;
+  size_t high = node->count;
+  while(low < high){
+    size_t middle = low + (high - low) / 2;
+    int cmp = (*tree->cmp_value)(tree, items + middle * tree->item_size, value);
+    if(cmp < 0){
+      low = middle + 1;
+    }else if(cmp > 0){
+      high = middle;
+    }else{
+      *found = true;
+      return middle;
+    }
+  }
+  *found = false;
+  return low;
+}
+
+/**
+ * Finds the child of a branch whose values may contain a value
+ * @param equal set to the separator equal to the value or left unchanged
+ */
+static size_t find_child(const struct b_tree * tree, struct b_tree_node * branch, void * value, char ** equal){
+  bool found;
+  size_t index = search(tree, branch, value, &found);
+  if(found){
+    *equal = get_item(tree, branch, index);
+    return index + 1;
+  }else{
+    return index;
+  }
+}
+
+static struct b_tree_node * get_first_leaf(const struct b_tree * tree){
+  struct b_tree_node * node = tree->root;
+  if(node != NULL){
+    while(!node->leaf){
+      node = get_children(node)[0];
+    }
+  }
+  return node;
+}
+
+/**
+ * Inserts an item at an index of a node that is not full
+ * For a branch, the child is inserted to the right of the separator
+ */
+static void insert_item(struct b_tree * tree, struct b_tree_node * node, size_t index, void * item, struct b_tree_node * child){
+  assert(node->count < get_capacity(tree, node));
+  char * items = get_items(tree, node);
+  size_t size = tree->item_size;
+  memmove(items + (index + 1) * size, items + index * size, (node->count - index) * size);
+  memcpy(items + index * size, item, tree->value_size);
+  if(!node->leaf){
+    struct b_tree_node ** children = get_children(node);
+    memmove(children + index + 2, children + index + 1, (node->count - index) * sizeof(struct b_tree_node *));
+    children[index + 1] = child;
+  }
+  ++node->count;
+}
+
+/**
+ * Removes the item at an index of a node
+ * For a branch, the child to the right of the separator is removed
+ */
+static void remove_item(struct b_tree * tree, struct b_tree_node * node, size_t index){
+  char * items = get_items(tree, node);
+  size_t size = tree->item_size;
+  memmove(items + index * size, items + (index + 1) * size, (node->count - index - 1) * size);
+  if(!node->leaf){
+    struct b_tree_node ** children = get_children(node);
+    memmove(children + index + 1, children + index + 2, (node->count - index - 1) * sizeof(struct b_tree_node *));
+  }
+  --node->count;
+}
+
+void b_tree_init(struct b_tree * tree, b_tree_cmp_f cmp_value, b_tree_apply_f free_value, void * state, size_t value_size){
+  assert(tree != NULL);
+  assert(cmp_value != NULL);
+  assert(value_size > 0);
+  tree->root = NULL;
+  tree->height = 0;
+  tree->size = 0;
+  tree->cmp_value = cmp_value;
+  tree->free_value = free_value == NULL ? default_free_value : free_value;
+  tree->state = state;
+  tree->value_size = value_size;
+  tree->item_size = (value_size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+
+  size_t header = sizeof(struct b_tree_node);
+  size_t space = B_TREE_NODE_SIZE - header;
+  tree->leaf_capacity = space / tree->item_size;
+  if(tree->leaf_capacity < MIN_CAPACITY){
+    tree->leaf_capacity = MIN_CAPACITY;
+  }
+  tree->branch_capacity = (space - sizeof(struct b_tree_node *)) / (tree->item_size + sizeof(struct b_tree_node *));
+  if(tree->branch_capacity < MIN_CAPACITY){
+    tree->branch_capacity = MIN_CAPACITY;
+  }
+  size_t leaf_size = header + tree->leaf_capacity * tree->item_size;
+  size_t branch_size = header + (tree->branch_capacity + 1) * sizeof(struct b_tree_node *) + tree->branch_capacity * tree->item_size;
+  size_t node_size = leaf_size > branch_size ? leaf_size : branch_size;
+  tree->node_size = (node_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  tree->separators = malloc_checked(2 * tree->item_size);
+}
+
+/*
+ * Insertion
+ */
+
+/**
+ * Moves the upper half of a full leaf to a new leaf linked after it
+ */
+static struct b_tree_node * split_leaf(struct b_tree * tree, struct b_tree_node * leaf){
+  struct b_tree_node * right = create_node(tree, true);
+  size_t middle = leaf->count / 2;
+  right->count = leaf->count - middle;
+  memcpy(get_items(tree, right), get_item(tree, leaf, middle), right->count * tree->item_size);
+  leaf->count = middle;
+  right->previous = leaf;
+  right->next = leaf->next;
+  if(leaf->next != NULL){
+    leaf->next->previous = right;
+  }
+  leaf->next = right;
+  return right;
+}
+
+/**
+ * Inserts the separator and the new node created by splitting a child along the path, splitting full branches on the way up
+ * @param path the branches from the root down to the parent of the split node
+ * @param indices the index of the child taken in each branch of the path
+ * @param depth the length of the path
+ * @param right the new node, its separator is the first of tree->separators
+ */
+static void insert_split(struct b_tree * tree, struct b_tree_node ** path, size_t * indices, size_t depth, struct b_tree_node * right){
+  char * separator = tree->separators;
+  char * up = separator + tree->item_size;
+  while(depth > 0){
+    --depth;
+    struct b_tree_node * branch = path[depth];
+    size_t index = indices[depth];
+    if(branch->count < tree->branch_capacity){
+      insert_item(tree, branch, index, separator, right);
+      return;
+    }
+
+    size_t middle = tree->branch_capacity / 2;
+    struct b_tree_node * sibling = create_node(tree, false);
+    sibling->count = branch->count - middle - 1;
+    memcpy(up, get_item(tree, branch, middle), tree->value_size);
+    memcpy(get_items(tree, sibling), get_item(tree, branch, middle + 1), sibling->count * tree->item_size);
+    memcpy(get_children(sibling), get_children(branch) + middle + 1, (sibling->count + 1) * sizeof(struct b_tree_node *));
+    branch->count = middle;
+    if(index <= middle){
+      insert_item(tree, branch, index, separator, right);
+    }else{
+      insert_item(tree, sibling, index - middle - 1, separator, right);
+    }
+
+    char * next = up;
+    up = separator;
+    separator = next;
+    right = sibling;
+  }
+
+  struct b_tree_node * root = create_node(tree, false);
+  root->count = 1;
+  memcpy(get_items(tree, root), separator, tree->value_size);
+  get_children(root)[0] = tree->root;
+  get_children(root)[1] = right;
+  tree->root = root;
+  ++tree->height;
+}
+
+/**
+ * Inserts a copy of a value
+ * @param replace whether the value replaces an equal value or is dropped
+ * @param found set to true if the tree held an equal value
+ * @return the copy or the equal value in the tree
+ */
+static void * insert_value(struct b_tree * tree, void * value, bool replace, bool * found){
+  if(tree->root == NULL){
+    tree->root = create_node(tree, true);
+    tree->height = 1;
+  }
+
+  struct b_tree_node * path[MAX_HEIGHT];
+  size_t indices[MAX_HEIGHT];
+  char * equal = NULL;
+  struct b_tree_node * node = tree->root;
+  size_t depth = 0;
+  while(!node->leaf){
+    size_t index = find_child(tree, node, value, &equal);
+    path[depth] = node;
+    indices[depth] = index;
+    ++depth;
+    node = get_children(node)[index];
+  }
+
+  size_t index = search(tree, node, value, found);
+  if(*found){
+    char * item = get_item(tree, node, index);
+    if(!replace){
+      return item;
+    }
+    (*tree->free_value)(tree, item);
+    memcpy(item, value, tree->value_size);
+    if(equal != NULL){
+      // the separator must not keep referring to data owned by the replaced value
+      memcpy(equal, value, tree->value_size);
+    }
+    return item;
+  }
+
+  ++tree->size;
+  if(node->count < tree->leaf_capacity){
+    insert_item(tree, node, index, value, NULL);
+    return get_item(tree, node, index);
+  }
+  struct b_tree_node * right = split_leaf(tree, node);
+  if(index > node->count){
+    index -= node->count;
+    node = right;
+  }
+  insert_item(tree, node, index, value, NULL);
+  memcpy(tree->separators, get_items(tree, right), tree->value_size);
+  insert_split(tree, path, indices, depth, right);
+  return get_item(tree, node, index);
+}
+
+void * b_tree_insert(struct b_tree * tree, void * value, bool * replaced){
+  assert(tree != NULL);
+
+  bool found;
+  void * item = insert_value(tree, value, true, &found);
+  if(replaced != NULL){
+    *replaced = found;
+  }
+  return item;
+}
+
+void * b_tree_find_or_insert(struct b_tree * tree, void * value, bool * inserted){
+  assert(tree != NULL);
+  assert(inserted != NULL);
+
+  bool found;
+  void * item = insert_value(tree, value, false, &found);
+  *inserted = !found;
+  return item;
+}
+
+/*
+ * Deletion
+ */
+
+/**
+ * Moves the last item of a child of a branch to the front of the next child
+ */
+static void move_right(struct b_tree * tree, struct b_tree_node * parent, size_t index){
+  struct b_tree_node * left = get_children(parent)[index];
+  struct b_tree_node * right = get_children(parent)[index + 1];
+  char * separator = get_item(tree, parent, index);
+  if(left->leaf){
+    insert_item(tree, right, 0, get_item(tree, left, left->count - 1), NULL);
+    --left->count;
+    memcpy(separator, get_items(tree, right), tree->value_size);
+  }else{
+    struct b_tree_node ** children = get_children(right);
+    memmove(children + 1, children, (right->count + 1) * sizeof(struct b_tree_node *));
+    children[0] = get_children(left)[left->count];
+    memmove(get_item(tree, right, 1), get_items(tree, right), right->count * tree->item_size);
+    memcpy(get_items(tree, right), separator, tree->value_size);
+    ++right->count;
+    memcpy(separator, get_item(tree, left, left->count - 1), tree->value_size);
+    --left->count;
+  }
+}
+
+/**
+ * Moves the first item of a child of a branch to the back of the previous child
+ */
+static void move_left(struct b_tree * tree, struct b_tree_node * parent, size_t index){
+  struct b_tree_node * left = get_children(parent)[index];
+  struct b_tree_node * right = get_children(parent)[index + 1];
+  char * separator = get_item(tree, parent, index);
+  if(left->leaf){
+    memcpy(get_item(tree, left, left->count), get_items(tree, right), tree->value_size);
+    ++left->count;
+    remove_item(tree, right, 0);
+    memcpy(separator, get_items(tree, right), tree->value_size);
+  }else{
+    memcpy(get_item(tree, left, left->count), separator, tree->value_size);
+    get_children(left)[left->count + 1] = get_children(right)[0];
+    ++left->count;
+    memcpy(separator, get_items(tree, right), tree->value_size);
+    struct b_tree_node ** children = get_children(right);
+    memmove(children, children + 1, right->count * sizeof(struct b_tree_node *));
+    memmove(get_items(tree, right), get_item(tree, right, 1), (right->count - 1) * tree->item_size);
+    --right->count;
+  }
+}
+
+/**
+ * Merges a child of a branch with the next child and removes their separator
+ */
+static void merge(struct b_tree * tree, struct b_tree_node * parent, size_t index){
+  struct b_tree_node * left = get_children(parent)[index];
+  struct b_tree_node * right = get_children(parent)[index + 1];
+  if(left->leaf){
+    memcpy(get_item(tree, left, left->count), get_items(tree, right), right->count * tree->item_size);
+    left->count += right->count;
+    left->next = right->next;
+    if(right->next != NULL){
+      right->next->previous = left;
+    }
+  }else{
+    memcpy(get_item(tree, left, left->count), get_item(tree, parent, index), tree->value_size);
+    memcpy(get_item(tree, left, left->count + 1), get_items(tree, right), right->count * tree->item_size);
+    memcpy(get_children(left) + left->count + 1, get_children(right), (right->count + 1) * sizeof(struct b_tree_node *));
+    left->count += right->count + 1;
+  }
+  free(right);
+  remove_item(tree, parent, index);
+}
+
+/**
+ * Refills a child of a branch that has too few items, from a sibling that can spare one or by merging it with a sibling
+ */
+static void rebalance(struct b_tree * tree, struct b_tree_node * parent, size_t index){
+  struct b_tree_node ** children = get_children(parent);
+  if(index > 0 && children[index - 1]->count > get_minimum(tree, children[index - 1])){
+    move_right(tree, parent, index - 1);
+  }else if(index < parent->count && children[index + 1]->count > get_minimum(tree, children[index + 1])){
+    move_left(tree, parent, index);
+  }else if(index > 0){
+    merge(tree, parent, index - 1);
+  }else{
+    merge(tree, parent, index);
+  }
+}
+
+bool b_tree_delete(struct b_tree * tree, void * value){
+  assert(tree != NULL);
+  if(tree->root == NULL){
+    return false;
+  }
+
+  struct b_tree_node * path[MAX_HEIGHT];
+  size_t indices[MAX_HEIGHT];
+  char * equal = NULL;
+  struct b_tree_node * node = tree->root;
+  size_t depth = 0;
+  while(!node->leaf){
+    size_t index = find_child(tree, node, value, &equal);
+    path[depth] = node;
+    indices[depth] = index;
+    ++depth;
+    node = get_children(node)[index];
+  }
+
+  bool found;
+  size_t index = search(tree, node, value, &found);
+  if(!found){
+    return false;
+  }
+  (*tree->free_value)(tree, get_item(tree, node, index));
+  remove_item(tree, node, index);
+  --tree->size;
+  if(equal != NULL){
+    // the value was the smallest below the separator, which now takes its successor
+    // if the leaf ran empty, rebalancing removes or overwrites the separator
+    if(index < node->count){
+      memcpy(equal, get_item(tree, node, index), tree->value_size);
+    }else if(node->next != NULL){
+      memcpy(equal, get_items(tree, node->next), tree->value_size);
+    }
+  }
+
+  while(depth > 0 && node->count < get_minimum(tree, node)){
+    --depth;
+    rebalance(tree, path[depth], indices[depth]);
+    node = path[depth];
+  }
+
+  struct b_tree_node * root = tree->root;
+  if(root->count == 0){
+    tree->root = root->leaf ? NULL : get_children(root)[0];
+    --tree->height;
+    free(root);
+  }
+  return true;
+}
+
+/*
+ * Lookup
+ */
+
+void * b_tree_find(const struct b_tree * tree, void * value){
+  assert(tree != NULL);
+  struct b_tree_node * node = tree->root;
+  if(node == NULL){
+    return NULL;
+  }
+  bool found;
+  while(!node->leaf){
+    size_t index = search(tree, node, value, &found);
+    node = get_children(node)[found ? index + 1 : index];
+  }
+  size_t index = search(tree, node, value, &found);
+  return found ? get_item(tree, node, index) : NULL;
+}
+
+void b_tree_lower_bound(const struct b_tree * tree, void * value, struct b_tree_cursor * cursor){
+  assert(tree != NULL);
+  assert(cursor != NULL);
+  struct b_tree_node * node = tree->root;
+  if(node == NULL){
+    cursor->leaf = NULL;
+    cursor->index = 0;
+    return;
+  }
+  bool found;
+  while(!node->leaf){
+    size_t index = search(tree, node, value, &found);
+    node = get_children(node)[found ? index + 1 : index];
+  }
+  size_t index = search(tree, node, value, &found);
+  if(index == node->count){
+    node = node->next;
+    index = 0;
+  }
+  cursor->leaf = node;
+  cursor->index = index;
+}
+
+void b_tree_get_begin(const struct b_tree * tree, struct b_tree_cursor * cursor){
+  assert(tree != NULL);
+  assert(cursor != NULL);
+  cursor->leaf = get_first_leaf(tree);
+  cursor->index = 0;
+}
+
+void * b_tree_cursor_get(const struct b_tree * tree, const struct b_tree_cursor * cursor){
+  assert(tree != NULL);
+  assert(cursor != NULL);
+  return cursor->leaf == NULL ? NULL : get_item(tree, cursor->leaf, cursor->index);
+}
+
+void b_tree_cursor_next(const struct b_tree * tree, struct b_tree_cursor * cursor){
+  assert(tree != NULL);
+  assert(cursor != NULL && cursor->leaf != NULL);
+  ++cursor->index;
+  if(cursor->index == cursor->leaf->count){
+    cursor->leaf = cursor->leaf->next;
+    cursor->index = 0;
+  }
+}
+
+void b_tree_select(const struct b_tree * tree, size_t index, struct b_tree_cursor * cursor){
+  assert(tree != NULL);
+  assert(cursor != NULL);
+  struct b_tree_node * leaf = index < tree->size ? get_first_leaf(tree) : NULL;
+  while(leaf != NULL && index >= leaf->count){
+    index -= leaf->count;
+    leaf = leaf->next;
+  }
+  cursor->leaf = leaf;
+  cursor->index = leaf == NULL ? 0 : index;
+}
+
+size_t b_tree_rank(const struct b_tree * tree, void * value){
+  assert(tree != NULL);
+  struct b_tree_cursor bound;
+  b_tree_lower_bound(tree, value, &bound);
+  if(bound.leaf == NULL){
+    return tree->size;
+  }
+  size_t rank = bound.index;
+  for(struct b_tree_node * leaf = bound.leaf->previous; leaf != NULL; leaf = leaf->previous){
+    rank += leaf->count;
+  }
+  return rank;
+}
+
+size_t b_tree_size(const struct b_tree * tree){
+  assert(tree != NULL);
+  return tree->size;
+}
+
+void b_tree_apply(struct b_tree * tree, b_tree_apply_f apply){
+  assert(tree != NULL);
+  assert(apply != NULL);
+  for(struct b_tree_node * leaf = get_first_leaf(tree); leaf != NULL; leaf = leaf->next){
+    for(size_t index = 0; index < leaf->count; ++index){
+      (*apply)(tree, get_item(tree, leaf, index));
+    }
+  }
+}
+
+/*
+ * Bulk loading
+ */
+
+void b_tree_build_sorted_from(struct b_tree * tree, size_t count, b_tree_next_f next, void * iterator){
+  assert(tree != NULL);
+  assert(tree->root == NULL);
+  assert(next != NULL);
+  if(count == 0){
+    return;
+  }
+
+  // spread the values evenly over as few leaves as possible, which keeps every leaf at least half full
+  size_t node_count = (count + tree->leaf_capacity - 1) / tree->leaf_capacity;
+  struct b_tree_node ** level = malloc_checked(node_count * sizeof(struct b_tree_node *));
+  char ** minima = malloc_checked(node_count * sizeof(char *));
+  struct b_tree_node * previous = NULL;
+  for(size_t index = 0; index < node_count; ++index){
+    struct b_tree_node * leaf = create_node(tree, true);
+    leaf->count = count / node_count + (index < count % node_count ? 1 : 0);
+    for(size_t item = 0; item < leaf->count; ++item){
+      memcpy(get_item(tree, leaf, item), (*next)(tree, iterator), tree->value_size);
+    }
+    leaf->previous = previous;
+    if(previous != NULL){
+      previous->next = leaf;
+    }
+    previous = leaf;
+    level[index] = leaf;
+    minima[index] = get_items(tree, leaf);
+  }
+  tree->height = 1;
+
+  // build each level of branches over the one below in place
+  while(node_count > 1){
+    size_t parent_count = (node_count + tree->branch_capacity) / (tree->branch_capacity + 1);
+    size_t first = 0;
+    for(size_t index = 0; index < parent_count; ++index){
+      size_t child_count = node_count / parent_count + (index < node_count % parent_count ? 1 : 0);
+      struct b_tree_node * branch = create_node(tree, false);
+      branch->count = child_count - 1;
+      for(size_t child = 0; child < child_count; ++child){
+	get_children(branch)[child] = level[first + child];
+	if(child > 0){
+	  memcpy(get_item(tree, branch, child - 1), minima[first + child], tree->value_size);
+	}
+      }
+      level[index] = branch;
+      minima[index] = minima[first];
+      first += child_count;
+    }
+    node_count = parent_count;
+    ++tree->height;
+  }
+
+  tree->root = level[0];
+  tree->size = count;
+  free(level);
+  free(minima);
+}
+
+/*
+ * Validation
+ */
+
+/**
+ * Validates the subtree of a node, visiting the leaves in order
+ * @param lower the separator all values must be greater than or equal to, or NULL
+ * @param upper the separator all values must be smaller than, or NULL
+ * @param minimum set to the smallest value of the subtree
+ * @param previous the last leaf visited, updated when a leaf is visited
+ * @param count incremented with the number of values in the subtree
+ */
+static bool validate_node(const struct b_tree * tree, struct b_tree_node * node, size_t height, char * lower, char * upper, char ** minimum, struct b_tree_node ** previous, size_t * count){
+  if(node->leaf != (height == 1) || node->count > get_capacity(tree, node)){
+    return false;
+  }
+  if(node == tree->root ? node->count == 0 : node->count < get_minimum(tree, node)){
+    return false;
+  }
+  char * items = get_items(tree, node);
+  for(size_t index = 0; index < node->count; ++index){
+    char * item = items + index * tree->item_size;
+    if(index > 0 && (*tree->cmp_value)(tree, item - tree->item_size, item) >= 0){
+      return false;
+    }
+    if(lower != NULL && (*tree->cmp_value)(tree, lower, item) > 0){
+      return false;
+    }
+    if(upper != NULL && (*tree->cmp_value)(tree, item, upper) >= 0){
+      return false;
+    }
+  }
+
+  if(node->leaf){
+    if(node->previous != *previous || (*previous != NULL && (*previous)->next != node)){
+      return false;
+    }
+    *previous = node;
+    *minimum = items;
+    *count += node->count;
+    return true;
+  }
+
+  for(size_t index = 0; index <= node->count; ++index){
+    char * child_lower = index == 0 ? lower : items + (index - 1) * tree->item_size;
+    char * child_upper = index == node->count ? upper : items + index * tree->item_size;
+    char * child_minimum;
+    if(!validate_node(tree, get_children(node)[index], height - 1, child_lower, child_upper, &child_minimum, previous, count)){
+      return false;
+    }
+    if(index == 0){
+      *minimum = child_minimum;
+    }else if((*tree->cmp_value)(tree, child_lower, child_minimum) != 0){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool b_tree_validate(const struct b_tree * tree){
+  assert(tree != NULL);
+  if(tree->root == NULL){
+    return tree->height == 0 && tree->size == 0;
+  }
+  char * minimum;
+  struct b_tree_node * previous = NULL;
+  size_t count = 0;
+  return validate_node(tree, tree->root, tree->height, NULL, NULL, &minimum, &previous, &count) && previous->next == NULL && count == tree->size;
+}
+
+/*
+ * Memory management
+ */
+
+static void free_node(struct b_tree * tree, struct b_tree_node * node){
+  if(node->leaf){
+    for(size_t index = 0; index < node->count; ++index){
+      (*tree->free_value)(tree, get_item(tree, node, index));
+    }
+  }else{
+    for(size_t index = 0; index <= node->count; ++index){
+      free_node(tree, get_children(node)[index]);
+    }
+  }
+  free(node);
+}
+
+void b_tree_free(struct b_tree * tree){
+  assert(tree != NULL);
+  if(tree->root != NULL){
+    free_node(tree, tree->root);
+    tree->root = NULL;
+  }
+  tree->height = 0;
+  tree->size = 0;
+  free(tree->separators);
+  tree->separators = NULL;
+}
@@ -0,0 +1,271 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef B_TREE_H
+#define B_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A B+ tree storing fixed size values inline
+ * Nodes span a few cache lines and keep their values in a contiguous array that is binary searched.
+ * Branches hold copies of the smallest value of each child but the first, all values are stored in the leaves,
+ * which are linked in order for scans.
+ * Values move between nodes when the tree changes, so pointers to values are only valid until the next insert or delete.
+ */
+
+/**
+ * The target size of a node in bytes, nodes are aligned to cache lines
+ */
+#define B_TREE_NODE_SIZE 512
+
+/**
+ * A node in the B+ tree
+ */
+struct b_tree_node;
+
+struct b_tree;
+
+/**
+ * A function pointer type for the comparison function used in the B+ tree
+ * Signature: int fn(const struct b_tree *, void * first, void * second)
+ */
+typedef int (*b_tree_cmp_f)(const struct b_tree *, void *, void *);
+
+/**
+ * A function pointer type for functions applied to values
+ * Signature: void fn(struct b_tree *, void * value)
+ */
+typedef void (*b_tree_apply_f)(struct b_tree *, void *);
+
+/**
+ * A function pointer type for a function producing a sequence of values
+ * Signature: void * fn(struct b_tree *, void * iterator)
+ */
+typedef void * (*b_tree_next_f)(struct b_tree *, void *);
+
+struct b_tree{
+
+  /**
+   * The root or NULL if the tree is empty
+   */
+  struct b_tree_node * root;
+
+  /**
+   * The number of levels, 0 for an empty tree and 1 if the root is a leaf
+   */
+  size_t height;
+
+  /**
+   * The number of values in the tree
+   */
+  size_t size;
+
+  /**
+   * The comparison function
+   */
+  b_tree_cmp_f cmp_value;
+
+  /**
+   * The free function for values
+   */
+  b_tree_apply_f free_value;
+
+  /**
+   * Extra state for the tree
+   */
+  void * state;
+
+  /**
+   * The size of a value in bytes
+   */
+  size_t value_size;
+
+  /**
+   * The distance between values in a node, the value size rounded up to keep values aligned like a pointer
+   */
+  size_t item_size;
+
+  /**
+   * The largest number of values in a leaf
+   */
+  size_t leaf_capacity;
+
+  /**
+   * The largest number of separators in a branch
+   */
+  size_t branch_capacity;
+
+  /**
+   * The allocation size of a node
+   */
+  size_t node_size;
+
+  /**
+   * Room for the two separators carried up while splitting nodes
+   */
+  void * separators;
+};
+
+/**
+ * A position in the leaves of a B+ tree
+ * Invalidated by any insert or delete
+ */
+struct b_tree_cursor{
+
+  /**
+   * The leaf or NULL past the last value
+   */
+  struct b_tree_node * leaf;
+
+  /**
+   * The index of the value in the leaf
+   */
+  size_t index;
+};
+
+/**
+ * Initializes an empty B+ tree
+ * @param tree the tree
+ * @param cmp_value the comparison function
+ * @param free_value the free function for values or NULL
+ * @param state extra state for the tree
+ * @param value_size the size of a value in bytes, values are copied into the tree
+ */
+void b_tree_init(struct b_tree * tree, b_tree_cmp_f cmp_value, b_tree_apply_f free_value, void * state, size_t value_size);
+
+/**
+ * Inserts a copy of a value, replacing and freeing an equal value already in the tree
+ * @param tree the tree
+ * @param value the value to copy
+ * @param replaced set to true if an equal value was replaced, may be NULL
+ * @return the copy in the tree, valid until the next insert or delete
+ */
+void * b_tree_insert(struct b_tree * tree, void * value, bool * replaced);
+
+/**
+ * Inserts a copy of a value unless the tree holds an equal value, which is neither replaced nor freed
+ * @param tree the tree
+ * @param value the value to copy
+ * @param inserted set to true if the value was inserted, false if the tree already held an equal value
+ * @return the copy or the equal value in the tree, valid until the next insert or delete
+ */
+void * b_tree_find_or_insert(struct b_tree * tree, void * value, bool * inserted);
+
+/**
+ * Deletes and frees the value equal to a value
+ * @param tree the tree
+ * @param value the value
+ * @return true if a value was deleted
+ */
+bool b_tree_delete(struct b_tree * tree, void * value);
+
+/**
+ * Finds the value equal to a value
+ * @param tree the tree
+ * @param value the value
+ * @return the value in the tree or NULL
+ */
+void * b_tree_find(const struct b_tree * tree, void * value);
+
+/**
+ * Positions a cursor on the first value not smaller than a value
+ * @param tree the tree
+ * @param value the value
+ * @param cursor the cursor
+ */
+void b_tree_lower_bound(const struct b_tree * tree, void * value, struct b_tree_cursor * cursor);
+
+/**
+ * Positions a cursor on the first value of the tree
+ * @param tree the tree
+ * @param cursor the cursor
+ */
+void b_tree_get_begin(const struct b_tree * tree, struct b_tree_cursor * cursor);
+
+/**
+ * Returns the value under a cursor
+ * @param tree the tree
+ * @param cursor the cursor
+ * @return the value or NULL if the cursor is past the last value
+ */
+void * b_tree_cursor_get(const struct b_tree * tree, const struct b_tree_cursor * cursor);
+
+/**
+ * Moves a cursor to the next value, following the leaf links
+ * @param tree the tree
+ * @param cursor a cursor on a value
+ */
+void b_tree_cursor_next(const struct b_tree * tree, struct b_tree_cursor * cursor);
+
+/**
+ * Positions a cursor on the value at a zero based position, skipping whole leaves
+ * Takes time linear in the number of leaves before the value
+ * @param tree the tree
+ * @param index the position
+ * @param cursor the cursor, past the last value if index is not smaller than the size of the tree
+ */
+void b_tree_select(const struct b_tree * tree, size_t index, struct b_tree_cursor * cursor);
+
+/**
+ * Returns the number of values smaller than a value, counting whole leaves
+ * Takes time linear in the number of leaves before the value
+ * @param tree the tree
+ * @param value the value
+ * @return the number of smaller values
+ */
+size_t b_tree_rank(const struct b_tree * tree, void * value);
+
+/**
+ * Returns the number of values in the tree
+ * @param tree the tree
+ * @return the number of values
+ */
+size_t b_tree_size(const struct b_tree * tree);
+
+/**
+ * Applies a function to all values in the tree in order
+ * @param tree the tree
+ * @param apply the function
+ */
+void b_tree_apply(struct b_tree * tree, b_tree_apply_f apply);
+
+/**
+ * Builds the tree from a sequence of strictly increasing values in linear time, packing the leaves
+ * @param tree an empty tree
+ * @param count the number of values
+ * @param next a function returning the next value of the sequence on each call
+ * @param iterator the state passed to next
+ */
+void b_tree_build_sorted_from(struct b_tree * tree, size_t count, b_tree_next_f next, void * iterator);
+
+/**
+ * Checks the fill of the nodes, the order of the values, the separators and the leaf links
+ * @param tree the tree
+ * @return true if the tree is valid
+ */
+bool b_tree_validate(const struct b_tree * tree);
+
+/**
+ * Frees all nodes and values of the tree, which must be initialized again before it is reused
+ * @param tree the tree
+ */
+void b_tree_free(struct b_tree * tree);
+
+#endif
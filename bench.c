@@ -0,0 +1,659 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "histogram.h"
+#include "memory.h"
+#include "ordered_map.h"
+#include "rb_tree.h"
+#include "sharded_ordered_map.h"
+#include "task_pool.h"
+#include "unordered_map.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The skew of the Zipfian key stream
+ */
+#define ZIPF_THETA 0.99
+
+/**
+ * The default largest number of keys per run
+ */
+#define DEFAULT_MAX_SIZE 1000000
+
+/**
+ * The percentage of gets in the mixed workload, the rest is split evenly between inserts and deletes
+ */
+#define MIXED_GET_PERCENT 90
+
+/**
+ * The number of shards of the sharded map in the mixed workload
+ */
+#define CONCURRENT_SHARDS 16
+
+/**
+ * The number of keys looked up per batched get
+ */
+#define GET_BATCH_SIZE 64
+
+/**
+ * The number of comparisons performed since the start of the program
+ */
+static uint64_t comparisons = 0;
+
+/*
+ * Key streams
+ */
+
+/**
+ * Returns the next value of a splitmix64 generator
+ * @param state the state of the generator
+ * @return a pseudo random value
+ */
+static uint64_t next_random(uint64_t * state){
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static void generate_random(uint64_t * keys, size_t count){
+  uint64_t state = 42;
+  for(size_t i = 0; i < count; ++i){
+    keys[i] = next_random(&state);
+  }
+}
+
+static void generate_sorted(uint64_t * keys, size_t count){
+  for(size_t i = 0; i < count; ++i){
+    keys[i] = i;
+  }
+}
+
+static void generate_reverse(uint64_t * keys, size_t count){
+  for(size_t i = 0; i < count; ++i){
+    keys[i] = count - i;
+  }
+}
+
+/**
+ * Generates keys drawn from a Zipfian distribution over count distinct keys
+ * Uses the method of Gray et al., "Quickly generating billion-record synthetic databases".
+ * Ranks are scrambled so hot keys are spread over the key space.
+ */
+static void generate_zipfian(uint64_t * keys, size_t count){
+  double zeta_n = 0.0;
+  for(size_t i = 1; i <= count; ++i){
+    zeta_n += 1.0 / pow((double)i, ZIPF_THETA);
+  }
+  double zeta_2 = 1.0 + 1.0 / pow(2.0, ZIPF_THETA);
+  double alpha = 1.0 / (1.0 - ZIPF_THETA);
+  double eta = (1.0 - pow(2.0 / (double)count, 1.0 - ZIPF_THETA)) / (1.0 - zeta_2 / zeta_n);
+
+  uint64_t state = 42;
+  for(size_t i = 0; i < count; ++i){
+    double u = (double)(next_random(&state) >> 11) / (double)(1ULL << 53);
+    double uz = u * zeta_n;
+    uint64_t rank;
+    if(uz < 1.0){
+      rank = 0;
+    }else if(uz < zeta_2){
+      rank = 1;
+    }else{
+      rank = (uint64_t)((double)count * pow(eta * u - eta + 1.0, alpha));
+    }
+    uint64_t scramble = rank;
+    keys[i] = next_random(&scramble);
+  }
+}
+
+/**
+ * A named key stream
+ */
+struct stream{
+  const char * name;
+  void (*generate)(uint64_t * keys, size_t count);
+};
+
+static const struct stream streams[] = {
+  {"random", &generate_random},
+  {"sorted", &generate_sorted},
+  {"reverse", &generate_reverse},
+  {"zipfian", &generate_zipfian}
+};
+
+/*
+ * Measurement
+ */
+
+static uint64_t get_time_ns(){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+
+/**
+ * Returns the current resident memory of the process, or 0 if it cannot be read
+ * Unlike the peak reported by getrusage, it can drop once the structures of an earlier run are freed.
+ */
+static long get_rss_kb(){
+  FILE * file = fopen("/proc/self/statm", "r");
+  if(file == NULL){
+    return 0;
+  }
+  long pages = 0;
+  if(fscanf(file, "%*s %ld", &pages) != 1){
+    pages = 0;
+  }
+  fclose(file);
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * The measurements of a single operation over a run
+ */
+struct measurement{
+  struct histogram latency;
+  uint64_t start_comparisons;
+  uint64_t elapsed;
+};
+
+static void start_measurement(struct measurement * measurement){
+  histogram_init(&measurement->latency);
+  measurement->start_comparisons = comparisons;
+  measurement->elapsed = 0;
+}
+
+static inline void record_operation(struct measurement * measurement, uint64_t start, uint64_t end){
+  histogram_record(&measurement->latency, end - start);
+  measurement->elapsed += end - start;
+}
+
+/**
+ * Records an operation on count values at once, attributing the mean latency to each value
+ */
+static void record_batch(struct measurement * measurement, uint64_t start, uint64_t end, size_t count){
+  histogram_record_count(&measurement->latency, (end - start) / (count == 0 ? 1 : count), count);
+  measurement->elapsed += end - start;
+}
+
+static void print_header(){
+  printf("%-8s %10s %-10s %14s %8s %8s %8s %8s %12s\n", "stream", "size", "operation", "ops/s", "p50 ns", "p99 ns", "p999 ns", "cmp/op", "rss kB");
+}
+
+static void print_measurement(const char * stream, size_t size, const char * operation, const struct measurement * measurement){
+  uint64_t ops = measurement->latency.total;
+  double seconds = (double)measurement->elapsed / 1e9;
+  printf("%-8s %10zu %-10s %14.0f %8lu %8lu %8lu %8.2f %12ld\n",
+	 stream,
+	 size,
+	 operation,
+	 seconds > 0.0 ? (double)ops / seconds : 0.0,
+	 (unsigned long)histogram_get_percentile(&measurement->latency, 50.0),
+	 (unsigned long)histogram_get_percentile(&measurement->latency, 99.0),
+	 (unsigned long)histogram_get_percentile(&measurement->latency, 99.9),
+	 ops == 0 ? 0.0 : (double)(comparisons - measurement->start_comparisons) / (double)ops,
+	 get_rss_kb());
+}
+
+/*
+ * Benchmarks
+ */
+
+static int cmp_tree(const struct rb_tree * tree, void * first, void * second){
+  uint64_t first_key = *(uint64_t *)first;
+  uint64_t second_key = *(uint64_t *)second;
+  ++comparisons;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static int cmp_map(const struct ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  ++comparisons;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+/**
+ * Compares keys of the typed map, counting the comparisons like cmp_map
+ */
+#define CMP_TYPED_MAP(first, second) (++comparisons, RB_TREE_CMP_NUMBER(first, second))
+
+RB_MAP_DEFINE(typed_map, uint64_t, const uint64_t *, CMP_TYPED_MAP)
+
+RB_MAP_DEFINE_INDEXED(indexed_map, uint64_t, const uint64_t *, CMP_TYPED_MAP)
+
+/**
+ * The sum of the values scanned by the current thread
+ */
+static _Thread_local uint64_t scan_sum = 0;
+
+static void scan_tree(struct rb_tree * tree, void * value){
+  scan_sum += *(uint64_t *)value;
+}
+
+static void bench_tree(const char * stream, const uint64_t * keys, size_t size, struct task_pool * tasks){
+  struct rb_tree tree;
+  struct measurement measurement;
+
+  rb_tree_init(&tree, &cmp_tree, NULL, NULL);
+  rb_tree_set_inline_values(&tree, sizeof(uint64_t));
+
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    rb_tree_insert(&tree, (void *)&keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "insert", &measurement);
+
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    rb_tree_find(&tree, (void *)&keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "find", &measurement);
+
+  start_measurement(&measurement);
+  struct rb_node * node = rb_tree_get_begin(&tree);
+  while(node != NULL){
+    uint64_t start = get_time_ns();
+    node = rb_tree_get_next(&tree, node);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "iterate", &measurement);
+
+  start_measurement(&measurement);
+  uint64_t start = get_time_ns();
+  rb_tree_apply(&tree, &scan_tree);
+  record_batch(&measurement, start, get_time_ns(), rb_tree_size(&tree));
+  print_measurement(stream, size, "scan", &measurement);
+
+  rb_tree_set_task_pool(&tree, tasks);
+  start_measurement(&measurement);
+  start = get_time_ns();
+  rb_tree_apply_parallel(&tree, &scan_tree);
+  record_batch(&measurement, start, get_time_ns(), rb_tree_size(&tree));
+  print_measurement(stream, size, "scan_par", &measurement);
+  rb_tree_set_task_pool(&tree, NULL);
+
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    rb_tree_find_and_delete(&tree, (void *)&keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "delete", &measurement);
+
+  rb_tree_free(&tree);
+}
+
+/**
+ * Measures lookups in a map built on each single threaded engine and in maps generated with RB_MAP_DEFINE and RB_MAP_DEFINE_INDEXED
+ */
+static void bench_ordered_map(const char * stream, const uint64_t * keys, size_t size){
+  static const struct{
+    const char * operation;
+    enum ordered_map_engine engine;
+    bool frozen;
+  } engines[] = {
+    {"map_get", ORDERED_MAP_RB_TREE, false},
+    {"btree_get", ORDERED_MAP_B_TREE, false},
+    {"frozen_get", ORDERED_MAP_RB_TREE, true}
+  };
+
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e){
+    struct ordered_map map;
+    struct measurement measurement;
+
+    ordered_map_init_engine(&map, engines[e].engine, &cmp_map, NULL, NULL, NULL);
+    for(size_t i = 0; i < size; ++i){
+      ordered_map_insert(&map, (void *)(uintptr_t)keys[i], (void *)&keys[i]);
+    }
+    if(engines[e].frozen){
+      ordered_map_freeze(&map);
+    }
+
+    start_measurement(&measurement);
+    for(size_t i = 0; i < size; ++i){
+      uint64_t start = get_time_ns();
+      ordered_map_get(&map, (void *)(uintptr_t)keys[i]);
+      record_operation(&measurement, start, get_time_ns());
+    }
+    print_measurement(stream, size, engines[e].operation, &measurement);
+
+    ordered_map_free(&map);
+  }
+
+  struct ordered_map batched;
+  struct measurement measurement;
+  void * batch_keys[GET_BATCH_SIZE];
+  void * batch_values[GET_BATCH_SIZE];
+
+  ordered_map_init(&batched, &cmp_map, NULL, NULL, NULL);
+  for(size_t i = 0; i < size; ++i){
+    ordered_map_insert(&batched, (void *)(uintptr_t)keys[i], (void *)&keys[i]);
+  }
+
+  start_measurement(&measurement);
+  for(size_t first = 0; first < size; first += GET_BATCH_SIZE){
+    size_t count = size - first < GET_BATCH_SIZE ? size - first : GET_BATCH_SIZE;
+    for(size_t i = 0; i < count; ++i){
+      batch_keys[i] = (void *)(uintptr_t)keys[first + i];
+    }
+    uint64_t start = get_time_ns();
+    ordered_map_get_batch(&batched, batch_keys, count, batch_values);
+    record_batch(&measurement, start, get_time_ns(), count);
+  }
+  print_measurement(stream, size, "batch_get", &measurement);
+
+  ordered_map_free(&batched);
+
+  struct typed_map map;
+
+  typed_map_init(&map);
+  for(size_t i = 0; i < size; ++i){
+    typed_map_put(&map, keys[i], &keys[i]);
+  }
+
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    typed_map_get(&map, keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "typed_get", &measurement);
+
+  typed_map_free(&map);
+
+  struct indexed_map indexed;
+  indexed_map_init(&indexed);
+  for(size_t i = 0; i < size; ++i){
+    indexed_map_put(&indexed, keys[i], &keys[i]);
+  }
+
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    indexed_map_get(&indexed, keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "index_get", &measurement);
+
+  indexed_map_free(&indexed);
+}
+
+/**
+ * The comparison of maps keyed by strings, counting comparisons like cmp_map
+ */
+static int cmp_string_map(const struct ordered_map * map, void * first, void * second){
+  ++comparisons;
+  return strcmp((const char *)first, (const char *)second);
+}
+
+/**
+ * The length of a decimal key string, including the terminating null character
+ */
+#define KEY_STRING_SIZE 24
+
+/**
+ * Measures point lookups in a hash map against an ordered map, with the integer keys and with the keys formatted as strings
+ */
+static void bench_unordered_map(const char * stream, const uint64_t * keys, size_t size){
+  struct unordered_map hash_map;
+  struct measurement measurement;
+
+  unordered_map_init(&hash_map, &unordered_map_hash_pointer, &unordered_map_equal_pointer, NULL, NULL, NULL);
+  for(size_t i = 0; i < size; ++i){
+    unordered_map_insert(&hash_map, (void *)(uintptr_t)keys[i], (void *)&keys[i]);
+  }
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    unordered_map_get(&hash_map, (void *)(uintptr_t)keys[i]);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "hash_get", &measurement);
+  unordered_map_free(&hash_map);
+
+  char * strings = malloc_checked(size * KEY_STRING_SIZE);
+  for(size_t i = 0; i < size; ++i){
+    snprintf(strings + i * KEY_STRING_SIZE, KEY_STRING_SIZE, "%llu", (unsigned long long)keys[i]);
+  }
+
+  struct ordered_map map;
+  ordered_map_init(&map, &cmp_string_map, NULL, NULL, NULL);
+  for(size_t i = 0; i < size; ++i){
+    ordered_map_insert(&map, strings + i * KEY_STRING_SIZE, (void *)&keys[i]);
+  }
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    ordered_map_get(&map, strings + i * KEY_STRING_SIZE);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "str_get", &measurement);
+  ordered_map_free(&map);
+
+  unordered_map_init(&hash_map, &unordered_map_hash_string, &unordered_map_equal_string, NULL, NULL, NULL);
+  for(size_t i = 0; i < size; ++i){
+    unordered_map_insert(&hash_map, strings + i * KEY_STRING_SIZE, (void *)&keys[i]);
+  }
+  start_measurement(&measurement);
+  for(size_t i = 0; i < size; ++i){
+    uint64_t start = get_time_ns();
+    unordered_map_get(&hash_map, strings + i * KEY_STRING_SIZE);
+    record_operation(&measurement, start, get_time_ns());
+  }
+  print_measurement(stream, size, "str_hash", &measurement);
+  unordered_map_free(&hash_map);
+
+  free(strings);
+}
+
+/**
+ * The comparison used by maps shared between threads, which does not count comparisons
+ */
+static int cmp_concurrent_map(const struct ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static int cmp_sharded_map(const struct sharded_ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+/**
+ * A thread running the mixed workload
+ */
+struct mixed_worker{
+  struct ordered_map * map;
+  struct sharded_ordered_map * sharded;
+  pthread_mutex_t * lock;
+  const uint64_t * keys;
+  size_t size;
+  size_t operations;
+  uint64_t seed;
+  struct histogram latency;
+  pthread_t thread;
+};
+
+/**
+ * Runs gets, inserts and deletes of random keys of the stream on the sharded map if there is one,
+ * otherwise on the map under the lock if there is one
+ */
+static void * run_mixed_worker(void * data){
+  struct mixed_worker * worker = (struct mixed_worker *)data;
+  uint64_t state = worker->seed;
+  histogram_init(&worker->latency);
+  for(size_t i = 0; i < worker->operations; ++i){
+    uint64_t random = next_random(&state);
+    void * key = (void *)(uintptr_t)worker->keys[random % worker->size];
+    unsigned operation = (unsigned)((random >> 40) % 100);
+    uint64_t start = get_time_ns();
+    if(worker->lock != NULL){
+      pthread_mutex_lock(worker->lock);
+    }
+    if(worker->sharded != NULL){
+      if(operation < MIXED_GET_PERCENT){
+	sharded_ordered_map_get(worker->sharded, key);
+      }else if(operation % 2 == 0){
+	sharded_ordered_map_insert(worker->sharded, key, key);
+      }else{
+	sharded_ordered_map_delete(worker->sharded, key);
+      }
+    }else if(operation < MIXED_GET_PERCENT){
+      ordered_map_get(worker->map, key);
+    }else if(operation % 2 == 0){
+      ordered_map_insert(worker->map, key, key);
+    }else{
+      ordered_map_delete(worker->map, key);
+    }
+    if(worker->lock != NULL){
+      pthread_mutex_unlock(worker->lock);
+    }
+    histogram_record(&worker->latency, get_time_ns() - start);
+  }
+  return NULL;
+}
+
+/**
+ * Runs the mixed workload on a map shared by 1, 2, 4, ... up to max_threads threads
+ * The red black tree engine is guarded by a single mutex or sharded by key ranges, the skip list engine is used as is
+ */
+static void bench_concurrent_map(const char * stream, const uint64_t * keys, size_t size, size_t max_threads){
+  static const struct{
+    const char * name;
+    enum ordered_map_engine engine;
+    bool locked;
+    bool sharded;
+  } engines[] = {
+    {"locked", ORDERED_MAP_RB_TREE, true, false},
+    {"sharded", ORDERED_MAP_RB_TREE, false, true},
+    {"skip", ORDERED_MAP_SKIP_LIST, false, false}
+  };
+
+  struct mixed_worker * workers = malloc_checked(max_threads * sizeof(struct mixed_worker));
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e){
+    for(size_t threads = 1; threads <= max_threads; threads *= 2){
+      struct ordered_map map;
+      pthread_mutex_t lock;
+      pthread_mutex_init(&lock, NULL);
+      struct sharded_ordered_map sharded;
+      ordered_map_init_engine(&map, engines[e].engine, &cmp_concurrent_map, NULL, NULL, NULL);
+      if(engines[e].sharded){
+	sharded_ordered_map_init(&sharded, CONCURRENT_SHARDS, &cmp_sharded_map, NULL, NULL, NULL, NULL);
+      }
+      for(size_t i = 0; i < size; ++i){
+	if(engines[e].sharded){
+	  sharded_ordered_map_insert(&sharded, (void *)(uintptr_t)keys[i], (void *)&keys[i]);
+	}else{
+	  ordered_map_insert(&map, (void *)(uintptr_t)keys[i], (void *)&keys[i]);
+	}
+      }
+
+      uint64_t start = get_time_ns();
+      for(size_t i = 0; i < threads; ++i){
+	workers[i].map = &map;
+	workers[i].sharded = engines[e].sharded ? &sharded : NULL;
+	workers[i].lock = engines[e].locked ? &lock : NULL;
+	workers[i].keys = keys;
+	workers[i].size = size;
+	workers[i].operations = size / threads;
+	workers[i].seed = i + 1;
+	pthread_create(&workers[i].thread, NULL, &run_mixed_worker, &workers[i]);
+      }
+      struct measurement measurement;
+      start_measurement(&measurement);
+      for(size_t i = 0; i < threads; ++i){
+	pthread_join(workers[i].thread, NULL);
+	histogram_add(&measurement.latency, &workers[i].latency);
+      }
+      measurement.elapsed = get_time_ns() - start;
+
+      char operation[32];
+      snprintf(operation, sizeof(operation), "%s/%zu", engines[e].name, threads);
+      print_measurement(stream, size, operation, &measurement);
+      ordered_map_free(&map);
+      if(engines[e].sharded){
+	sharded_ordered_map_free(&sharded);
+      }
+      pthread_mutex_destroy(&lock);
+    }
+  }
+  free(workers);
+}
+
+/**
+ * Runs the benchmarks
+ * Usage: bench [max_size]
+ * Runs every key stream at sizes 1e3, 1e4, ... up to max_size keys (default 1e6)
+ * and prints throughput, latency percentiles, comparisons per operation and the resident memory after the operation
+ * Scans report their mean latency per value, scan_par runs on one thread per online processor
+ * locked/n, sharded/n and skip/n run a mix of 90% gets, 5% inserts and 5% deletes on n threads sharing a map,
+ * respectively guarded by a mutex, split over CONCURRENT_SHARDS independently locked shards or built on the concurrent skip list,
+ * and report the throughput over all threads
+ * Configure with CFLAGS=-DNDEBUG for representative numbers, debug builds validate the touched nodes on every mutation
+ * @param arg_count the number of command line arguments
+ * @param args the command line arguments
+ * @return the exit code
+ */
+int main(int arg_count, const char ** args){
+  size_t max_size = DEFAULT_MAX_SIZE;
+  if(arg_count > 2){
+    fputs("usage: bench [max_size]\n", stderr);
+    return 1;
+  }else if(arg_count == 2){
+    char * end;
+    max_size = (size_t)strtoull(args[1], &end, 10);
+    if(*end != '\0' || max_size < 1000){
+      fputs("max_size should be a number of at least 1000\n", stderr);
+      return 1;
+    }
+  }
+
+  uint64_t * keys = malloc_checked(max_size * sizeof(uint64_t));
+  struct task_pool tasks;
+  task_pool_init(&tasks, 0);
+
+  print_header();
+  for(size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); ++i){
+    for(size_t size = 1000; size <= max_size; size *= 10){
+      (*streams[i].generate)(keys, size);
+      bench_tree(streams[i].name, keys, size, &tasks);
+      bench_ordered_map(streams[i].name, keys, size);
+      bench_unordered_map(streams[i].name, keys, size);
+      bench_concurrent_map(streams[i].name, keys, size, task_pool_get_thread_count(&tasks));
+    }
+  }
+
+  task_pool_destroy(&tasks);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "eytzinger_array.h"
+#include "memory.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The size of a cache line in bytes, the alignment of the values
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * The number of levels below the current position that a search prefetches
+ * The 2^PREFETCH_LEVELS descendants at that depth are adjacent, so they take one or a few cache lines.
+ */
+#define PREFETCH_LEVELS 3
+
+/**
+ * The default free function (does nothing)
+ */
+static void default_free_value(struct eytzinger_array * array, void * value){}
+
+static inline char * get_value(const struct eytzinger_array * array, size_t position){
+  return array->values + position * array->value_size;
+}
+
+/**
+ * Returns the position of the first value in order in the subtree of a position
+ */
+static inline size_t get_leftmost(const struct eytzinger_array * array, size_t position){
+  while(2 * position <= array->size){
+    position *= 2;
+  }
+  return position;
+}
+
+/**
+ * Returns the ancestor where a search that ended below the array at position turned left last
+ * Every trailing one bit of the position is a turn to the right, so they are shifted out along with the last left turn.
+ */
+static inline size_t get_last_left_turn(size_t position){
+  return position >> __builtin_ffsll((long long)~position);
+}
+
+/**
+ * Returns the number of values in the subtree of a position, counting the nodes on each level
+ */
+static size_t get_subtree_size(const struct eytzinger_array * array, size_t position){
+  size_t count = 0;
+  size_t first = position;
+  size_t last = position;
+  while(first <= array->size){
+    count += (last < array->size ? last : array->size) - first + 1;
+    first = 2 * first;
+    last = 2 * last + 1;
+  }
+  return count;
+}
+
+void eytzinger_array_init(struct eytzinger_array * array, eytzinger_cmp_f cmp_value, eytzinger_apply_f free_value, void * state, size_t value_size){
+  assert(array != NULL);
+  assert(cmp_value != NULL);
+  assert(value_size > 0);
+  array->values = NULL;
+  array->size = 0;
+  array->cmp_value = cmp_value;
+  array->free_value = free_value == NULL ? default_free_value : free_value;
+  array->state = state;
+  array->value_size = value_size;
+}
+
+void eytzinger_array_build_sorted_from(struct eytzinger_array * array, size_t count, eytzinger_next_f next, void * iterator){
+  assert(array != NULL);
+  assert(array->size == 0);
+  assert(next != NULL);
+  if(count == 0){
+    return;
+  }
+  // position 0 stays unused, so the descendants of a position share cache lines
+  size_t bytes = (count + 1) * array->value_size;
+  array->values = malloc_aligned_checked(CACHE_LINE_SIZE, (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+  array->size = count;
+
+  // an in order walk of the implicit tree visits the positions in the order of the values
+  for(size_t position = eytzinger_array_get_first(array); position != 0; position = eytzinger_array_get_next(array, position)){
+    memcpy(get_value(array, position), (*next)(array, iterator), array->value_size);
+  }
+}
+
+void * eytzinger_array_get(const struct eytzinger_array * array, size_t position){
+  assert(array != NULL);
+  assert(position >= 1 && position <= array->size);
+  return get_value(array, position);
+}
+
+size_t eytzinger_array_lower_bound(const struct eytzinger_array * array, void * value){
+  assert(array != NULL);
+  size_t prefetch_size = ((size_t)1 << PREFETCH_LEVELS) * array->value_size;
+  size_t position = 1;
+  while(position <= array->size){
+    char * descendants = get_value(array, position << PREFETCH_LEVELS);
+    for(size_t offset = 0; offset < prefetch_size; offset += CACHE_LINE_SIZE){
+      __builtin_prefetch(descendants + offset);
+    }
+    position = 2 * position + ((*array->cmp_value)(array, get_value(array, position), value) < 0);
+  }
+  return get_last_left_turn(position);
+}
+
+size_t eytzinger_array_find(const struct eytzinger_array * array, void * value){
+  size_t position = eytzinger_array_lower_bound(array, value);
+  if(position != 0 && (*array->cmp_value)(array, get_value(array, position), value) == 0){
+    return position;
+  }else{
+    return 0;
+  }
+}
+
+size_t eytzinger_array_get_first(const struct eytzinger_array * array){
+  assert(array != NULL);
+  return array->size == 0 ? 0 : get_leftmost(array, 1);
+}
+
+size_t eytzinger_array_get_next(const struct eytzinger_array * array, size_t position){
+  assert(array != NULL);
+  assert(position >= 1 && position <= array->size);
+  if(2 * position + 1 <= array->size){
+    return get_leftmost(array, 2 * position + 1);
+  }else{
+    return get_last_left_turn(position);
+  }
+}
+
+size_t eytzinger_array_select(const struct eytzinger_array * array, size_t index){
+  assert(array != NULL);
+  if(index >= array->size){
+    return 0;
+  }
+  size_t position = 1;
+  for(;;){
+    size_t left = get_subtree_size(array, 2 * position);
+    if(index < left){
+      position = 2 * position;
+    }else if(index == left){
+      return position;
+    }else{
+      index -= left + 1;
+      position = 2 * position + 1;
+    }
+  }
+}
+
+size_t eytzinger_array_rank(const struct eytzinger_array * array, void * value){
+  assert(array != NULL);
+  size_t rank = 0;
+  size_t position = 1;
+  while(position <= array->size){
+    if((*array->cmp_value)(array, get_value(array, position), value) < 0){
+      rank += get_subtree_size(array, 2 * position) + 1;
+      position = 2 * position + 1;
+    }else{
+      position = 2 * position;
+    }
+  }
+  return rank;
+}
+
+size_t eytzinger_array_size(const struct eytzinger_array * array){
+  assert(array != NULL);
+  return array->size;
+}
+
+void eytzinger_array_free(struct eytzinger_array * array){
+  assert(array != NULL);
+  if(array->free_value != default_free_value){
+    for(size_t position = 1; position <= array->size; ++position){
+      (*array->free_value)(array, get_value(array, position));
+    }
+  }
+  free(array->values);
+  array->values = NULL;
+  array->size = 0;
+}
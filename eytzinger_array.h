@@ -0,0 +1,173 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EYTZINGER_ARRAY_H
+#define EYTZINGER_ARRAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * An immutable sorted array of fixed size values in Eytzinger order, after Khuong and Morin, "Array Layouts for Comparison-Based Searching"
+ * The values are laid out as an implicit binary search tree in breadth first order: position 1 is the root
+ * and the children of position k are at 2k and 2k + 1, so position 0 means no value.
+ * A search descends without branching on the comparisons and prefetches the values a few levels below,
+ * which hides most cache misses, and the array holds nothing but the values.
+ */
+
+struct eytzinger_array;
+
+/**
+ * A function pointer type for the comparison function used in the array
+ * Signature: int fn(const struct eytzinger_array *, void * first, void * second)
+ */
+typedef int (*eytzinger_cmp_f)(const struct eytzinger_array *, void *, void *);
+
+/**
+ * A function pointer type for functions applied to values
+ * Signature: void fn(struct eytzinger_array *, void * value)
+ */
+typedef void (*eytzinger_apply_f)(struct eytzinger_array *, void *);
+
+/**
+ * A function pointer type for a function producing a sequence of values
+ * Signature: void * fn(struct eytzinger_array *, void * iterator)
+ */
+typedef void * (*eytzinger_next_f)(struct eytzinger_array *, void *);
+
+struct eytzinger_array{
+
+  /**
+   * The values, indexed by position and aligned to a cache line
+   */
+  char * values;
+
+  /**
+   * The number of values
+   */
+  size_t size;
+
+  /**
+   * The comparison function
+   */
+  eytzinger_cmp_f cmp_value;
+
+  /**
+   * The free function for values
+   */
+  eytzinger_apply_f free_value;
+
+  /**
+   * Extra state for the array
+   */
+  void * state;
+
+  /**
+   * The size of a value in bytes
+   */
+  size_t value_size;
+};
+
+/**
+ * Initializes an empty array
+ * @param array the array
+ * @param cmp_value the comparison function
+ * @param free_value the free function for values or NULL
+ * @param state extra state for the array
+ * @param value_size the size of a value in bytes
+ */
+void eytzinger_array_init(struct eytzinger_array * array, eytzinger_cmp_f cmp_value, eytzinger_apply_f free_value, void * state, size_t value_size);
+
+/**
+ * Fills an empty array from a sequence of strictly increasing values in linear time
+ * @param array the array
+ * @param count the number of values
+ * @param next a function returning the next value of the sequence on each call, the value is copied
+ * @param iterator the state passed to next
+ */
+void eytzinger_array_build_sorted_from(struct eytzinger_array * array, size_t count, eytzinger_next_f next, void * iterator);
+
+/**
+ * Returns the value at a position
+ * @param array the array
+ * @param position a position between 1 and the size of the array
+ * @return the value
+ */
+void * eytzinger_array_get(const struct eytzinger_array * array, size_t position);
+
+/**
+ * Finds the position of the value equal to a value
+ * @param array the array
+ * @param value the value
+ * @return the position or 0
+ */
+size_t eytzinger_array_find(const struct eytzinger_array * array, void * value);
+
+/**
+ * Finds the position of the first value not smaller than a value, without branching on the comparisons
+ * @param array the array
+ * @param value the value
+ * @return the position or 0 if all values are smaller
+ */
+size_t eytzinger_array_lower_bound(const struct eytzinger_array * array, void * value);
+
+/**
+ * Returns the position of the smallest value
+ * @param array the array
+ * @return the position or 0 if the array is empty
+ */
+size_t eytzinger_array_get_first(const struct eytzinger_array * array);
+
+/**
+ * Returns the position of the next value in order, in amortized constant time
+ * @param array the array
+ * @param position the position of a value
+ * @return the position of the next value or 0
+ */
+size_t eytzinger_array_get_next(const struct eytzinger_array * array, size_t position);
+
+/**
+ * Returns the position of the value at a zero based index in the order of the values in O(log² n)
+ * @param array the array
+ * @param index the index
+ * @return the position or 0 if index is not smaller than the size of the array
+ */
+size_t eytzinger_array_select(const struct eytzinger_array * array, size_t index);
+
+/**
+ * Returns the number of values smaller than a value in O(log² n)
+ * @param array the array
+ * @param value the value
+ * @return the number of smaller values
+ */
+size_t eytzinger_array_rank(const struct eytzinger_array * array, void * value);
+
+/**
+ * Returns the number of values in the array
+ * @param array the array
+ * @return the number of values
+ */
+size_t eytzinger_array_size(const struct eytzinger_array * array);
+
+/**
+ * Frees all values of the array, which must be initialized again before it is reused
+ * @param array the array
+ */
+void eytzinger_array_free(struct eytzinger_array * array);
+
+#endif
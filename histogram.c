@@ -0,0 +1,138 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "histogram.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * The number of bits needed to index a sub bucket
+ */
+#define SUB_BUCKET_BITS 5
+
+/**
+ * Returns the index of the sub bucket for a value
+ * Values below HISTOGRAM_SUB_BUCKETS are stored exactly,
+ * larger values are stored in one of HISTOGRAM_SUB_BUCKETS sub buckets per power of two
+ */
+static size_t get_index(uint64_t value){
+  if(value < HISTOGRAM_SUB_BUCKETS){
+    return (size_t)value;
+  }else{
+    int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    uint64_t sub = (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+    return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS + (size_t)sub;
+  }
+}
+
+/**
+ * Returns the largest value stored in a sub bucket
+ */
+static uint64_t get_upper_bound(size_t index){
+  size_t bucket = index / HISTOGRAM_SUB_BUCKETS;
+  uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+  if(bucket == 0){
+    return sub;
+  }else{
+    int shift = (int)bucket - 1;
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+  }
+}
+
+void histogram_init(struct histogram * histogram){
+  assert(histogram != NULL);
+
+  for(size_t i = 0; i < HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS; ++i){
+    histogram->counts[i] = 0;
+  }
+  histogram->total = 0;
+  histogram->min = UINT64_MAX;
+  histogram->max = 0;
+  histogram->sum = 0;
+}
+
+void histogram_record(struct histogram * histogram, uint64_t value){
+  histogram_record_count(histogram, value, 1);
+}
+
+void histogram_record_count(struct histogram * histogram, uint64_t value, uint64_t count){
+  assert(histogram != NULL);
+
+  if(count == 0){
+    return;
+  }
+  histogram->counts[get_index(value)] += count;
+  histogram->total += count;
+  histogram->sum += value * count;
+  if(value < histogram->min){
+    histogram->min = value;
+  }
+  if(value > histogram->max){
+    histogram->max = value;
+  }
+}
+
+void histogram_add(struct histogram * histogram, const struct histogram * other){
+  assert(histogram != NULL);
+  assert(other != NULL);
+
+  for(size_t i = 0; i < HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS; ++i){
+    histogram->counts[i] += other->counts[i];
+  }
+  histogram->total += other->total;
+  histogram->sum += other->sum;
+  if(other->min < histogram->min){
+    histogram->min = other->min;
+  }
+  if(other->max > histogram->max){
+    histogram->max = other->max;
+  }
+}
+
+uint64_t histogram_get_percentile(const struct histogram * histogram, double percentile){
+  assert(histogram != NULL);
+  assert(percentile >= 0.0 && percentile <= 100.0);
+
+  if(histogram->total == 0){
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+  if(rank == 0){
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for(size_t i = 0; i < HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS; ++i){
+    seen += histogram->counts[i];
+    if(seen >= rank){
+      uint64_t upper = get_upper_bound(i);
+      return upper < histogram->max ? upper : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+double histogram_get_mean(const struct histogram * histogram){
+  assert(histogram != NULL);
+
+  if(histogram->total == 0){
+    return 0.0;
+  }else{
+    return (double)histogram->sum / (double)histogram->total;
+  }
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * A histogram with logarithmic buckets, each split in linear sub buckets
+ * Values are recorded with a relative precision of 1 / HISTOGRAM_SUB_BUCKETS
+ */
+
+/**
+ * The number of linear sub buckets per power of two
+ */
+#define HISTOGRAM_SUB_BUCKETS 32
+
+/**
+ * The number of powers of two covered by the histogram
+ */
+#define HISTOGRAM_BUCKETS 64
+
+struct histogram{
+
+  /**
+   * The counts per sub bucket
+   */
+  uint64_t counts[HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS];
+
+  /**
+   * The total number of recorded values
+   */
+  uint64_t total;
+
+  /**
+   * The smallest recorded value
+   */
+  uint64_t min;
+
+  /**
+   * The largest recorded value
+   */
+  uint64_t max;
+
+  /**
+   * The sum of all recorded values
+   */
+  uint64_t sum;
+};
+
+/**
+ * Initializes an empty histogram
+ * @param histogram the histogram
+ */
+void histogram_init(struct histogram * histogram);
+
+/**
+ * Records a value in the histogram
+ * @param histogram the histogram
+ * @param value the value
+ */
+void histogram_record(struct histogram * histogram, uint64_t value);
+
+/**
+ * Records a value a number of times in the histogram
+ * @param histogram the histogram
+ * @param value the value
+ * @param count the number of times to record the value
+ */
+void histogram_record_count(struct histogram * histogram, uint64_t value, uint64_t count);
+
+/**
+ * Adds all values recorded in another histogram
+ * @param histogram the histogram
+ * @param other the other histogram
+ */
+void histogram_add(struct histogram * histogram, const struct histogram * other);
+
+/**
+ * Returns the value at the requested percentile
+ * The value is the upper bound of the sub bucket containing the percentile, clamped to the recorded maximum
+ * @param histogram the histogram
+ * @param percentile the percentile between 0 and 100
+ * @return the value or 0 if the histogram is empty
+ */
+uint64_t histogram_get_percentile(const struct histogram * histogram, double percentile);
+
+/**
+ * Returns the mean of the recorded values
+ * @param histogram the histogram
+ * @return the mean or 0 if the histogram is empty
+ */
+double histogram_get_mean(const struct histogram * histogram);
+
+#endif
@@ -16,10 +16,20 @@
  *
  */
 
+#include "b_tree.h"
+#include "memory.h"
 #include "ordered_map.h"
+#include "persistent_tree.h"
 #include "rb_tree.h"
+#include "sharded_ordered_map.h"
+#include "task_pool.h"
+#include "unordered_map.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -56,14 +66,560 @@ static void test_tree(){
   rb_tree_free(&tree);
 }
 
+static void count_tree(struct rb_tree * tree, void * value){
+  ++*(int *)tree->state;
+}
+
+static void test_pooled_tree(){
+  const char * values[] = {"alpha", "x-ray", "coca", "book", "terra", "none", "factor", "not", "original", "zulu"};
+
+  struct memory_pool pool;
+  memory_pool_init(&pool);
+
+  int shared_count = 0;
+  int private_count = 0;
+  struct rb_tree shared;
+  struct rb_tree private;
+  rb_tree_init_pooled(&shared, &compare_tree, NULL, &shared_count, &pool);
+  rb_tree_init_pooled(&private, &compare_tree, NULL, &private_count, NULL);
+
+  for(int i = 0; i < 10; ++i){
+    rb_tree_insert(&shared, (void *)values[i]);
+    rb_tree_insert(&private, (void *)values[i]);
+  }
+  for(int i = 0; i < 5; ++i){
+    rb_tree_find_and_delete(&shared, (void *)values[i]);
+  }
+
+  rb_tree_apply(&shared, &count_tree);
+  rb_tree_apply(&private, &count_tree);
+  assert(shared_count == 5);
+  assert(private_count == 10);
+  
+  rb_tree_free(&shared);
+  rb_tree_free(&private);
+  memory_pool_destroy(&pool);
+}
+
+static int compare_counted(const struct rb_tree * tree, void * first, void * second){
+  ++*(size_t *)tree->state;
+  return ((uintptr_t)first > (uintptr_t)second) - ((uintptr_t)first < (uintptr_t)second);
+}
+
+static void test_stats(){
+  size_t comparisons = 0;
+  struct rb_tree tree;
+  struct rb_tree_stats stats;
+  rb_tree_init(&tree, &compare_counted, NULL, &comparisons);
+  rb_tree_set_validation(&tree, RB_VALIDATION_OFF, 0);
+
+  for(uintptr_t value = 1; value <= 1000; ++value){
+    rb_tree_insert(&tree, (void *)value);
+  }
+  for(uintptr_t value = 1; value <= 1000; value += 2){
+    rb_tree_find_and_delete(&tree, (void *)value);
+  }
+  rb_tree_get_stats(&tree, &stats);
+
+#ifdef RB_TREE_STATS
+  assert(stats.comparisons == comparisons);
+  assert(stats.allocations == 1000 && stats.frees == 500);
+  assert(stats.rotations == stats.insert_single_rotations + 2 * stats.insert_double_rotations
+	 + stats.delete_sibling_rotations + stats.delete_single_rotations + 2 * stats.delete_double_rotations);
+  assert(stats.rotations > 0 && stats.recolorings > 0);
+  size_t searches = 0;
+  for(size_t length = 0; length < RB_TREE_STATS_PATH_LENGTHS; ++length){
+    searches += stats.path_lengths[length];
+    assert(stats.path_lengths[length] == 0 || length <= stats.max_path_length);
+  }
+  assert(searches == stats.searches && searches >= 500);
+  // a red black tree with n nodes is at most 2 log2(n + 1) high
+  assert(stats.max_path_length <= 20);
+
+  rb_tree_reset_stats(&tree);
+  rb_tree_get_stats(&tree, &stats);
+#endif
+  assert(stats.comparisons == 0 && stats.searches == 0 && stats.max_path_length == 0);
+
+  // rotations made while joining subtrees count towards the tree receiving the union
+  struct rb_tree other;
+  rb_tree_init(&other, &compare_counted, NULL, &comparisons);
+  for(uintptr_t value = 1; value <= 1000; value += 2){
+    rb_tree_insert(&other, (void *)value);
+  }
+  rb_tree_union(&tree, &other);
+  assert(rb_tree_size(&tree) == 1000 && rb_tree_is_empty(&other));
+  rb_tree_get_stats(&tree, &stats);
+#ifdef RB_TREE_STATS
+  assert(stats.rotations > 0);
+  assert(stats.rotations == stats.insert_single_rotations + 2 * stats.insert_double_rotations
+	 + stats.delete_sibling_rotations + stats.delete_single_rotations + 2 * stats.delete_double_rotations);
+#endif
+  rb_tree_free(&other);
+  rb_tree_free(&tree);
+}
+
+static void test_find_batch(){
+  size_t comparisons = 0;
+  struct rb_tree tree;
+  rb_tree_init(&tree, &compare_counted, NULL, &comparisons);
+  for(uintptr_t value = 0; value < 2000; value += 2){
+    rb_tree_insert(&tree, (void *)value);
+  }
+
+  void * values[2001];
+  struct rb_node * found[2001];
+  for(uintptr_t value = 0; value <= 2000; ++value){
+    values[value] = (void *)(value * 7 % 2001);
+  }
+  rb_tree_find_batch(&tree, values, 2001, found);
+  for(size_t i = 0; i <= 2000; ++i){
+    assert(found[i] == rb_tree_find(&tree, values[i]));
+    assert((found[i] == NULL) == ((uintptr_t)values[i] % 2 == 1 || (uintptr_t)values[i] == 2000));
+  }
+  rb_tree_find_batch(&tree, values, 0, found);
+  rb_tree_free(&tree);
+}
+
+static void test_validation(){
+  const char * values[] = {"alpha", "x-ray", "coca", "book", "terra", "none", "factor", "not", "original", "zulu"};
+  const enum rb_validation validations[] = {RB_VALIDATION_OFF, RB_VALIDATION_LOCAL, RB_VALIDATION_SAMPLED, RB_VALIDATION_FULL};
+
+  for(int i = 0; i < 4; ++i){
+    struct rb_tree tree;
+    rb_tree_init(&tree, &compare_tree, NULL, NULL);
+    rb_tree_set_validation(&tree, validations[i], 3);
+    
+    for(int j = 0; j < 10; ++j){
+      rb_tree_insert(&tree, (void *)values[j]);
+    }
+    for(int j = 0; j < 10; j += 2){
+      rb_tree_find_and_delete(&tree, (void *)values[j]);
+    }
+    assert(rb_tree_validate(&tree));
+    
+    rb_tree_free(&tree);
+  }
+}
+
+static void test_build_sorted(){
+  const char * values[] = {"alpha", "book", "coca", "factor", "none", "not", "original", "terra", "x-ray", "zulu"};
+
+  for(size_t count = 0; count <= 10; ++count){
+    struct rb_tree tree;
+    rb_tree_init(&tree, &compare_tree, NULL, NULL);
+    rb_tree_build_sorted(&tree, (void *)values, count);
+    assert(rb_tree_validate(&tree));
+
+    size_t index = 0;
+    for(struct rb_node * node = rb_tree_get_begin(&tree); node != NULL; node = rb_tree_get_next(&tree, node)){
+      assert(rb_tree_get_value(&tree, node) == values[index++]);
+    }
+    assert(index == count);
+    (void)index;
+
+    rb_tree_insert(&tree, "delta");
+    rb_tree_find_and_delete(&tree, (void *)values[0]);
+    assert(rb_tree_validate(&tree));
+    
+    rb_tree_free(&tree);
+  }
+}
+
+static int count_compare_tree(const struct rb_tree * tree, void * first, void * second){
+  ++*(int *)tree->state;
+  return strcmp((const char *)first, (const char *)second);
+}
+
+static void test_insert_hint(){
+  const char * values[] = {"alpha", "book", "coca", "factor", "none", "not", "original", "terra", "x-ray", "zulu"};
+
+  int comparisons = 0;
+  struct rb_tree tree;
+  rb_tree_init(&tree, &count_compare_tree, NULL, &comparisons);
+
+  struct rb_node * hint = NULL;
+  for(int i = 9; i >= 0; i -= 2){
+    hint = rb_tree_insert_hint(&tree, hint, (void *)values[i]);
+  }
+  for(int i = 8; i >= 0; i -= 2){
+    rb_tree_insert_hint(&tree, rb_tree_find(&tree, (void *)values[i + 1]), (void *)values[i]);
+  }
+  assert(rb_tree_validate(&tree));
+  rb_tree_free(&tree);
+
+  char keys[100][4];
+  comparisons = 0;
+  rb_tree_init(&tree, &count_compare_tree, NULL, &comparisons);
+  rb_tree_set_validation(&tree, RB_VALIDATION_OFF, 0);
+  for(int i = 0; i < 100; ++i){
+    sprintf(keys[i], "%03d", i);
+    rb_tree_insert(&tree, keys[i]);
+  }
+  // the finger makes every sequential insert cost a single comparison
+  assert(comparisons == 99);
+  rb_tree_free(&tree);
+}
+
+static void test_order_statistics(){
+  const char * values[] = {"alpha", "book", "coca", "factor", "none", "not", "original", "terra", "x-ray", "zulu"};
+
+  struct rb_tree tree;
+  rb_tree_init(&tree, &compare_tree, NULL, NULL);
+  assert(rb_tree_is_empty(&tree));
+  for(int i = 9; i >= 0; --i){
+    rb_tree_insert(&tree, (void *)values[i]);
+  }
+  rb_tree_find_and_delete(&tree, (void *)values[4]);
+  assert(!rb_tree_is_empty(&tree));
+  assert(rb_tree_size(&tree) == 9);
+
+  for(size_t i = 0; i < 9; ++i){
+    const char * value = values[i < 4 ? i : i + 1];
+    assert(rb_tree_get_value(&tree, rb_tree_select(&tree, i)) == value);
+    (void)value;
+    assert(rb_tree_rank(&tree, (void *)value) == i);
+  }
+  assert(rb_tree_select(&tree, 9) == NULL);
+  assert(rb_tree_rank(&tree, "nope") == 4);
+  assert(rb_tree_rank(&tree, "zz") == 9);
+  assert(rb_tree_get_value(&tree, rb_tree_lower_bound(&tree, "factor")) == values[3]);
+  assert(rb_tree_get_value(&tree, rb_tree_upper_bound(&tree, "factor")) == values[5]);
+  assert(rb_tree_upper_bound(&tree, "zulu") == NULL);
+  assert(rb_tree_count_range(&tree, "b", "p") == 5);
+  
+  rb_tree_free(&tree);
+}
+
+static void test_set_operations(){
+  const char * values[] = {"alpha", "book", "coca", "factor", "none", "not", "original", "terra", "x-ray", "zulu"};
+
+  struct rb_tree tree;
+  struct rb_tree right;
+  rb_tree_init(&tree, &compare_tree, NULL, NULL);
+  rb_tree_init(&right, &compare_tree, NULL, NULL);
+  rb_tree_set_validation(&tree, RB_VALIDATION_FULL, 1);
+  rb_tree_build_sorted(&tree, (void *)values, 10);
+
+  rb_tree_split(&tree, "m", &right);
+  assert(rb_tree_size(&tree) == 4 && rb_tree_size(&right) == 6);
+  assert(rb_tree_get_value(&right, rb_tree_get_begin(&right)) == values[4]);
+  rb_tree_find_and_delete(&right, (void *)values[4]);
+  rb_tree_join(&tree, (void *)values[4], &right);
+  assert(rb_tree_is_empty(&right));
+  assert(rb_tree_size(&tree) == 10 && rb_tree_validate(&tree));
+
+  struct rb_tree other;
+  rb_tree_init(&other, &compare_tree, NULL, NULL);
+  rb_tree_insert(&other, (void *)values[1]);
+  rb_tree_insert(&other, (void *)values[5]);
+  rb_tree_insert(&other, "quux");
+  rb_tree_difference(&tree, &other);
+  assert(rb_tree_size(&tree) == 8 && rb_tree_find(&tree, (void *)values[5]) == NULL);
+
+  rb_tree_insert(&other, (void *)values[0]);
+  rb_tree_insert(&other, "quux");
+  rb_tree_intersection(&tree, &other);
+  assert(rb_tree_size(&tree) == 1 && rb_tree_find(&tree, (void *)values[0]) != NULL);
+
+  rb_tree_insert(&other, (void *)values[9]);
+  rb_tree_insert(&other, (void *)values[0]);
+  rb_tree_union(&tree, &other);
+  assert(rb_tree_size(&tree) == 2 && rb_tree_is_empty(&other));
+  assert(rb_tree_validate(&tree));
+
+  rb_tree_free(&other);
+  rb_tree_free(&right);
+  rb_tree_free(&tree);
+}
+
+#define PARALLEL_COUNT 50000
+
+static atomic_size_t parallel_sum;
+
+static int compare_size(const struct rb_tree * tree, void * first, void * second){
+  size_t first_value = *(size_t *)first;
+  size_t second_value = *(size_t *)second;
+  return (first_value > second_value) - (first_value < second_value);
+}
+
+static void sum_tree(struct rb_tree * tree, void * value){
+  atomic_fetch_add(&parallel_sum, *(size_t *)value);
+}
+
+static bool is_even(struct rb_tree * tree, void * value){
+  return *(size_t *)value % 2 == 0;
+}
+
+static void build_multiples(struct rb_tree * tree, size_t * values, size_t factor){
+  for(size_t i = 0; i < PARALLEL_COUNT; ++i){
+    values[i] = i * factor;
+  }
+  rb_tree_build_sorted(tree, values, PARALLEL_COUNT);
+}
+
+static void test_parallel_tree(){
+  struct task_pool tasks;
+  struct memory_pool pool;
+  struct rb_tree tree;
+  struct rb_tree other;
+  size_t * values = malloc_checked(PARALLEL_COUNT * sizeof(size_t));
+
+  task_pool_init(&tasks, 4);
+  memory_pool_init(&pool);
+  rb_tree_init_pooled(&tree, &compare_size, NULL, NULL, &pool);
+  rb_tree_init_pooled(&other, &compare_size, NULL, NULL, &pool);
+  rb_tree_set_inline_values(&tree, sizeof(size_t));
+  rb_tree_set_inline_values(&other, sizeof(size_t));
+  rb_tree_set_task_pool(&tree, &tasks);
+
+  build_multiples(&tree, values, 2);
+  atomic_store(&parallel_sum, 0);
+  rb_tree_apply_parallel(&tree, &sum_tree);
+  assert(atomic_load(&parallel_sum) == (size_t)PARALLEL_COUNT * (PARALLEL_COUNT - 1));
+
+  // evens below 2n and multiples of 3 below 3n
+  build_multiples(&other, values, 3);
+  rb_tree_union(&tree, &other);
+  size_t expected = 0;
+  for(size_t i = 0; i < 3 * PARALLEL_COUNT; ++i){
+    expected += (i < 2 * PARALLEL_COUNT && i % 2 == 0) || i % 3 == 0;
+  }
+  assert(rb_tree_size(&tree) == expected && rb_tree_validate(&tree));
+
+  rb_tree_filter(&tree, &is_even);
+  build_multiples(&other, values, 4);
+  rb_tree_difference(&tree, &other);
+  expected = 0;
+  for(size_t i = 0; i < 3 * PARALLEL_COUNT; i += 2){
+    expected += (i < 2 * PARALLEL_COUNT || i % 3 == 0) && i % 4 != 0;
+  }
+  assert(rb_tree_size(&tree) == expected && rb_tree_validate(&tree));
+  assert(rb_tree_find(&tree, &(size_t){4}) == NULL && rb_tree_find(&tree, &(size_t){6}) != NULL);
+
+  rb_tree_free(&other);
+  rb_tree_free(&tree);
+  memory_pool_destroy(&pool);
+  task_pool_destroy(&tasks);
+  free(values);
+}
+
+RB_TREE_DEFINE(int_set, int, RB_TREE_CMP_NUMBER)
+
+RB_MAP_DEFINE(string_map, const char *, int, RB_TREE_CMP_STRING)
+
+RB_TREE_DEFINE_INDEXED(indexed_set, int, RB_TREE_CMP_NUMBER)
+
+static void test_typed_tree(){
+  struct int_set set;
+  bool inserted;
+
+  int_set_init(&set);
+  for(int i = 0; i < 1000; ++i){
+    int_set_insert(&set, i * 7 % 1000, &inserted);
+    assert(inserted);
+  }
+  int_set_insert(&set, 7, &inserted);
+  assert(!inserted && int_set_size(&set) == 1000 && int_set_validate(&set));
+  for(int i = 0; i < 1000; i += 2){
+    bool deleted = int_set_delete(&set, i);
+    assert(deleted);
+    (void)deleted;
+  }
+  bool deleted = int_set_delete(&set, 0);
+  assert(!deleted && int_set_validate(&set));
+  (void)deleted;
+  assert(int_set_lower_bound(&set, 10)->key == 11);
+  int expected = 1;
+  for(struct int_set_node * node = int_set_get_first(&set); node != NULL; node = int_set_get_next(&set, node)){
+    assert(node->key == expected);
+    expected += 2;
+  }
+  assert(expected == 1001);
+  int_set_free(&set);
+  assert(int_set_size(&set) == 0);
+
+  struct string_map map;
+  string_map_init(&map);
+  bool replaced = string_map_put(&map, "dog", 1);
+  assert(!replaced);
+  (void)replaced;
+  replaced = string_map_put(&map, "cow", 2);
+  assert(!replaced);
+  replaced = string_map_put(&map, "dog", 3);
+  assert(replaced);
+  assert(*string_map_get(&map, "dog") == 3 && string_map_get(&map, "cat") == NULL);
+  assert(string_map_validate(&map));
+  string_map_free(&map);
+}
+
+static void test_indexed_tree(){
+  struct indexed_set set;
+
+  // three 32 bit links, one holding the color, and the key
+  assert(sizeof(struct indexed_set_node) == 4 * sizeof(uint32_t));
+  indexed_set_init(&set);
+  for(int i = 0; i < 1000; ++i){
+    indexed_set_insert(&set, i * 7 % 1000, NULL);
+  }
+  assert(indexed_set_size(&set) == 1000 && indexed_set_validate(&set));
+  uint32_t capacity = set.capacity;
+  for(int i = 0; i < 1000; i += 2){
+    bool deleted = indexed_set_delete(&set, i);
+    assert(deleted);
+    (void)deleted;
+  }
+  assert(indexed_set_validate(&set));
+
+  // deleted slots are reused before the arena grows
+  for(int i = 1000; i < 1500; ++i){
+    indexed_set_insert(&set, i, NULL);
+  }
+  assert(set.capacity == capacity && indexed_set_size(&set) == 1000 && indexed_set_validate(&set));
+  (void)capacity;
+  assert(indexed_set_lower_bound(&set, 998)->key == 999);
+  assert(indexed_set_get_next(&set, indexed_set_find(&set, 1499)) == NULL);
+  indexed_set_free(&set);
+}
+
+static int compare_persistent_tree(const struct persistent_tree * tree, void * first, void * second){
+  return strcmp((const char *)first, (const char *)second);
+}
+
+static void test_persistent_tree(){
+  const char * values[] = {"alpha", "x-ray", "coca", "book", "terra", "none", "factor", "not", "original", "zulu"};
+
+  struct persistent_tree tree;
+  struct persistent_tree snapshot;
+  persistent_tree_init(&tree, &compare_persistent_tree, NULL, NULL);
+  for(int i = 0; i < 10; ++i){
+    persistent_tree_insert(&tree, (void *)values[i]);
+  }
+  persistent_tree_snapshot(&tree, &snapshot);
+
+  for(int i = 0; i < 5; ++i){
+    bool deleted = persistent_tree_delete(&tree, (void *)values[i]);
+    assert(deleted);
+    (void)deleted;
+  }
+  bool replaced = persistent_tree_insert(&tree, "delta");
+  assert(!replaced);
+  (void)replaced;
+  assert(persistent_tree_size(&tree) == 6 && persistent_tree_validate(&tree));
+  assert(persistent_tree_find(&tree, "alpha") == NULL);
+  assert(persistent_tree_find(&tree, "delta") != NULL);
+
+  // the snapshot still sees the tree as it was
+  assert(persistent_tree_size(&snapshot) == 10 && persistent_tree_validate(&snapshot));
+  assert(persistent_tree_find(&snapshot, "alpha") == values[0]);
+  assert(persistent_tree_find(&snapshot, "delta") == NULL);
+
+  persistent_tree_free(&snapshot);
+  assert(persistent_tree_validate(&tree));
+  persistent_tree_free(&tree);
+}
+
+#define B_TREE_COUNT 20000
+
+/**
+ * A value for B+ trees, large enough with its padding to force the smallest node capacity
+ */
+struct b_tree_value{
+  uintptr_t key;
+  char padding[200];
+};
+
+static int cmp_b_tree(const struct b_tree * tree, void * first, void * second){
+  uintptr_t first_key = ((struct b_tree_value *)first)->key;
+  uintptr_t second_key = ((struct b_tree_value *)second)->key;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static void count_b_tree_free(struct b_tree * tree, void * value){
+  ++*(size_t *)tree->state;
+}
+
+static void * next_b_tree_value(struct b_tree * tree, void * iterator){
+  struct b_tree_value * value = (struct b_tree_value *)iterator;
+  ++value->key;
+  return value;
+}
+
+/**
+ * Fills and empties a B+ tree in a scattered order, splitting and merging nodes at every level
+ * @param value_size the size of the values, the prefix of struct b_tree_value
+ */
+static void test_b_tree(size_t value_size){
+  struct b_tree tree;
+  struct b_tree_value value = {0};
+  size_t frees = 0;
+  bool replaced;
+
+  b_tree_init(&tree, &cmp_b_tree, &count_b_tree_free, &frees, value_size);
+  for(uintptr_t i = 0; i < B_TREE_COUNT; ++i){
+    value.key = i * 7919 % B_TREE_COUNT;
+    struct b_tree_value * stored = (struct b_tree_value *)b_tree_insert(&tree, &value, &replaced);
+    assert(stored->key == value.key && !replaced);
+    (void)stored;
+  }
+  assert(b_tree_size(&tree) == B_TREE_COUNT && b_tree_validate(&tree));
+  value.key = 42;
+  b_tree_insert(&tree, &value, &replaced);
+  assert(replaced && frees == 1);
+
+  for(uintptr_t i = 0; i < B_TREE_COUNT; ++i){
+    value.key = i * 7919 % B_TREE_COUNT;
+    if(value.key % 2 == 0){
+      bool deleted = b_tree_delete(&tree, &value);
+      assert(deleted);
+      (void)deleted;
+      deleted = b_tree_delete(&tree, &value);
+      assert(!deleted);
+    }
+  }
+  assert(b_tree_size(&tree) == B_TREE_COUNT / 2 && b_tree_validate(&tree));
+  value.key = 101;
+  assert(b_tree_find(&tree, &value) != NULL);
+  value.key = 100;
+  assert(b_tree_find(&tree, &value) == NULL);
+  assert(b_tree_rank(&tree, &value) == 50);
+
+  struct b_tree_cursor cursor;
+  b_tree_select(&tree, 10, &cursor);
+  assert(((struct b_tree_value *)b_tree_cursor_get(&tree, &cursor))->key == 21);
+  b_tree_lower_bound(&tree, &value, &cursor);
+  for(uintptr_t key = 101; key < B_TREE_COUNT; key += 2){
+    assert(((struct b_tree_value *)b_tree_cursor_get(&tree, &cursor))->key == key);
+    b_tree_cursor_next(&tree, &cursor);
+  }
+  assert(b_tree_cursor_get(&tree, &cursor) == NULL);
+
+  for(uintptr_t key = 1; key < B_TREE_COUNT; key += 2){
+    value.key = key;
+    bool deleted = b_tree_delete(&tree, &value);
+    assert(deleted);
+    (void)deleted;
+  }
+  assert(b_tree_size(&tree) == 0 && b_tree_validate(&tree));
+  assert(frees == B_TREE_COUNT + 1);
+
+  value.key = 0;
+  b_tree_build_sorted_from(&tree, B_TREE_COUNT, &next_b_tree_value, &value);
+  assert(b_tree_size(&tree) == B_TREE_COUNT && b_tree_validate(&tree));
+  value.key = B_TREE_COUNT / 2;
+  assert(b_tree_rank(&tree, &value) == B_TREE_COUNT / 2 - 1);
+  b_tree_free(&tree);
+  assert(frees == 2 * B_TREE_COUNT + 1);
+}
+
 static int cmp_ordered_map(const struct ordered_map * map, void * first, void * second){
   return strcmp((const char *)first, (const char *)second);
 }
 
-static void test_ordered_map(){
+static void test_ordered_map(enum ordered_map_engine engine){
   struct ordered_map map;
 
-  ordered_map_init(&map, &cmp_ordered_map, NULL, NULL, NULL);
+  ordered_map_init_engine(&map, engine, &cmp_ordered_map, NULL, NULL, NULL);
 
   const char * bark = "bark";
   const char * mooh = "mooh";
@@ -73,8 +629,795 @@ static void test_ordered_map(){
   
   ordered_map_insert(&map, "cow", (void *)mooh);
   assert(ordered_map_get(&map, "cow") == mooh);
+
+  struct ordered_map_entry * cow = ordered_map_find(&map, "cow");
+  assert(ordered_map_get(&map, "cat") == NULL);
+  bool deleted = ordered_map_delete(&map, "dog");
+  assert(deleted);
+  (void)deleted;
+  deleted = ordered_map_delete(&map, "dog");
+  assert(!deleted);
+  assert(ordered_map_find(&map, "cow") == cow);
+  (void)cow;
+
+  bool replaced = ordered_map_insert(&map, "cow", (void *)bark);
+  assert(replaced);
+  (void)replaced;
+  assert(ordered_map_get(&map, "cow") == bark);
   
   ordered_map_free(&map);
+
+  void * keys[] = {"cat", "cow", "dog"};
+  void * sounds[] = {"meow", (void *)mooh, (void *)bark};
+  ordered_map_init_engine(&map, engine, &cmp_ordered_map, NULL, NULL, NULL);
+  ordered_map_build_sorted(&map, keys, sounds, 3);
+  assert(ordered_map_get(&map, "cat") == sounds[0]);
+  assert(ordered_map_get(&map, "dog") == bark);
+  assert(ordered_map_size(&map) == 3);
+  assert(ordered_map_select(&map, 1)->value == mooh);
+  assert(ordered_map_rank(&map, "cub") == 2);
+
+  void * batch_keys[] = {"dog", "emu", "cat", "cow"};
+  void * batch_values[4];
+  ordered_map_get_batch(&map, batch_keys, 4, batch_values);
+  assert(batch_values[0] == bark && batch_values[1] == NULL && batch_values[2] == sounds[0] && batch_values[3] == mooh);
+
+  struct ordered_map_range range;
+  ordered_map_range_init(&range, &map, "co", "dog");
+  assert(ordered_map_range_next(&range)->value == mooh);
+  assert(ordered_map_range_next(&range) == NULL);
+  assert(ordered_map_count_range(&map, "cat", "doh") == 3);
+  assert(ordered_map_count_range(&map, "dog", "cat") == 0);
+  ordered_map_free(&map);
+}
+
+static size_t upsert_frees;
+
+static void count_upsert_free(struct ordered_map * map, void * value){
+  ++upsert_frees;
+}
+
+static void count_word(struct ordered_map * map, struct ordered_map_entry * entry, void * data){
+  entry->value = (void *)((uintptr_t)entry->value + (uintptr_t)data);
+}
+
+static void test_upsert(enum ordered_map_engine engine){
+  struct ordered_map map;
+  const char * words[] = {"the", "cat", "and", "the", "dog", "and", "the", "cow"};
+
+  upsert_frees = 0;
+  ordered_map_init_engine(&map, engine, &cmp_ordered_map, NULL, &count_upsert_free, NULL);
+  for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i){
+    bool inserted = ordered_map_upsert(&map, (void *)words[i], &count_word, (void *)1);
+    assert(inserted == (i < 3 || i == 4 || i == 7));
+    (void)inserted;
+  }
+  assert(ordered_map_size(&map) == 5);
+  assert(ordered_map_get(&map, "the") == (void *)3 && ordered_map_get(&map, "and") == (void *)2 && ordered_map_get(&map, "cow") == (void *)1);
+
+  bool inserted = ordered_map_try_insert(&map, "cat", (void *)7);
+  assert(!inserted);
+  inserted = ordered_map_try_insert(&map, "emu", (void *)7);
+  assert(inserted);
+  assert(ordered_map_get(&map, "cat") == (void *)1 && ordered_map_get(&map, "emu") == (void *)7);
+
+  struct ordered_map_entry * entry = ordered_map_get_or_insert(&map, "dog", (void *)9, &inserted);
+  assert(!inserted && entry->value == (void *)1);
+  (void)entry;
+  entry = ordered_map_get_or_insert(&map, "elk", (void *)9, &inserted);
+  assert(inserted && strcmp(entry->key, "elk") == 0 && entry->value == (void *)9);
+  entry = ordered_map_get_or_insert(&map, "elk", NULL, NULL);
+  assert(entry == ordered_map_find(&map, "elk"));
+
+  // values already in the map are never freed by these calls, but the skip list frees the three counts replaced by upserts
+  size_t replaced = engine == ORDERED_MAP_SKIP_LIST ? 3 : 0;
+  assert(upsert_frees <= replaced);
+  ordered_map_free(&map);
+  assert(upsert_frees == 7 + replaced);
+  (void)replaced;
+}
+
+static void test_allocators(){
+  struct accounting_allocator accounting;
+  struct arena_allocator arena;
+  struct rb_tree tree;
+  size_t comparisons = 0;
+
+  accounting_allocator_init(&accounting, &libc_allocator);
+  rb_tree_init_allocator(&tree, &compare_counted, NULL, &comparisons, &accounting.allocator);
+  for(uintptr_t value = 1; value <= 100; ++value){
+    rb_tree_insert(&tree, (void *)value);
+  }
+  size_t live = accounting.live;
+  assert(accounting.blocks == 100 && live > 0);
+  (void)live;
+  for(uintptr_t value = 1; value <= 100; value += 2){
+    rb_tree_find_and_delete(&tree, (void *)value);
+  }
+  assert(accounting.blocks == 50 && accounting.live == live / 2);
+  rb_tree_free(&tree);
+  assert(accounting.blocks == 0 && accounting.live == 0 && accounting.peak == live);
+
+  // the arena takes its chunks from the accounting allocator, so only whole chunks are counted
+  arena_allocator_init(&arena, &accounting.allocator);
+  rb_tree_init_allocator(&tree, &compare_counted, NULL, &comparisons, &arena.allocator);
+  for(uintptr_t value = 1; value <= 10000; ++value){
+    rb_tree_insert(&tree, (void *)value);
+  }
+  assert(rb_tree_validate(&tree) && rb_tree_size(&tree) == 10000);
+  assert(accounting.blocks > 1 && accounting.live >= accounting.blocks * ARENA_CHUNK_SIZE);
+  rb_tree_free(&tree);
+  assert(accounting.blocks > 1);
+  arena_allocator_destroy(&arena);
+  assert(accounting.blocks == 0 && accounting.live == 0);
+
+  struct ordered_map map;
+  ordered_map_init_allocator(&map, &cmp_ordered_map, NULL, NULL, NULL, &accounting.allocator);
+  ordered_map_insert(&map, "cow", "mooh");
+  ordered_map_insert(&map, "dog", "bark");
+  assert(accounting.blocks == 2 && strcmp(ordered_map_get(&map, "cow"), "mooh") == 0);
+  ordered_map_free(&map);
+  assert(accounting.live == 0);
+}
+
+static size_t unordered_frees;
+
+static void count_unordered_free(struct unordered_map * map, void * value){
+  ++unordered_frees;
+}
+
+static void test_unordered_map(){
+  struct unordered_map map;
+
+  unordered_map_init(&map, &unordered_map_hash_string, &unordered_map_equal_string, NULL, NULL, NULL);
+  bool deleted = unordered_map_delete(&map, "dog");
+  assert(unordered_map_get(&map, "dog") == NULL && !deleted);
+  (void)deleted;
+  bool replaced = unordered_map_insert(&map, "dog", "bark");
+  assert(!replaced);
+  (void)replaced;
+  replaced = unordered_map_insert(&map, "cow", "mooh");
+  assert(!replaced);
+  replaced = unordered_map_insert(&map, "dog", "woof");
+  assert(replaced);
+  assert(strcmp(unordered_map_get(&map, "dog"), "woof") == 0);
+  deleted = unordered_map_delete(&map, "dog");
+  assert(deleted);
+  deleted = unordered_map_delete(&map, "dog");
+  assert(!deleted);
+  assert(unordered_map_size(&map) == 1 && unordered_map_find(&map, "cow")->value != NULL);
+  unordered_map_free(&map);
+
+  unordered_frees = 0;
+  unordered_map_init(&map, &unordered_map_hash_pointer, &unordered_map_equal_pointer, NULL, &count_unordered_free, NULL);
+  for(uintptr_t key = 1; key <= 10000; ++key){
+    replaced = unordered_map_insert(&map, (void *)key, (void *)(2 * key));
+    assert(!replaced);
+  }
+  for(uintptr_t key = 1; key <= 10000; key += 2){
+    deleted = unordered_map_delete(&map, (void *)key);
+    assert(deleted);
+  }
+  size_t capacity = map.capacity;
+
+  // churn leaves deleted slots behind, which are cleared without growing the map
+  for(uintptr_t key = 20000; key < 120000; ++key){
+    unordered_map_insert(&map, (void *)key, (void *)key);
+    unordered_map_delete(&map, (void *)key);
+  }
+  assert(map.capacity == capacity && unordered_map_size(&map) == 5000);
+  (void)capacity;
+  for(uintptr_t key = 1; key <= 10000; ++key){
+    assert(unordered_map_get(&map, (void *)key) == (key % 2 == 0 ? (void *)(2 * key) : NULL));
+  }
+  unordered_map_free(&map);
+  assert(unordered_frees == 10000 + 100000);
+}
+
+#define CONCURRENT_THREADS 4
+
+#define CONCURRENT_KEYS 20000
+
+static atomic_size_t concurrent_frees;
+
+static int cmp_concurrent_map(const struct ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static void free_concurrent_value(struct ordered_map * map, void * value){
+  atomic_fetch_add(&concurrent_frees, 1);
+  free(value);
+}
+
+static void * new_concurrent_value(uintptr_t key){
+  uintptr_t * value = malloc_checked(sizeof(uintptr_t));
+  *value = key;
+  return value;
+}
+
+struct concurrent_worker{
+  struct ordered_map * map;
+  uintptr_t first_key;
+  pthread_t thread;
+};
+
+/**
+ * Inserts, replaces and deletes the keys congruent to first_key modulo the number of threads,
+ * while reading the keys of the other threads
+ */
+static void * run_concurrent_worker(void * data){
+  struct concurrent_worker * worker = (struct concurrent_worker *)data;
+  struct ordered_map * map = worker->map;
+  for(uintptr_t key = worker->first_key; key < CONCURRENT_KEYS; key += CONCURRENT_THREADS){
+    bool replaced = ordered_map_insert(map, (void *)key, new_concurrent_value(key));
+    assert(!replaced);
+    (void)replaced;
+    replaced = ordered_map_insert(map, (void *)key, new_concurrent_value(key));
+    assert(replaced);
+    // the other thread may replace the value while it is read
+    ordered_map_pin(map);
+    uintptr_t * other = ordered_map_get(map, (void *)(CONCURRENT_KEYS - 1 - key));
+    assert(other == NULL || *other == CONCURRENT_KEYS - 1 - key);
+    (void)other;
+    ordered_map_unpin(map);
+  }
+  for(uintptr_t key = worker->first_key; key < CONCURRENT_KEYS; key += 2 * CONCURRENT_THREADS){
+    bool deleted = ordered_map_delete(map, (void *)key);
+    assert(deleted && ordered_map_get(map, (void *)key) == NULL);
+    (void)deleted;
+  }
+  return NULL;
+}
+
+static void test_concurrent_map(){
+  struct ordered_map map;
+  struct concurrent_worker workers[CONCURRENT_THREADS];
+
+  atomic_store(&concurrent_frees, 0);
+  ordered_map_init_engine(&map, ORDERED_MAP_SKIP_LIST, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    workers[i].map = &map;
+    workers[i].first_key = i;
+    pthread_create(&workers[i].thread, NULL, &run_concurrent_worker, &workers[i]);
+  }
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  // every thread deleted every other key it inserted
+  assert(ordered_map_size(&map) == CONCURRENT_KEYS / 2);
+  for(uintptr_t key = 0; key < CONCURRENT_KEYS; ++key){
+    uintptr_t * value = ordered_map_get(&map, (void *)key);
+    assert(((key / CONCURRENT_THREADS) % 2 == 0) == (value == NULL));
+    (void)value;
+    assert(value == NULL || *value == key);
+  }
+  assert(ordered_map_rank(&map, (void *)(uintptr_t)(2 * CONCURRENT_THREADS)) == CONCURRENT_THREADS);
+
+  ordered_map_free(&map);
+  assert(atomic_load(&concurrent_frees) == 2 * CONCURRENT_KEYS);
+}
+
+#define PINNED_KEYS 256
+
+#define PINNED_ROUNDS 200
+
+/**
+ * Overwrites a value before freeing it, so a reader still using it sees a different key
+ */
+static void free_poisoned_value(struct ordered_map * map, void * value){
+  *(uintptr_t *)value = UINTPTR_MAX;
+  free_concurrent_value(map, value);
+}
+
+struct pinned_reader{
+  struct ordered_map * map;
+  atomic_bool * done;
+  pthread_t thread;
+};
+
+/**
+ * Reads the values of all keys under a pin until the writer is done, checking them after a delay
+ */
+static void * run_pinned_reader(void * data){
+  struct pinned_reader * reader = (struct pinned_reader *)data;
+  while(!atomic_load(reader->done)){
+    for(uintptr_t key = 0; key < PINNED_KEYS; ++key){
+      ordered_map_pin(reader->map);
+      uintptr_t * value = ordered_map_get(reader->map, (void *)key);
+      sched_yield();
+      assert(value == NULL || *value == key);
+      (void)value;
+      ordered_map_unpin(reader->map);
+    }
+  }
+  return NULL;
+}
+
+static void test_pinned_reads(){
+  struct ordered_map map;
+  struct pinned_reader readers[CONCURRENT_THREADS];
+  atomic_bool done = false;
+
+  atomic_store(&concurrent_frees, 0);
+  ordered_map_init_engine(&map, ORDERED_MAP_SKIP_LIST, &cmp_concurrent_map, NULL, &free_poisoned_value, NULL);
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    readers[i].map = &map;
+    readers[i].done = &done;
+    pthread_create(&readers[i].thread, NULL, &run_pinned_reader, &readers[i]);
+  }
+  // values are replaced and deleted while the readers use them
+  for(size_t round = 0; round < PINNED_ROUNDS; ++round){
+    for(uintptr_t key = 0; key < PINNED_KEYS; ++key){
+      ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+      ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+    }
+    for(uintptr_t key = 0; key < PINNED_KEYS; ++key){
+      ordered_map_delete(&map, (void *)key);
+    }
+  }
+  atomic_store(&done, true);
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_join(readers[i].thread, NULL);
+  }
+  assert(ordered_map_is_empty(&map));
+  ordered_map_free(&map);
+  assert(atomic_load(&concurrent_frees) == 2 * PINNED_KEYS * PINNED_ROUNDS);
+}
+
+#define UPSERT_KEYS 64
+
+#define UPSERT_ROUNDS 2000
+
+static atomic_size_t upsert_allocations;
+
+/**
+ * Counts a word in a value owned by the map, making a new value so concurrent readers keep seeing the old one
+ */
+static void count_owned(struct ordered_map * map, struct ordered_map_entry * entry, void * data){
+  atomic_fetch_add(&upsert_allocations, 1);
+  entry->value = new_concurrent_value((entry->value == NULL ? 0 : *(uintptr_t *)entry->value) + (uintptr_t)data);
+}
+
+struct upsert_worker{
+  struct ordered_map * map;
+  ordered_map_update_f update;
+  pthread_t thread;
+};
+
+/**
+ * Counts every key of the map once per round, all threads upserting the same keys
+ */
+static void * run_upsert_worker(void * data){
+  struct upsert_worker * worker = (struct upsert_worker *)data;
+  for(size_t round = 0; round < UPSERT_ROUNDS; ++round){
+    for(uintptr_t key = 0; key < UPSERT_KEYS; ++key){
+      ordered_map_upsert(worker->map, (void *)key, worker->update, (void *)1);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Runs counting upserts of the same keys on several threads
+ * @param owned whether the counts are values owned and freed by the map rather than integers
+ */
+static void test_concurrent_upsert(bool owned){
+  struct ordered_map map;
+  struct upsert_worker workers[CONCURRENT_THREADS];
+
+  atomic_store(&concurrent_frees, 0);
+  atomic_store(&upsert_allocations, 0);
+  ordered_map_init_engine(&map, ORDERED_MAP_SKIP_LIST, &cmp_concurrent_map, NULL, owned ? &free_concurrent_value : NULL, NULL);
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    workers[i].map = &map;
+    workers[i].update = owned ? &count_owned : &count_word;
+    pthread_create(&workers[i].thread, NULL, &run_upsert_worker, &workers[i]);
+  }
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  // no increment is lost to a concurrent upsert of the same key
+  assert(ordered_map_size(&map) == UPSERT_KEYS);
+  for(uintptr_t key = 0; key < UPSERT_KEYS; ++key){
+    void * value = ordered_map_get(&map, (void *)key);
+    assert((owned ? *(uintptr_t *)value : (uintptr_t)value) == CONCURRENT_THREADS * UPSERT_ROUNDS);
+    (void)value;
+  }
+  ordered_map_free(&map);
+  // every value made by an update is freed, whether it was stored, replaced or discarded
+  assert(atomic_load(&concurrent_frees) == atomic_load(&upsert_allocations));
+}
+
+#define FROZEN_KEYS 1000
+
+static void test_frozen_map(enum ordered_map_engine engine){
+  struct ordered_map map;
+
+  atomic_store(&concurrent_frees, 0);
+  ordered_map_init_engine(&map, engine, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  ordered_map_freeze(&map);
+  assert(ordered_map_is_empty(&map) && ordered_map_get(&map, NULL) == NULL);
+  ordered_map_free(&map);
+
+  ordered_map_init_engine(&map, engine, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  for(uintptr_t key = 0; key < 2 * FROZEN_KEYS; key += 2){
+    ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+  }
+  ordered_map_insert(&map, (void *)0, new_concurrent_value(0));
+  ordered_map_delete(&map, (void *)2);
+  ordered_map_freeze(&map);
+  assert(atomic_load(&concurrent_frees) == 2);
+  assert(map.engine == ORDERED_MAP_FROZEN);
+  assert(ordered_map_size(&map) == FROZEN_KEYS - 1);
+
+  for(uintptr_t key = 0; key <= 2 * FROZEN_KEYS; ++key){
+    uintptr_t * value = ordered_map_get(&map, (void *)key);
+    assert((key % 2 == 1 || key == 2 || key == 2 * FROZEN_KEYS) == (value == NULL));
+    (void)value;
+    assert(value == NULL || *value == key);
+  }
+  assert(ordered_map_rank(&map, (void *)3) == 1);
+  assert(ordered_map_select(&map, 1)->key == (void *)4);
+  assert(ordered_map_select(&map, FROZEN_KEYS - 1) == NULL);
+
+  struct ordered_map_range range;
+  uintptr_t key = 4;
+  ordered_map_range_init(&range, &map, (void *)1, (void *)(2 * FROZEN_KEYS));
+  for(struct ordered_map_entry * entry = ordered_map_range_next(&range); entry != NULL; entry = ordered_map_range_next(&range)){
+    assert(entry->key == (void *)key);
+    key += 2;
+  }
+  assert(key == 2 * FROZEN_KEYS);
+  assert(ordered_map_count_range(&map, (void *)1, (void *)101) == 49);
+
+  ordered_map_free(&map);
+  assert(atomic_load(&concurrent_frees) == FROZEN_KEYS + 1);
+}
+
+#define SHARDED_KEYS 4096
+
+#define SHARDED_SHARDS 4
+
+static int cmp_sharded_map(const struct sharded_ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static void free_sharded_value(struct sharded_ordered_map * map, void * value){
+  atomic_fetch_add(&concurrent_frees, 1);
+  free(value);
+}
+
+struct sharded_worker{
+  struct sharded_ordered_map * map;
+  uintptr_t first_key;
+  pthread_t thread;
+};
+
+static void * run_sharded_worker(void * data){
+  struct sharded_worker * worker = (struct sharded_worker *)data;
+  for(uintptr_t key = SHARDED_KEYS + worker->first_key; key < 2 * SHARDED_KEYS; key += CONCURRENT_THREADS){
+    bool replaced = sharded_ordered_map_insert(worker->map, (void *)key, new_concurrent_value(key));
+    uintptr_t * value = sharded_ordered_map_get(worker->map, (void *)key);
+    assert(!replaced && value != NULL && *value == key);
+    (void)replaced;
+    (void)value;
+  }
+  return NULL;
+}
+
+/**
+ * Checks that a scan of [low, high) finds the keys present after test_sharded_map deleted the odd keys below 100
+ */
+static void check_sharded_scan(struct sharded_ordered_map * map, uintptr_t low, uintptr_t high){
+  struct ordered_map_entry * entries;
+  size_t count = sharded_ordered_map_scan(map, (void *)low, (void *)high, &entries);
+  size_t i = 0;
+  for(uintptr_t key = low; key < high; ++key){
+    if(key >= 100 || key % 2 == 0){
+      assert(i < count && entries[i].key == (void *)key && *(uintptr_t *)entries[i].value == key);
+      ++i;
+    }
+  }
+  assert(i == count);
+  (void)count;
+  free(entries);
+}
+
+#define SHARED_KEYS 64
+
+#define SHARED_ROUNDS 100
+
+static void free_poisoned_sharded_value(struct sharded_ordered_map * map, void * value){
+  *(uintptr_t *)value = UINTPTR_MAX;
+  free_sharded_value(map, value);
+}
+
+static void check_sharded_value(struct sharded_ordered_map * map, const struct ordered_map_entry * entry, void * data){
+  sched_yield();
+  assert(*(uintptr_t *)entry->value == (uintptr_t)entry->key);
+}
+
+/**
+ * Replaces the values of keys shared by all threads, reading each key right after replacing it
+ */
+static void * run_shared_sharded_worker(void * data){
+  struct sharded_ordered_map * map = (struct sharded_ordered_map *)data;
+  for(size_t round = 0; round < SHARED_ROUNDS; ++round){
+    for(uintptr_t key = 0; key < SHARED_KEYS; ++key){
+      sharded_ordered_map_insert(map, (void *)key, new_concurrent_value(key));
+      bool found = sharded_ordered_map_visit(map, (void *)key, &check_sharded_value, NULL);
+      assert(found);
+      (void)found;
+    }
+  }
+  return NULL;
+}
+
+static void test_sharded_visit(){
+  struct sharded_ordered_map map;
+  pthread_t threads[CONCURRENT_THREADS];
+
+  atomic_store(&concurrent_frees, 0);
+  sharded_ordered_map_init(&map, SHARDED_SHARDS, &cmp_sharded_map, NULL, NULL, &free_poisoned_sharded_value, NULL);
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_create(&threads[i], NULL, &run_shared_sharded_worker, &map);
+  }
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_join(threads[i], NULL);
+  }
+  assert(sharded_ordered_map_size(&map) == SHARED_KEYS);
+  assert(!sharded_ordered_map_visit(&map, (void *)(uintptr_t)SHARED_KEYS, &check_sharded_value, NULL));
+  sharded_ordered_map_free(&map);
+  assert(atomic_load(&concurrent_frees) == CONCURRENT_THREADS * SHARED_KEYS * SHARED_ROUNDS);
+}
+
+static void test_sharded_map(){
+  struct sharded_ordered_map map;
+
+  atomic_store(&concurrent_frees, 0);
+  sharded_ordered_map_init(&map, SHARDED_SHARDS, &cmp_sharded_map, NULL, NULL, &free_sharded_value, NULL);
+  for(uintptr_t key = 0; key < SHARDED_KEYS; ++key){
+    bool replaced = sharded_ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+    assert(!replaced);
+    (void)replaced;
+  }
+  bool replaced = sharded_ordered_map_insert(&map, (void *)0, new_concurrent_value(0));
+  assert(replaced);
+  (void)replaced;
+  for(uintptr_t key = 1; key < 100; key += 2){
+    bool deleted = sharded_ordered_map_delete(&map, (void *)key);
+    assert(deleted);
+    (void)deleted;
+  }
+  bool deleted = sharded_ordered_map_delete(&map, (void *)1);
+  assert(!deleted);
+  (void)deleted;
+  assert(sharded_ordered_map_size(&map) == SHARDED_KEYS - 50);
+
+  // ascending inserts pile up in the last shard until the split keys move
+  assert(atomic_load(&map.rebalances) > 0 && map.split_count == SHARDED_SHARDS - 1);
+  size_t total = 0;
+  for(size_t i = 0; i < SHARDED_SHARDS; ++i){
+    struct sharded_ordered_map_stats stats;
+    sharded_ordered_map_get_stats(&map, i, &stats);
+    assert(stats.size > 0 && stats.live_bytes > 0 && stats.peak_bytes >= stats.live_bytes);
+    total += stats.size;
+  }
+  assert(total == SHARDED_KEYS - 50);
+
+  for(uintptr_t key = 0; key <= SHARDED_KEYS; ++key){
+    uintptr_t * value = sharded_ordered_map_get(&map, (void *)key);
+    assert(((key < 100 && key % 2 == 1) || key == SHARDED_KEYS) == (value == NULL));
+    (void)value;
+    assert(value == NULL || *value == key);
+  }
+  check_sharded_scan(&map, 0, SHARDED_KEYS);
+  check_sharded_scan(&map, 51, 3000);
+  check_sharded_scan(&map, 7, 7);
+
+  struct task_pool pool;
+  task_pool_init(&pool, SHARDED_SHARDS);
+  sharded_ordered_map_set_task_pool(&map, &pool);
+  check_sharded_scan(&map, 0, SHARDED_KEYS);
+  check_sharded_scan(&map, 1000, 1001);
+
+  struct sharded_worker workers[CONCURRENT_THREADS];
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    workers[i].map = &map;
+    workers[i].first_key = i;
+    pthread_create(&workers[i].thread, NULL, &run_sharded_worker, &workers[i]);
+  }
+  for(size_t i = 0; i < CONCURRENT_THREADS; ++i){
+    pthread_join(workers[i].thread, NULL);
+  }
+  assert(sharded_ordered_map_size(&map) == 2 * SHARDED_KEYS - 50);
+  check_sharded_scan(&map, 0, 2 * SHARDED_KEYS);
+
+  sharded_ordered_map_rebalance(&map);
+  check_sharded_scan(&map, 0, 2 * SHARDED_KEYS);
+  sharded_ordered_map_free(&map);
+  task_pool_destroy(&pool);
+  assert(atomic_load(&concurrent_frees) == 2 * SHARDED_KEYS + 1);
+}
+
+#define RECLAIM_KEYS 1000
+
+#define RECLAIM_BUDGET 64
+
+static int compare_key(const struct rb_tree * tree, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static void count_reclaimed(struct rb_tree * tree, void * value){
+  atomic_fetch_add(&concurrent_frees, 1);
+}
+
+static void test_incremental_free(){
+  struct rb_tree tree;
+
+  atomic_store(&concurrent_frees, 0);
+  rb_tree_init(&tree, &compare_key, &count_reclaimed, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    rb_tree_insert(&tree, (void *)key);
+  }
+  size_t steps = 1;
+  while(!rb_tree_free_incremental(&tree, RECLAIM_BUDGET)){
+    assert(atomic_load(&concurrent_frees) == steps * RECLAIM_BUDGET);
+    ++steps;
+  }
+  assert(steps == (RECLAIM_KEYS + RECLAIM_BUDGET - 1) / RECLAIM_BUDGET);
+  assert(atomic_load(&concurrent_frees) == RECLAIM_KEYS);
+  bool freed = rb_tree_free_incremental(&tree, 1);
+  assert(freed);
+  (void)freed;
+
+  // a private pool is released at once when no value needs freeing
+  rb_tree_init_pooled(&tree, &compare_key, NULL, NULL, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    rb_tree_insert(&tree, (void *)key);
+  }
+  freed = rb_tree_free_incremental(&tree, 1);
+  assert(freed);
+
+  struct rb_tree_reclaimer reclaimer;
+  rb_tree_reclaimer_init(&reclaimer, RECLAIM_BUDGET);
+  atomic_store(&concurrent_frees, 0);
+  rb_tree_init_pooled(&tree, &compare_key, &count_reclaimed, NULL, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    rb_tree_insert(&tree, (void *)key);
+  }
+  rb_tree_reclaimer_submit(&reclaimer, &tree);
+  assert(rb_tree_find(&tree, (void *)1) == NULL);
+  rb_tree_insert(&tree, (void *)1);
+  assert(rb_tree_validate(&tree));
+  rb_tree_reclaimer_drain(&reclaimer);
+  assert(atomic_load(&concurrent_frees) == RECLAIM_KEYS);
+  rb_tree_free(&tree);
+  assert(atomic_load(&concurrent_frees) == RECLAIM_KEYS + 1);
+
+  struct ordered_map map;
+  atomic_store(&concurrent_frees, 0);
+  ordered_map_init(&map, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+  }
+  ordered_map_free_background(&map, &reclaimer);
+  // the reclaimer works on a copy of the map, so the map struct can be reused at once
+  ordered_map_init_engine(&map, ORDERED_MAP_SKIP_LIST, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+  }
+  ordered_map_free_background(&map, &reclaimer);
+  rb_tree_reclaimer_destroy(&reclaimer);
+  assert(atomic_load(&concurrent_frees) == 2 * RECLAIM_KEYS);
+
+  atomic_store(&concurrent_frees, 0);
+  ordered_map_init(&map, &cmp_concurrent_map, NULL, &free_concurrent_value, NULL);
+  for(uintptr_t key = 0; key < RECLAIM_KEYS; ++key){
+    ordered_map_insert(&map, (void *)key, new_concurrent_value(key));
+  }
+  for(steps = 1; !ordered_map_free_incremental(&map, RECLAIM_BUDGET); ++steps);
+  assert(steps == (RECLAIM_KEYS + RECLAIM_BUDGET - 1) / RECLAIM_BUDGET);
+  assert(atomic_load(&concurrent_frees) == RECLAIM_KEYS);
+}
+
+#define AGGREGATE_KEYS 2000
+
+/**
+ * A sum and a count, with the first and last values to check that ranges are combined in order
+ */
+struct test_aggregate{
+  uintptr_t sum;
+  uintptr_t first;
+  uintptr_t last;
+  size_t count;
+};
+
+static void lift_test_aggregate(const struct rb_tree * tree, void * aggregate, void * value){
+  struct test_aggregate lifted = {(uintptr_t)value, (uintptr_t)value, (uintptr_t)value, 1};
+  *(struct test_aggregate *)aggregate = lifted;
+}
+
+static void combine_test_aggregates(const struct rb_tree * tree, void * result, const void * first, const void * second){
+  const struct test_aggregate * first_aggregate = (const struct test_aggregate *)first;
+  const struct test_aggregate * second_aggregate = (const struct test_aggregate *)second;
+  struct test_aggregate combined = {
+    first_aggregate->sum + second_aggregate->sum,
+    first_aggregate->first,
+    second_aggregate->last,
+    first_aggregate->count + second_aggregate->count
+  };
+  *(struct test_aggregate *)result = combined;
+}
+
+static void check_range_reduce(const struct rb_tree * tree, const bool * present, uintptr_t low, uintptr_t high){
+  struct test_aggregate expected = {0, 0, 0, 0};
+  for(uintptr_t key = low; key < high; ++key){
+    if(present[key]){
+      expected.first = expected.count == 0 ? key : expected.first;
+      expected.last = key;
+      expected.sum += key;
+      ++expected.count;
+    }
+  }
+  struct test_aggregate result;
+  assert(rb_tree_range_reduce(tree, (void *)low, (void *)high, &result) == (expected.count > 0));
+  assert(expected.count == 0 || (result.sum == expected.sum && result.first == expected.first && result.last == expected.last && result.count == expected.count));
+  (void)result;
+}
+
+static void test_aggregates(){
+  struct rb_tree tree;
+  bool present[AGGREGATE_KEYS + 1] = {false};
+
+  rb_tree_init(&tree, &compare_key, NULL, NULL);
+  rb_tree_set_aggregate(&tree, sizeof(struct test_aggregate), &lift_test_aggregate, &combine_test_aggregates);
+  for(uintptr_t i = 0; i < AGGREGATE_KEYS; ++i){
+    uintptr_t key = i * 7919 % AGGREGATE_KEYS;
+    if(i % 4 != 3){
+      rb_tree_insert(&tree, (void *)key);
+      present[key] = true;
+    }
+  }
+  for(uintptr_t key = 0; key < AGGREGATE_KEYS; key += 5){
+    rb_tree_find_and_delete(&tree, (void *)key);
+    present[key] = false;
+  }
+  assert(rb_tree_validate(&tree));
+
+  const struct test_aggregate * total = rb_tree_get_aggregate(&tree, tree.root);
+  assert(total->count == rb_tree_size(&tree));
+  (void)total;
+  check_range_reduce(&tree, present, 0, AGGREGATE_KEYS);
+  check_range_reduce(&tree, present, 5, 5);
+  check_range_reduce(&tree, present, 5, 6);
+  for(uintptr_t low = 0; low < AGGREGATE_KEYS; low += 97){
+    check_range_reduce(&tree, present, low, low + (low * 31) % (AGGREGATE_KEYS - low) + 1);
+  }
+
+  // the aggregates follow the nodes through splits and joins
+  struct rb_tree right;
+  rb_tree_init(&right, &compare_key, NULL, NULL);
+  rb_tree_set_aggregate(&right, sizeof(struct test_aggregate), &lift_test_aggregate, &combine_test_aggregates);
+  rb_tree_split(&tree, (void *)1000, &right);
+  check_range_reduce(&tree, present, 0, 1000);
+  check_range_reduce(&right, present, 1000, AGGREGATE_KEYS);
+  rb_tree_find_and_delete(&right, (void *)1000);
+  present[1000] = true;
+  rb_tree_join(&tree, (void *)1000, &right);
+  check_range_reduce(&tree, present, 0, AGGREGATE_KEYS);
+  check_range_reduce(&tree, present, 990, 1010);
+
+  rb_tree_free(&right);
+  rb_tree_free(&tree);
 }
 
 /**
@@ -88,7 +1431,71 @@ int main(int arg_count, const char ** args){
 
   test_tree();
 
-  test_ordered_map();
+  test_pooled_tree();
+
+  test_validation();
+
+  test_stats();
+
+  test_allocators();
+
+  test_find_batch();
+
+  test_build_sorted();
+
+  test_insert_hint();
+
+  test_order_statistics();
+
+  test_set_operations();
+
+  test_parallel_tree();
+
+  test_typed_tree();
+
+  test_indexed_tree();
+
+  test_persistent_tree();
+
+  test_b_tree(sizeof(uintptr_t));
+
+  test_b_tree(sizeof(struct b_tree_value));
+
+  test_ordered_map(ORDERED_MAP_RB_TREE);
+
+  test_ordered_map(ORDERED_MAP_SKIP_LIST);
+
+  test_ordered_map(ORDERED_MAP_B_TREE);
+
+  test_upsert(ORDERED_MAP_RB_TREE);
+
+  test_upsert(ORDERED_MAP_SKIP_LIST);
+
+  test_upsert(ORDERED_MAP_B_TREE);
+
+  test_concurrent_map();
+
+  test_pinned_reads();
+
+  test_concurrent_upsert(false);
+
+  test_concurrent_upsert(true);
+
+  test_frozen_map(ORDERED_MAP_RB_TREE);
+
+  test_frozen_map(ORDERED_MAP_SKIP_LIST);
+
+  test_frozen_map(ORDERED_MAP_B_TREE);
+
+  test_sharded_map();
+
+  test_sharded_visit();
+
+  test_incremental_free();
+
+  test_aggregates();
+
+  test_unordered_map();
   
   return 0;
 }
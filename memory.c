@@ -18,6 +18,7 @@
 
 #include "memory.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -30,3 +31,282 @@ void * malloc_checked(size_t size){
     return mem;
   }
 }
+
+void * realloc_checked(void * mem, size_t size){
+  void * resized = realloc(mem, size);
+  if(resized == NULL){
+    fputs("unable to allocate memory", stderr);
+    exit(-1);
+  }else{
+    return resized;
+  }
+}
+
+void * malloc_aligned_checked(size_t alignment, size_t size){
+  void * mem = aligned_alloc(alignment, size);
+  if(mem == NULL){
+    fputs("unable to allocate memory", stderr);
+    exit(-1);
+  }else{
+    return mem;
+  }
+}
+
+/*
+ * Allocators
+ */
+
+static void * alloc_libc(struct allocator * allocator, size_t size){
+  return malloc(size);
+}
+
+static void free_libc(struct allocator * allocator, void * mem, size_t size){
+  free(mem);
+}
+
+struct allocator libc_allocator = {.alloc = &alloc_libc, .free = &free_libc, .context = NULL};
+
+void * allocator_alloc(struct allocator * allocator, size_t size){
+  assert(allocator != NULL);
+
+  void * mem = (*allocator->alloc)(allocator, size);
+  if(mem == NULL){
+    fputs("unable to allocate memory", stderr);
+    exit(-1);
+  }else{
+    return mem;
+  }
+}
+
+void allocator_free(struct allocator * allocator, void * mem, size_t size){
+  assert(allocator != NULL);
+  assert(mem != NULL);
+  (*allocator->free)(allocator, mem, size);
+}
+
+static void * alloc_accounted(struct allocator * allocator, size_t size){
+  struct accounting_allocator * accounting = (struct accounting_allocator *)allocator->context;
+  void * mem = (*accounting->parent->alloc)(accounting->parent, size);
+  if(mem != NULL){
+    accounting->live += size;
+    ++accounting->blocks;
+    if(accounting->live > accounting->peak){
+      accounting->peak = accounting->live;
+    }
+  }
+  return mem;
+}
+
+static void free_accounted(struct allocator * allocator, void * mem, size_t size){
+  struct accounting_allocator * accounting = (struct accounting_allocator *)allocator->context;
+  assert(accounting->live >= size && accounting->blocks > 0);
+  accounting->live -= size;
+  --accounting->blocks;
+  (*accounting->parent->free)(accounting->parent, mem, size);
+}
+
+void accounting_allocator_init(struct accounting_allocator * accounting, struct allocator * parent){
+  assert(accounting != NULL);
+  assert(parent != NULL);
+
+  accounting->allocator.alloc = &alloc_accounted;
+  accounting->allocator.free = &free_accounted;
+  accounting->allocator.context = accounting;
+  accounting->parent = parent;
+  accounting->live = 0;
+  accounting->peak = 0;
+  accounting->blocks = 0;
+}
+
+/**
+ * The header of a chunk of an arena, padded so the blocks following it are aligned for any type
+ */
+struct arena_chunk{
+
+  /**
+   * The next chunk
+   */
+  struct arena_chunk * next;
+
+  /**
+   * The size of the chunk including the header
+   */
+  size_t size;
+} __attribute__((aligned(16)));
+
+/**
+ * The alignment of the blocks of an arena
+ */
+#define ARENA_ALIGNMENT 16
+
+static void * alloc_arena(struct allocator * allocator, size_t size){
+  struct arena_allocator * arena = (struct arena_allocator *)allocator->context;
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if(arena->next == NULL || (size_t)(arena->end - arena->next) < size){
+    size_t chunk_size = sizeof(struct arena_chunk) + size > ARENA_CHUNK_SIZE ? sizeof(struct arena_chunk) + size : ARENA_CHUNK_SIZE;
+    struct arena_chunk * chunk = (*arena->parent->alloc)(arena->parent, chunk_size);
+    if(chunk == NULL){
+      return NULL;
+    }
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    arena->chunks = chunk;
+    arena->next = (char *)(chunk + 1);
+    arena->end = (char *)chunk + chunk_size;
+  }
+  void * mem = arena->next;
+  arena->next += size;
+  return mem;
+}
+
+static void free_arena(struct allocator * allocator, void * mem, size_t size){}
+
+void arena_allocator_init(struct arena_allocator * arena, struct allocator * parent){
+  assert(arena != NULL);
+  assert(parent != NULL);
+
+  arena->allocator.alloc = &alloc_arena;
+  arena->allocator.free = &free_arena;
+  arena->allocator.context = arena;
+  arena->parent = parent;
+  arena->chunks = NULL;
+  arena->next = NULL;
+  arena->end = NULL;
+}
+
+void arena_allocator_destroy(struct arena_allocator * arena){
+  assert(arena != NULL);
+
+  while(arena->chunks != NULL){
+    struct arena_chunk * chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    (*arena->parent->free)(arena->parent, chunk, chunk->size);
+  }
+  arena->next = NULL;
+  arena->end = NULL;
+}
+
+/*
+ * Memory pools
+ */
+
+/**
+ * The header of a slab or large block
+ */
+struct memory_slab{
+
+  /**
+   * The next slab
+   */
+  struct memory_slab * next;
+
+  /**
+   * The previous slab, only used for large blocks
+   */
+  struct memory_slab * previous;
+};
+
+void memory_pool_init(struct memory_pool * pool){
+  assert(pool != NULL);
+
+  for(size_t i = 0; i < MEMORY_POOL_CLASS_COUNT; ++i){
+    pool->classes[i].free_list = NULL;
+    pool->classes[i].next = NULL;
+    pool->classes[i].end = NULL;
+  }
+  pool->slabs = NULL;
+  pool->large = NULL;
+}
+
+/**
+ * Returns the index of the size class for the requested size
+ * @param size the size in bytes
+ * @return the index of the size class or MEMORY_POOL_CLASS_COUNT if the block is too large
+ */
+static size_t get_class_index(size_t size){
+  if(size == 0){
+    return 0;
+  }else{
+    size_t index = (size - 1) / MEMORY_POOL_GRANULE;
+    return index < MEMORY_POOL_CLASS_COUNT ? index : MEMORY_POOL_CLASS_COUNT;
+  }
+}
+
+void * memory_pool_alloc(struct memory_pool * pool, size_t size){
+  assert(pool != NULL);
+
+  size_t index = get_class_index(size);
+  if(index == MEMORY_POOL_CLASS_COUNT){
+    struct memory_slab * block = malloc_checked(sizeof(struct memory_slab) + size);
+    block->previous = NULL;
+    block->next = pool->large;
+    if(pool->large != NULL){
+      pool->large->previous = block;
+    }
+    pool->large = block;
+    return block + 1;
+  }
+
+  struct memory_pool_class * class = &pool->classes[index];
+  if(class->free_list != NULL){
+    void * mem = class->free_list;
+    class->free_list = *(void **)mem;
+    return mem;
+  }
+
+  size_t block_size = (index + 1) * MEMORY_POOL_GRANULE;
+  if(class->next == NULL || (size_t)(class->end - class->next) < block_size){
+    struct memory_slab * slab = malloc_checked(MEMORY_POOL_SLAB_SIZE);
+    slab->next = pool->slabs;
+    slab->previous = NULL;
+    pool->slabs = slab;
+    class->next = (char *)(slab + 1);
+    class->end = (char *)slab + MEMORY_POOL_SLAB_SIZE;
+  }
+  void * mem = class->next;
+  class->next += block_size;
+  return mem;
+}
+
+void memory_pool_free(struct memory_pool * pool, void * mem, size_t size){
+  assert(pool != NULL);
+  assert(mem != NULL);
+
+  size_t index = get_class_index(size);
+  if(index == MEMORY_POOL_CLASS_COUNT){
+    struct memory_slab * block = (struct memory_slab *)mem - 1;
+    if(block->previous == NULL){
+      pool->large = block->next;
+    }else{
+      block->previous->next = block->next;
+    }
+    if(block->next != NULL){
+      block->next->previous = block->previous;
+    }
+    free(block);
+  }else{
+    struct memory_pool_class * class = &pool->classes[index];
+    *(void **)mem = class->free_list;
+    class->free_list = mem;
+  }
+}
+
+/**
+ * Frees a linked list of slabs
+ * @param slab the first slab in the list or NULL
+ */
+static void free_slabs(struct memory_slab * slab){
+  while(slab != NULL){
+    struct memory_slab * next = slab->next;
+    free(slab);
+    slab = next;
+  }
+}
+
+void memory_pool_destroy(struct memory_pool * pool){
+  assert(pool != NULL);
+
+  free_slabs(pool->slabs);
+  free_slabs(pool->large);
+  memory_pool_init(pool);
+}
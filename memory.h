@@ -28,4 +28,274 @@
  */
 void * malloc_checked(size_t size);
 
+/**
+ * Resizes a block allocated with malloc_checked or exits the program
+ * @param mem the block or NULL
+ * @param size the new size of the block in bytes
+ * @return a pointer to the resized block, which may have moved
+ */
+void * realloc_checked(void * mem, size_t size);
+
+/**
+ * Allocates the requested memory at an aligned address or exits the program
+ * The memory is released with free
+ * @param alignment the alignment in bytes, a power of two
+ * @param size the size of the block to allocate in bytes, a multiple of the alignment
+ * @return a pointer to the allocated memory
+ */
+void * malloc_aligned_checked(size_t alignment, size_t size);
+
+/*
+ * Allocators
+ */
+
+struct allocator;
+
+/**
+ * A function pointer type for allocating memory from an allocator
+ * Signature: void * fn(struct allocator *, size_t size)
+ * Returns the memory or NULL if it cannot be allocated
+ */
+typedef void * (*allocator_alloc_f)(struct allocator *, size_t);
+
+/**
+ * A function pointer type for returning memory to an allocator
+ * Signature: void fn(struct allocator *, void * mem, size_t size)
+ * The size is the size the memory was allocated with
+ */
+typedef void (*allocator_free_f)(struct allocator *, void *, size_t);
+
+/**
+ * An allocator that data structures take their memory from
+ * Allocators are not thread safe unless documented otherwise
+ */
+struct allocator{
+
+  /**
+   * The allocation function
+   */
+  allocator_alloc_f alloc;
+
+  /**
+   * The free function
+   */
+  allocator_free_f free;
+
+  /**
+   * Extra state for the allocator
+   */
+  void * context;
+};
+
+/**
+ * The allocator backed by malloc and free, which is thread safe
+ */
+extern struct allocator libc_allocator;
+
+/**
+ * Allocates memory from an allocator or exits the program
+ * @param allocator the allocator
+ * @param size the size of the block in bytes
+ * @return a pointer to the allocated memory, aligned for any type
+ */
+void * allocator_alloc(struct allocator * allocator, size_t size);
+
+/**
+ * Returns memory to an allocator
+ * @param allocator the allocator the memory was allocated from
+ * @param mem the memory
+ * @param size the size the memory was allocated with
+ */
+void allocator_free(struct allocator * allocator, void * mem, size_t size);
+
+/**
+ * An allocator that counts the bytes allocated through it from another allocator
+ * Giving each tree or map its own accounting allocator measures how much memory it holds,
+ * which callers can check against a budget before inserting
+ */
+struct accounting_allocator{
+
+  /**
+   * The allocator to pass to data structures, its context is this struct
+   */
+  struct allocator allocator;
+
+  /**
+   * The allocator the memory comes from
+   */
+  struct allocator * parent;
+
+  /**
+   * The number of bytes allocated and not freed
+   */
+  size_t live;
+
+  /**
+   * The largest value live has had
+   */
+  size_t peak;
+
+  /**
+   * The number of blocks allocated and not freed
+   */
+  size_t blocks;
+};
+
+/**
+ * Initializes an accounting allocator with no live bytes
+ * @param accounting the allocator
+ * @param parent the allocator the memory comes from
+ */
+void accounting_allocator_init(struct accounting_allocator * accounting, struct allocator * parent);
+
+/**
+ * The size of the chunks an arena allocator takes from its parent, unless a block is larger
+ */
+#define ARENA_CHUNK_SIZE 65536
+
+/**
+ * The header of a chunk owned by an arena allocator
+ */
+struct arena_chunk;
+
+/**
+ * An allocator that bumps a pointer through large chunks and frees them all at once
+ * Freeing a single block does nothing, the memory is only reused after the arena is reset or destroyed
+ */
+struct arena_allocator{
+
+  /**
+   * The allocator to pass to data structures, its context is this struct
+   */
+  struct allocator allocator;
+
+  /**
+   * The allocator the chunks come from
+   */
+  struct allocator * parent;
+
+  /**
+   * All chunks of the arena, the current one first
+   */
+  struct arena_chunk * chunks;
+
+  /**
+   * The next unused byte of the current chunk
+   */
+  char * next;
+
+  /**
+   * The end of the current chunk
+   */
+  char * end;
+};
+
+/**
+ * Initializes an empty arena
+ * @param arena the arena
+ * @param parent the allocator the chunks come from
+ */
+void arena_allocator_init(struct arena_allocator * arena, struct allocator * parent);
+
+/**
+ * Returns all chunks of an arena to its parent, invalidating all blocks allocated from it
+ * The arena may be used again afterwards
+ * @param arena the arena
+ */
+void arena_allocator_destroy(struct arena_allocator * arena);
+
+/**
+ * The granularity of the size classes of a memory pool in bytes
+ */
+#define MEMORY_POOL_GRANULE 16
+
+/**
+ * The number of size classes in a memory pool
+ * Blocks larger than MEMORY_POOL_GRANULE * MEMORY_POOL_CLASS_COUNT bytes bypass the slabs
+ */
+#define MEMORY_POOL_CLASS_COUNT 16
+
+/**
+ * The size of a single slab in bytes
+ */
+#define MEMORY_POOL_SLAB_SIZE 65536
+
+/**
+ * A slab or a large block owned by a memory pool
+ */
+struct memory_slab;
+
+/**
+ * The state of a single size class in a memory pool
+ */
+struct memory_pool_class{
+
+  /**
+   * A singly linked list of released blocks
+   */
+  void * free_list;
+
+  /**
+   * The next unused block in the current slab
+   */
+  char * next;
+
+  /**
+   * The end of the current slab
+   */
+  char * end;
+};
+
+/**
+ * A pool of fixed size blocks, allocated from slabs per size class
+ * Blocks are handed out by popping the free list of their class or by bumping a pointer in the current slab
+ * A pool is not thread safe
+ */
+struct memory_pool{
+
+  /**
+   * The size classes
+   */
+  struct memory_pool_class classes[MEMORY_POOL_CLASS_COUNT];
+
+  /**
+   * All slabs allocated by the pool
+   */
+  struct memory_slab * slabs;
+
+  /**
+   * All blocks too large for any size class
+   */
+  struct memory_slab * large;
+};
+
+/**
+ * Initializes an empty memory pool
+ * @param pool the pool
+ */
+void memory_pool_init(struct memory_pool * pool);
+
+/**
+ * Allocates a block from the pool or exits the program
+ * @param pool the pool
+ * @param size the size of the block in bytes
+ * @return a pointer to the block
+ */
+void * memory_pool_alloc(struct memory_pool * pool, size_t size);
+
+/**
+ * Returns a block to the pool
+ * @param pool the pool
+ * @param mem a block allocated from this pool
+ * @param size the size the block was allocated with
+ */
+void memory_pool_free(struct memory_pool * pool, void * mem, size_t size);
+
+/**
+ * Releases all memory held by the pool at once, including blocks that were not freed
+ * Does not free the pool struct itself
+ * @param pool the pool
+ */
+void memory_pool_destroy(struct memory_pool * pool);
+
 #endif
@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void default_free_key(struct ordered_map * map, void * key){}
 
@@ -38,14 +39,103 @@ static void free_entry(struct rb_tree * tree, void * value){
   struct ordered_map_entry * entry = (struct ordered_map_entry *)value;
   (*map->free_key)(map, entry->key);
   (*map->free_value)(map, entry->value);
-  free(entry);
 }
 
-void ordered_map_init(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state){
+static int cmp_list_entry(const struct skip_list * list, void * first, void * second){
+  struct ordered_map * map = (struct ordered_map *)list->state;
+  struct ordered_map_entry * first_entry = (struct ordered_map_entry *)first;
+  struct ordered_map_entry * second_entry = (struct ordered_map_entry *)second;
+  return (*map->cmp)(map, first_entry->key, second_entry->key);
+}
+
+static void free_list_entry(struct skip_list * list, void * value){
+  struct ordered_map * map = (struct ordered_map *)list->state;
+  struct ordered_map_entry * entry = (struct ordered_map_entry *)value;
+  (*map->free_key)(map, entry->key);
+  (*map->free_value)(map, entry->value);
+}
+
+static int cmp_b_tree_entry(const struct b_tree * tree, void * first, void * second){
+  struct ordered_map * map = (struct ordered_map *)tree->state;
+  struct ordered_map_entry * first_entry = (struct ordered_map_entry *)first;
+  struct ordered_map_entry * second_entry = (struct ordered_map_entry *)second;
+  return (*map->cmp)(map, first_entry->key, second_entry->key);
+}
+
+static void free_b_tree_entry(struct b_tree * tree, void * value){
+  struct ordered_map * map = (struct ordered_map *)tree->state;
+  struct ordered_map_entry * entry = (struct ordered_map_entry *)value;
+  (*map->free_key)(map, entry->key);
+  (*map->free_value)(map, entry->value);
+}
+
+static int cmp_frozen_entry(const struct eytzinger_array * array, void * first, void * second){
+  struct ordered_map * map = (struct ordered_map *)array->state;
+  struct ordered_map_entry * first_entry = (struct ordered_map_entry *)first;
+  struct ordered_map_entry * second_entry = (struct ordered_map_entry *)second;
+  return (*map->cmp)(map, first_entry->key, second_entry->key);
+}
+
+static void free_frozen_entry(struct eytzinger_array * array, void * value){
+  struct ordered_map * map = (struct ordered_map *)array->state;
+  struct ordered_map_entry * entry = (struct ordered_map_entry *)value;
+  (*map->free_key)(map, entry->key);
+  (*map->free_value)(map, entry->value);
+}
+
+/**
+ * Frees a value replaced by an insert into a skip list, once no reader can see it anymore
+ */
+static void free_list_value(struct skip_list * list, void * value){
+  struct ordered_map * map = (struct ordered_map *)list->state;
+  (*map->free_value)(map, value);
+}
+
+/**
+ * Returns the skip list of a map
+ * Lookups register the calling thread with the list for reclamation, which does not change the contents of the map
+ */
+static inline struct skip_list * get_list(const struct ordered_map * map){
+  return (struct skip_list *)&map->list;
+}
+
+/**
+ * Counts the entries of a skip list with keys in [low, high) by walking them
+ * @param bounded false to count from the first entry, ignoring low
+ */
+static size_t count_list_range(const struct ordered_map * map, void * low, bool bounded, void * high){
+  struct skip_list * list = get_list(map);
+  struct ordered_map_entry low_seek = {low, NULL};
+  size_t count = 0;
+  skip_list_pin(list);
+  void * entry = bounded ? skip_list_lower_bound(list, &low_seek) : skip_list_get_begin(list);
+  while(entry != NULL && (*map->cmp)(map, ((struct ordered_map_entry *)entry)->key, high) < 0){
+    ++count;
+    entry = skip_list_get_next(list, entry);
+  }
+  skip_list_unpin(list);
+  return count;
+}
+
+/**
+ * Returns the free function for the entries of the tree
+ * Entries are stored inside the nodes, so they only need a free function if the keys or values do
+ */
+static rb_apply_f get_free_entry(const struct ordered_map * map){
+  if(map->free_key == default_free_key && map->free_value == default_free_value){
+    return NULL;
+  }else{
+    return &free_entry;
+  }
+}
+
+/**
+ * Initializes the fields of the map, except for the tree
+ */
+static void init_map(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state){
   assert(map != NULL);
   assert(cmp != NULL);
 
-  rb_tree_init(&map->tree, &cmp_entry, &free_entry, map);
   map->cmp = cmp;
 
   if(free_key == NULL){
@@ -62,20 +152,249 @@ void ordered_map_init(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_m
   map->state = state;
 }
 
+void ordered_map_init(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state){
+  ordered_map_init_engine(map, ORDERED_MAP_RB_TREE, cmp, free_key, free_value, state);
+}
+
+void ordered_map_init_engine(struct ordered_map * map, enum ordered_map_engine engine, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state){
+  init_map(map, cmp, free_key, free_value, state);
+  map->engine = engine;
+  switch(engine){
+  case ORDERED_MAP_RB_TREE:
+    rb_tree_init(&map->tree, &cmp_entry, get_free_entry(map), map);
+    rb_tree_set_inline_values(&map->tree, sizeof(struct ordered_map_entry));
+    break;
+  case ORDERED_MAP_SKIP_LIST:
+    skip_list_init(&map->list, &cmp_list_entry, get_free_entry(map) == NULL ? NULL : &free_list_entry, map, sizeof(struct ordered_map_entry));
+    break;
+  case ORDERED_MAP_B_TREE:
+    b_tree_init(&map->b_tree, &cmp_b_tree_entry, get_free_entry(map) == NULL ? NULL : &free_b_tree_entry, map, sizeof(struct ordered_map_entry));
+    break;
+  case ORDERED_MAP_FROZEN:
+    // frozen maps are only made by ordered_map_freeze
+    assert(false);
+    break;
+  }
+}
+
+void ordered_map_init_pooled(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state, struct memory_pool * pool){
+  init_map(map, cmp, free_key, free_value, state);
+  map->engine = ORDERED_MAP_RB_TREE;
+  rb_tree_init_pooled(&map->tree, &cmp_entry, get_free_entry(map), map, pool);
+  rb_tree_set_inline_values(&map->tree, sizeof(struct ordered_map_entry));
+}
+
+void ordered_map_init_allocator(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state, struct allocator * allocator){
+  init_map(map, cmp, free_key, free_value, state);
+  map->engine = ORDERED_MAP_RB_TREE;
+  rb_tree_init_allocator(&map->tree, &cmp_entry, get_free_entry(map), map, allocator);
+  rb_tree_set_inline_values(&map->tree, sizeof(struct ordered_map_entry));
+}
+
+/**
+ * Inserts an entry in a skip list, replacing the value of an existing entry
+ * Values are read and replaced atomically, so concurrent readers see either the old or the new value
+ * @param replaced set to true if the key was already in the map
+ * @return the entry holding the key
+ */
+static struct ordered_map_entry * insert_list_entry(struct ordered_map * map, void * key, void * value, bool * replaced){
+  struct ordered_map_entry entry = {key, value};
+  bool inserted;
+  skip_list_pin(&map->list);
+  struct ordered_map_entry * stored = (struct ordered_map_entry *)skip_list_insert(&map->list, &entry, &inserted);
+  if(!inserted){
+    (*map->free_key)(map, key);
+    void * old_value = __atomic_exchange_n(&stored->value, value, __ATOMIC_ACQ_REL);
+    if(map->free_value != default_free_value){
+      skip_list_retire(&map->list, old_value, &free_list_value);
+    }
+  }
+  skip_list_unpin(&map->list);
+  *replaced = !inserted;
+  return stored;
+}
+
 bool ordered_map_insert(struct ordered_map * map, void * key, void * value){
   assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    bool replaced;
+    insert_list_entry(map, key, value, &replaced);
+    return replaced;
+  }
   
-  struct ordered_map_entry * entry = (struct ordered_map_entry *)malloc_checked(sizeof(struct ordered_map_entry));
-  entry->key = key;
-  entry->value = value;
+  struct ordered_map_entry entry = {key, value};
+  if(map->engine == ORDERED_MAP_B_TREE){
+    bool replaced;
+    b_tree_insert(&map->b_tree, &entry, &replaced);
+    return replaced;
+  }
+  return rb_tree_insert(&map->tree, &entry);
+}
+
+struct ordered_map_entry * ordered_map_insert_hint(struct ordered_map * map, struct ordered_map_entry * hint, void * key, void * value){
+  assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    bool replaced;
+    return insert_list_entry(map, key, value, &replaced);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    // descending a B+ tree misses the cache about as often as a hinted insert into a binary tree, so the hint is ignored
+    struct ordered_map_entry entry = {key, value};
+    return (struct ordered_map_entry *)b_tree_insert(&map->b_tree, &entry, NULL);
+  }
+
+  struct rb_node * hint_node = hint == NULL ? NULL : rb_tree_get_node(&map->tree, hint);
+  struct ordered_map_entry entry = {key, value};
+  struct rb_node * node = rb_tree_insert_hint(&map->tree, hint_node, &entry);
+  return (struct ordered_map_entry *)rb_tree_get_value(&map->tree, node);
+}
 
-  return rb_tree_insert(&map->tree, entry);
+/**
+ * Inserts an entry unless the key is present, with a single descent
+ * @param inserted set to true if the entry was inserted
+ * @return the entry holding the key
+ */
+static struct ordered_map_entry * find_or_insert_entry(struct ordered_map * map, void * key, void * value, bool * inserted){
+  struct ordered_map_entry entry = {key, value};
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return (struct ordered_map_entry *)skip_list_insert(&map->list, &entry, inserted);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return (struct ordered_map_entry *)b_tree_find_or_insert(&map->b_tree, &entry, inserted);
+  }
+  struct rb_node * node = rb_tree_find_or_insert(&map->tree, &entry, inserted);
+  return (struct ordered_map_entry *)rb_tree_get_value(&map->tree, node);
+}
+
+struct ordered_map_entry * ordered_map_get_or_insert(struct ordered_map * map, void * key, void * value, bool * inserted){
+  assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  bool entry_inserted;
+  struct ordered_map_entry * entry = find_or_insert_entry(map, key, value, &entry_inserted);
+  if(inserted != NULL){
+    *inserted = entry_inserted;
+  }
+  return entry;
+}
+
+bool ordered_map_try_insert(struct ordered_map * map, void * key, void * value){
+  assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  bool inserted;
+  find_or_insert_entry(map, key, value, &inserted);
+  return inserted;
+}
+
+bool ordered_map_upsert(struct ordered_map * map, void * key, ordered_map_update_f update, void * data){
+  assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+  assert(update != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    // a published entry must never be seen without its value, so a new value is made before the entry is inserted,
+    // and the value of an existing entry is only replaced atomically, by updating a copy of the entry
+    struct ordered_map_entry copy = {key, NULL};
+    bool inserted = false;
+    skip_list_pin(&map->list);
+    struct ordered_map_entry * entry = (struct ordered_map_entry *)skip_list_find(&map->list, &copy);
+    if(entry == NULL){
+      (*update)(map, &copy, data);
+      entry = (struct ordered_map_entry *)skip_list_insert(&map->list, &copy, &inserted);
+      if(!inserted && copy.value != NULL){
+	// another thread inserted the key first, the new value was never published
+	(*map->free_value)(map, copy.value);
+      }
+    }
+    if(!inserted){
+      void * value = __atomic_load_n(&entry->value, __ATOMIC_ACQUIRE);
+      while(true){
+	void * old_value = value;
+	copy.key = entry->key;
+	copy.value = old_value;
+	(*update)(map, &copy, data);
+	if(__atomic_compare_exchange_n(&entry->value, &value, copy.value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+	  break;
+	}
+	// another thread changed the value first, the value made by this run was never published
+	if(copy.value != old_value && copy.value != NULL){
+	  (*map->free_value)(map, copy.value);
+	}
+      }
+      if(copy.value != value && map->free_value != default_free_value){
+	skip_list_retire(&map->list, value, &free_list_value);
+      }
+    }
+    skip_list_unpin(&map->list);
+    return inserted;
+  }
+
+  bool inserted;
+  struct ordered_map_entry * entry = find_or_insert_entry(map, key, NULL, &inserted);
+  (*update)(map, entry, data);
+  return inserted;
+}
+
+/**
+ * The state of a bulk construction from key and value arrays
+ */
+struct entry_iterator{
+  void ** keys;
+  void ** values;
+  struct ordered_map_entry entry;
+};
+
+static void * next_entry(struct entry_iterator * entries){
+  entries->entry.key = *entries->keys++;
+  entries->entry.value = *entries->values++;
+  return &entries->entry;
+}
+
+static void * next_tree_entry(struct rb_tree * tree, void * iterator){
+  return next_entry((struct entry_iterator *)iterator);
+}
+
+static void * next_b_tree_entry(struct b_tree * tree, void * iterator){
+  return next_entry((struct entry_iterator *)iterator);
+}
+
+void ordered_map_build_sorted(struct ordered_map * map, void ** keys, void ** values, size_t count){
+  assert(map != NULL);
+  assert(count == 0 || (keys != NULL && values != NULL));
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    assert(ordered_map_is_empty(map));
+    for(size_t i = 0; i < count; ++i){
+      ordered_map_insert(map, keys[i], values[i]);
+    }
+    return;
+  }
+
+  struct entry_iterator entries = {keys, values, {NULL, NULL}};
+  if(map->engine == ORDERED_MAP_B_TREE){
+    b_tree_build_sorted_from(&map->b_tree, count, &next_b_tree_entry, &entries);
+  }else{
+    rb_tree_build_sorted_from(&map->tree, count, &next_tree_entry, &entries);
+  }
 }
 
 bool ordered_map_delete(struct ordered_map * map, void * key){
   assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
 
   struct ordered_map_entry seek = {key, NULL};
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return skip_list_delete(&map->list, &seek);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return b_tree_delete(&map->b_tree, &seek);
+  }
   return rb_tree_find_and_delete(&map->tree, &seek);
 }
 
@@ -83,6 +402,16 @@ struct ordered_map_entry * ordered_map_find(const struct ordered_map * map, void
   assert(map != NULL);
 
   struct ordered_map_entry seek = {key, NULL};
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return (struct ordered_map_entry *)skip_list_find(get_list(map), &seek);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return (struct ordered_map_entry *)b_tree_find(&map->b_tree, &seek);
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    size_t position = eytzinger_array_find(&map->frozen, &seek);
+    return position == 0 ? NULL : (struct ordered_map_entry *)eytzinger_array_get(&map->frozen, position);
+  }
   struct rb_node * found = rb_tree_find(&map->tree, &seek);
   if(found == NULL){
     return NULL;
@@ -94,6 +423,18 @@ struct ordered_map_entry * ordered_map_find(const struct ordered_map * map, void
 void * ordered_map_get(const struct ordered_map * map, void * key){
   assert(map != NULL);
 
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    struct skip_list * list = get_list(map);
+    void * value = NULL;
+    skip_list_pin(list);
+    struct ordered_map_entry * found = ordered_map_find(map, key);
+    if(found != NULL){
+      value = __atomic_load_n(&found->value, __ATOMIC_ACQUIRE);
+    }
+    skip_list_unpin(list);
+    return value;
+  }
+
   struct ordered_map_entry * found = ordered_map_find(map, key);
   if(found == NULL){
     return NULL;
@@ -102,13 +443,348 @@ void * ordered_map_get(const struct ordered_map * map, void * key){
   }
 }
 
+void ordered_map_pin(const struct ordered_map * map){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    skip_list_pin(get_list(map));
+  }
+}
+
+void ordered_map_unpin(const struct ordered_map * map){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    skip_list_unpin(get_list(map));
+  }
+}
+
+/**
+ * The number of keys of a batched get looked up in the tree at once
+ */
+#define GET_BATCH_SIZE 64
+
+void ordered_map_get_batch(const struct ordered_map * map, void ** keys, size_t count, void ** values){
+  assert(map != NULL);
+  assert(count == 0 || (keys != NULL && values != NULL));
+
+  if(map->engine != ORDERED_MAP_RB_TREE){
+    for(size_t i = 0; i < count; ++i){
+      values[i] = ordered_map_get(map, keys[i]);
+    }
+    return;
+  }
+
+  struct ordered_map_entry seeks[GET_BATCH_SIZE];
+  void * seek_pointers[GET_BATCH_SIZE];
+  struct rb_node * found[GET_BATCH_SIZE];
+  for(size_t first = 0; first < count; first += GET_BATCH_SIZE){
+    size_t size = count - first < GET_BATCH_SIZE ? count - first : GET_BATCH_SIZE;
+    for(size_t i = 0; i < size; ++i){
+      seeks[i].key = keys[first + i];
+      seeks[i].value = NULL;
+      seek_pointers[i] = &seeks[i];
+    }
+    rb_tree_find_batch(&map->tree, seek_pointers, size, found);
+    for(size_t i = 0; i < size; ++i){
+      values[first + i] = found[i] == NULL ? NULL : ((struct ordered_map_entry *)rb_tree_get_value(&map->tree, found[i]))->value;
+    }
+  }
+}
+
 bool ordered_map_is_empty(const struct ordered_map * map){
   assert(map != NULL);
-  
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return skip_list_size(&map->list) == 0;
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return b_tree_size(&map->b_tree) == 0;
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    return eytzinger_array_size(&map->frozen) == 0;
+  }
   return rb_tree_is_empty(&map->tree);
 }
 
+size_t ordered_map_size(const struct ordered_map * map){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return skip_list_size(&map->list);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return b_tree_size(&map->b_tree);
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    return eytzinger_array_size(&map->frozen);
+  }
+  return rb_tree_size(&map->tree);
+}
+
+struct ordered_map_entry * ordered_map_select(const struct ordered_map * map, size_t index){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    struct skip_list * list = get_list(map);
+    skip_list_pin(list);
+    void * entry = skip_list_get_begin(list);
+    for(size_t i = 0; entry != NULL && i < index; ++i){
+      entry = skip_list_get_next(list, entry);
+    }
+    skip_list_unpin(list);
+    return (struct ordered_map_entry *)entry;
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    struct b_tree_cursor cursor;
+    b_tree_select(&map->b_tree, index, &cursor);
+    return (struct ordered_map_entry *)b_tree_cursor_get(&map->b_tree, &cursor);
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    size_t position = eytzinger_array_select(&map->frozen, index);
+    return position == 0 ? NULL : (struct ordered_map_entry *)eytzinger_array_get(&map->frozen, position);
+  }
+
+  struct rb_node * found = rb_tree_select(&map->tree, index);
+  if(found == NULL){
+    return NULL;
+  }else{
+    return (struct ordered_map_entry *)rb_tree_get_value(&map->tree, found);
+  }
+}
+
+size_t ordered_map_rank(const struct ordered_map * map, void * key){
+  assert(map != NULL);
+
+  struct ordered_map_entry seek = {key, NULL};
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return count_list_range(map, NULL, false, key);
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    return b_tree_rank(&map->b_tree, &seek);
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    return eytzinger_array_rank(&map->frozen, &seek);
+  }
+  return rb_tree_rank(&map->tree, &seek);
+}
+
+void ordered_map_range_init(struct ordered_map_range * range, const struct ordered_map * map, void * low, void * high){
+  assert(range != NULL);
+  assert(map != NULL);
+
+  struct ordered_map_entry seek = {low, NULL};
+  range->map = map;
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    range->next = (struct ordered_map_entry *)skip_list_lower_bound(get_list(map), &seek);
+  }else if(map->engine == ORDERED_MAP_B_TREE){
+    b_tree_lower_bound(&map->b_tree, &seek, &range->cursor);
+  }else if(map->engine == ORDERED_MAP_FROZEN){
+    range->position = eytzinger_array_lower_bound(&map->frozen, &seek);
+  }else{
+    range->node = rb_tree_lower_bound(&map->tree, &seek);
+  }
+  range->high = high;
+}
+
+struct ordered_map_entry * ordered_map_range_next(struct ordered_map_range * range){
+  assert(range != NULL);
+
+  const struct ordered_map * map = range->map;
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    struct ordered_map_entry * entry = range->next;
+    if(entry == NULL || (*map->cmp)(map, entry->key, range->high) >= 0){
+      range->next = NULL;
+      return NULL;
+    }
+    range->next = (struct ordered_map_entry *)skip_list_get_next(get_list(map), entry);
+    return entry;
+  }
+  if(map->engine == ORDERED_MAP_B_TREE){
+    struct ordered_map_entry * entry = (struct ordered_map_entry *)b_tree_cursor_get(&map->b_tree, &range->cursor);
+    if(entry == NULL || (*map->cmp)(map, entry->key, range->high) >= 0){
+      range->cursor.leaf = NULL;
+      return NULL;
+    }
+    b_tree_cursor_next(&map->b_tree, &range->cursor);
+    return entry;
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    if(range->position == 0){
+      return NULL;
+    }
+    struct ordered_map_entry * entry = (struct ordered_map_entry *)eytzinger_array_get(&map->frozen, range->position);
+    if((*map->cmp)(map, entry->key, range->high) >= 0){
+      range->position = 0;
+      return NULL;
+    }
+    range->position = eytzinger_array_get_next(&map->frozen, range->position);
+    return entry;
+  }
+
+  if(range->node == NULL){
+    return NULL;
+  }
+  struct ordered_map_entry * entry = (struct ordered_map_entry *)rb_tree_get_value(&map->tree, range->node);
+  if((*map->cmp)(map, entry->key, range->high) >= 0){
+    range->node = NULL;
+    return NULL;
+  }
+  range->node = rb_tree_get_next(&map->tree, range->node);
+  return entry;
+}
+
+size_t ordered_map_count_range(const struct ordered_map * map, void * low, void * high){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    return count_list_range(map, low, true, high);
+  }
+
+  struct ordered_map_entry low_seek = {low, NULL};
+  struct ordered_map_entry high_seek = {high, NULL};
+  if(map->engine == ORDERED_MAP_B_TREE){
+    size_t below_high = b_tree_rank(&map->b_tree, &high_seek);
+    size_t below_low = b_tree_rank(&map->b_tree, &low_seek);
+    return below_high > below_low ? below_high - below_low : 0;
+  }
+  if(map->engine == ORDERED_MAP_FROZEN){
+    size_t below_high = eytzinger_array_rank(&map->frozen, &high_seek);
+    size_t below_low = eytzinger_array_rank(&map->frozen, &low_seek);
+    return below_high > below_low ? below_high - below_low : 0;
+  }
+  return rb_tree_count_range(&map->tree, &low_seek, &high_seek);
+}
+
+void ordered_map_get_stats(const struct ordered_map * map, struct rb_tree_stats * stats){
+  assert(map != NULL);
+  assert(stats != NULL);
+
+  if(map->engine == ORDERED_MAP_RB_TREE){
+    rb_tree_get_stats(&map->tree, stats);
+  }else{
+    memset(stats, 0, sizeof(struct rb_tree_stats));
+  }
+}
+
+void ordered_map_reset_stats(struct ordered_map * map){
+  assert(map != NULL);
+
+  if(map->engine == ORDERED_MAP_RB_TREE){
+    rb_tree_reset_stats(&map->tree);
+  }
+}
+
+/*
+ * Freezing
+ */
+
+/**
+ * The entries of a map being frozen, in the order of the keys
+ */
+struct freeze_iterator{
+  struct ordered_map * map;
+  union{
+    struct rb_node * node;
+    void * next;
+    struct b_tree_cursor cursor;
+  };
+};
+
+static void * next_frozen_entry(struct eytzinger_array * array, void * iterator){
+  struct freeze_iterator * entries = (struct freeze_iterator *)iterator;
+  struct ordered_map * map = entries->map;
+  void * entry;
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    entry = entries->next;
+    entries->next = skip_list_get_next(&map->list, entry);
+  }else if(map->engine == ORDERED_MAP_B_TREE){
+    entry = b_tree_cursor_get(&map->b_tree, &entries->cursor);
+    b_tree_cursor_next(&map->b_tree, &entries->cursor);
+  }else{
+    entry = rb_tree_get_value(&map->tree, entries->node);
+    entries->node = rb_tree_get_next(&map->tree, entries->node);
+  }
+  return entry;
+}
+
+void ordered_map_freeze(struct ordered_map * map){
+  assert(map != NULL);
+  assert(map->engine != ORDERED_MAP_FROZEN);
+
+  struct freeze_iterator entries;
+  entries.map = map;
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    // entries deleted or values replaced earlier are still owned by the list
+    skip_list_reclaim_all(&map->list);
+    skip_list_pin(&map->list);
+    entries.next = skip_list_get_begin(&map->list);
+  }else if(map->engine == ORDERED_MAP_B_TREE){
+    b_tree_get_begin(&map->b_tree, &entries.cursor);
+  }else{
+    entries.node = rb_tree_get_begin(&map->tree);
+  }
+
+  struct eytzinger_array frozen;
+  eytzinger_array_init(&frozen, &cmp_frozen_entry, get_free_entry(map) == NULL ? NULL : &free_frozen_entry, map, sizeof(struct ordered_map_entry));
+  eytzinger_array_build_sorted_from(&frozen, ordered_map_size(map), &next_frozen_entry, &entries);
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    skip_list_unpin(&map->list);
+  }
+
+  // the keys and values now belong to the array, so the old structure is freed without them
+  ordered_map_free_f free_key = map->free_key;
+  ordered_map_free_f free_value = map->free_value;
+  map->free_key = default_free_key;
+  map->free_value = default_free_value;
+  ordered_map_free(map);
+  map->free_key = free_key;
+  map->free_value = free_value;
+
+  map->engine = ORDERED_MAP_FROZEN;
+  map->frozen = frozen;
+}
+
 void ordered_map_free(struct ordered_map * map){
   assert(map != NULL);
-  rb_tree_free(&map->tree);
+
+  if(map->engine == ORDERED_MAP_SKIP_LIST){
+    skip_list_free(&map->list);
+  }else if(map->engine == ORDERED_MAP_B_TREE){
+    b_tree_free(&map->b_tree);
+  }else if(map->engine == ORDERED_MAP_FROZEN){
+    eytzinger_array_free(&map->frozen);
+  }else{
+    rb_tree_free(&map->tree);
+  }
 };
+
+bool ordered_map_free_incremental(struct ordered_map * map, size_t budget){
+  assert(map != NULL);
+
+  if(map->engine != ORDERED_MAP_RB_TREE){
+    ordered_map_free(map);
+    return true;
+  }
+  return rb_tree_free_incremental(&map->tree, budget);
+}
+
+void ordered_map_free_background(struct ordered_map * map, struct rb_tree_reclaimer * reclaimer){
+  assert(map != NULL);
+  assert(reclaimer != NULL);
+
+  if(map->engine != ORDERED_MAP_RB_TREE){
+    ordered_map_free(map);
+    return;
+  }
+  // the free functions of the entries reach the map through the state of the tree, so the copy must outlive it
+  struct ordered_map * detached = malloc_checked(sizeof(struct ordered_map));
+  *detached = *map;
+  detached->tree.state = detached;
+  // the nodes and the pool now belong to the detached copy
+  map->tree.root = map->tree.nil;
+  map->tree.finger = map->tree.nil;
+  map->tree.pool = NULL;
+  map->tree.owns_pool = false;
+  rb_tree_reclaimer_submit_block(reclaimer, &detached->tree, detached);
+}
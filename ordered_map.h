@@ -19,7 +19,10 @@
 #ifndef ORDERED_MAP_H
 #define ORDERED_MAP_H
 
+#include "b_tree.h"
+#include "eytzinger_array.h"
 #include "rb_tree.h"
+#include "skip_list.h"
 
 struct ordered_map;
 
@@ -27,6 +30,11 @@ typedef int (*ordered_map_cmp_f)(const struct ordered_map *, void *, void *);
 
 typedef void (*ordered_map_free_f)(struct ordered_map *, void *);
 
+/**
+ * An entry in an ordered map
+ * Entries are stored inside the tree nodes, a pointer to an entry remains valid until its key is deleted
+ * unless the map is built on ORDERED_MAP_B_TREE, and until the map is frozen
+ */
 struct ordered_map_entry{
   void * key;
   void * value;
@@ -34,11 +42,103 @@ struct ordered_map_entry{
 
 typedef void (*ordered_map_apply_f)(struct ordered_map *, struct ordered_map_entry *);
 
+/**
+ * A function pointer type for updating entries in place
+ * Signature: void fn(struct ordered_map *, struct ordered_map_entry * entry, void * data)
+ * Called with the entry of a key, whose value is NULL if the entry was just inserted
+ */
+typedef void (*ordered_map_update_f)(struct ordered_map *, struct ordered_map_entry *, void *);
+
+/**
+ * The data structures an ordered map can be built on
+ */
+enum ordered_map_engine{
+
+  /**
+   * A red black tree, for use by a single thread at a time
+   */
+  ORDERED_MAP_RB_TREE,
+
+  /**
+   * A concurrent skip list, safe to use from multiple threads at once
+   * Finds and gets never block, inserts and deletes only lock the nodes next to the key they change.
+   * An entry or value found by one thread may be freed as soon as another thread deletes or replaces it,
+   * unless the finding thread holds ordered_map_pin, and ranges should not be used while other threads delete keys.
+   * Selecting, ranking and counting ranges take linear time.
+   * Keys replaced by an insert are kept and the inserted key is freed instead.
+   * The comparison and free functions must be thread safe.
+   */
+  ORDERED_MAP_SKIP_LIST,
+
+  /**
+   * A B+ tree with nodes of a few cache lines, for use by a single thread at a time
+   * Entries are packed into arrays inside the nodes, so a lookup misses the cache a few times instead of once per level of a binary tree,
+   * and ranges scan the linked leaves.
+   * Entries move when keys are inserted or deleted, so a pointer to an entry is only valid until the next insert or delete.
+   * Selecting, ranking and counting ranges take time linear in the number of leaves they pass.
+   */
+  ORDERED_MAP_B_TREE,
+
+  /**
+   * A read only array of the entries in Eytzinger order, which maps built on any other engine are converted to by ordered_map_freeze
+   * Lookups descend without branching and prefetch the entries a few levels ahead, and the map holds nothing but its entries.
+   * Frozen maps cannot be initialized directly nor modified, and may be read by multiple threads at once.
+   * Selecting, ranking and counting ranges take O(log² n) time.
+   */
+  ORDERED_MAP_FROZEN
+};
+
+/**
+ * A cursor over the entries of an ordered map with keys in a range [low, high)
+ * The entries are produced lazily in order, the map should not be modified while the cursor is in use
+ */
+struct ordered_map_range{
+
+  /**
+   * The map
+   */
+  const struct ordered_map * map;
+
+  union{
+
+    /**
+     * The node of the next entry or NULL if the range is exhausted, for the tree engine
+     */
+    struct rb_node * node;
+
+    /**
+     * The next entry or NULL if the range is exhausted, for the skip list engine
+     */
+    struct ordered_map_entry * next;
+
+    /**
+     * The position of the next entry, for the B+ tree engine
+     */
+    struct b_tree_cursor cursor;
+
+    /**
+     * The position of the next entry or 0 if the range is exhausted, for frozen maps
+     */
+    size_t position;
+  };
+
+  /**
+   * The exclusive upper bound
+   */
+  void * high;
+};
+
 /**
  * An ordered map
  */
 struct ordered_map{
-  struct rb_tree tree;
+  enum ordered_map_engine engine;
+  union{
+    struct rb_tree tree;
+    struct skip_list list;
+    struct b_tree b_tree;
+    struct eytzinger_array frozen;
+  };
   ordered_map_cmp_f cmp;
   ordered_map_free_f free_key;
   ordered_map_free_f free_value;
@@ -47,16 +147,202 @@ struct ordered_map{
 
 void ordered_map_init(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state);
 
+/**
+ * Initializes an ordered map built on a specific data structure
+ * ordered_map_init uses ORDERED_MAP_RB_TREE
+ * @param engine the data structure
+ */
+void ordered_map_init_engine(struct ordered_map * map, enum ordered_map_engine engine, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state);
+
+/**
+ * Initializes an ordered map that allocates its nodes and entries from a memory pool
+ * @param pool a pool that may be shared with other maps and trees or NULL to create a pool private to this map
+ */
+void ordered_map_init_pooled(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state, struct memory_pool * pool);
+
+/**
+ * Initializes an ordered map built on ORDERED_MAP_RB_TREE that allocates its nodes and entries from an allocator
+ * @param allocator the allocator, which must outlive the map
+ */
+void ordered_map_init_allocator(struct ordered_map * map, ordered_map_cmp_f cmp, ordered_map_free_f free_key, ordered_map_free_f free_value, void * state, struct allocator * allocator);
+
 bool ordered_map_insert(struct ordered_map * map, void * key, void * value);
 
+/**
+ * Inserts an entry in the map, using an entry next to the new key as a hint
+ * If the key belongs directly before or after the hint, the insert takes at most two comparisons
+ * @param map the map
+ * @param hint the entry the key belongs next to or NULL if the key belongs after the last entry
+ * @param key the key
+ * @param value the value
+ * @return the entry holding the key
+ */
+struct ordered_map_entry * ordered_map_insert_hint(struct ordered_map * map, struct ordered_map_entry * hint, void * key, void * value);
+
+/**
+ * Returns the entry of a key, inserting an entry if the key is absent, with a single descent
+ * If the key is present, the map keeps its entry and neither the key nor the value passed is stored or freed.
+ * @param map the map
+ * @param key the key
+ * @param value the value of the entry inserted if the key is absent
+ * @param inserted set to true if the entry was inserted, may be NULL
+ * @return the entry holding the key, see ordered_map_pin for how long it stays valid on ORDERED_MAP_SKIP_LIST
+ */
+struct ordered_map_entry * ordered_map_get_or_insert(struct ordered_map * map, void * key, void * value, bool * inserted);
+
+/**
+ * Inserts an entry if the key is absent, with a single descent
+ * If the key is present, the map is unchanged and neither the key nor the value passed is freed.
+ * @param map the map
+ * @param key the key
+ * @param value the value
+ * @return true if the entry was inserted
+ */
+bool ordered_map_try_insert(struct ordered_map * map, void * key, void * value);
+
+/**
+ * Updates the entry of a key in place, inserting an entry with a NULL value for update to fill in if the key is absent,
+ * with a single descent
+ * The update may replace the value of an existing entry, the old value is not freed by the map except on ORDERED_MAP_SKIP_LIST.
+ * If the key is present, the key passed is neither stored nor freed.
+ * On ORDERED_MAP_SKIP_LIST the update runs on a copy of the entry, whose value is then published atomically,
+ * so concurrent upserts of a key never lose an update. The update should make a new value rather than change
+ * or free the old one, which other threads may still be reading. It may run more than once if other threads
+ * change the value in between: the map frees the values made by runs that were not stored, and frees a replaced
+ * value once no thread can be reading it.
+ * @param map the map
+ * @param key the key
+ * @param update the function updating the entry
+ * @param data the argument of the update
+ * @return true if the entry was inserted
+ */
+bool ordered_map_upsert(struct ordered_map * map, void * key, ordered_map_update_f update, void * data);
+
+/**
+ * Fills an empty map from keys in strictly ascending order in linear time
+ * @param map the map
+ * @param keys an array of count keys in ascending order
+ * @param values an array of count values, the value for keys[i] at values[i]
+ * @param count the number of entries
+ */
+void ordered_map_build_sorted(struct ordered_map * map, void ** keys, void ** values, size_t count);
+
 bool ordered_map_delete(struct ordered_map * map, void * key);
 
+/**
+ * Returns the entry of a key or NULL, see ordered_map_pin for how long it stays valid on ORDERED_MAP_SKIP_LIST
+ */
 struct ordered_map_entry * ordered_map_find(const struct ordered_map * map, void * key);
 
+/**
+ * Returns the value of a key or NULL, see ordered_map_pin for how long it stays valid on ORDERED_MAP_SKIP_LIST
+ */
 void * ordered_map_get(const struct ordered_map * map, void * key);
 
+/**
+ * Enters a read side critical section on a map built on ORDERED_MAP_SKIP_LIST, does nothing on the other engines
+ * Entries and values returned to the calling thread stay allocated until it leaves the critical section,
+ * even if other threads delete or replace them. Without it, they are only safe to use while no other thread
+ * deletes or replaces their key. Critical sections may nest.
+ * @param map the map
+ */
+void ordered_map_pin(const struct ordered_map * map);
+
+/**
+ * Leaves a read side critical section entered with ordered_map_pin
+ * @param map the map
+ */
+void ordered_map_unpin(const struct ordered_map * map);
+
+/**
+ * Gets the values of many keys at once
+ * On ORDERED_MAP_RB_TREE the lookups advance in lockstep and overlap their cache misses, the other engines get the keys one by one
+ * @param map the map
+ * @param keys an array of count keys
+ * @param count the number of keys
+ * @param values an array of count values, set to the value of keys[i] or NULL at values[i]
+ */
+void ordered_map_get_batch(const struct ordered_map * map, void ** keys, size_t count, void ** values);
+
 bool ordered_map_is_empty(const struct ordered_map * map);
 
+/**
+ * Returns the number of entries in the map in constant time
+ */
+size_t ordered_map_size(const struct ordered_map * map);
+
+/**
+ * Returns the entry at a zero based position in the order of the keys in logarithmic time
+ * @return the entry or NULL if index is not smaller than the size of the map
+ */
+struct ordered_map_entry * ordered_map_select(const struct ordered_map * map, size_t index);
+
+/**
+ * Returns the number of keys in the map smaller than a key in logarithmic time
+ */
+size_t ordered_map_rank(const struct ordered_map * map, void * key);
+
+/**
+ * Initializes a cursor over the entries with keys in the range [low, high) in logarithmic time
+ * @param range the cursor
+ * @param map the map
+ * @param low the inclusive lower bound
+ * @param high the exclusive upper bound
+ */
+void ordered_map_range_init(struct ordered_map_range * range, const struct ordered_map * map, void * low, void * high);
+
+/**
+ * Returns the next entry of the range
+ * @param range the cursor
+ * @return the entry or NULL if the range is exhausted
+ */
+struct ordered_map_entry * ordered_map_range_next(struct ordered_map_range * range);
+
+/**
+ * Returns the number of keys in the range [low, high) in logarithmic time
+ */
+size_t ordered_map_count_range(const struct ordered_map * map, void * low, void * high);
+
+/**
+ * Copies the counters of the red black tree of a map
+ * @param stats set to the counters, all zero unless RB_TREE_STATS is defined or if the map is not built on ORDERED_MAP_RB_TREE
+ */
+void ordered_map_get_stats(const struct ordered_map * map, struct rb_tree_stats * stats);
+
+/**
+ * Sets the counters of the red black tree of a map to zero
+ */
+void ordered_map_reset_stats(struct ordered_map * map);
+
+/**
+ * Converts a map into a read only array of its entries in Eytzinger order, in linear time
+ * The entries are moved, so pointers to the entries of the map become invalid, and the keys and values are not freed.
+ * The map must not be used by other threads during the conversion.
+ * @param map the map, which must not be frozen already
+ */
+void ordered_map_freeze(struct ordered_map * map);
+
 void ordered_map_free(struct ordered_map * map);
 
+/**
+ * Frees at most budget entries of a map, so a large map can be freed in steps interleaved with other work
+ * Maps not built on ORDERED_MAP_RB_TREE are freed at once.
+ * Once called, the map may only be passed to ordered_map_free_incremental until it returns true
+ * @param map the map
+ * @param budget the largest number of entries to free, at least 1
+ * @return true once the map is freed
+ */
+bool ordered_map_free_incremental(struct ordered_map * map, size_t budget);
+
+/**
+ * Frees a map on the thread of a reclaimer
+ * As after ordered_map_free, the map struct may be initialized again or released as soon as this returns,
+ * but should not be freed again.
+ * The free functions are called on the reclamation thread with a copy of the map carrying the same state.
+ * Maps not built on ORDERED_MAP_RB_TREE are freed at once on the calling thread, the map should not allocate from a shared pool.
+ * @param map the map
+ * @param reclaimer the reclaimer
+ */
+void ordered_map_free_background(struct ordered_map * map, struct rb_tree_reclaimer * reclaimer);
+
 #endif
@@ -0,0 +1,572 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "memory.h"
+#include "persistent_tree.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/**
+ * The largest depth of a path from the root, enough for any tree that fits in memory
+ */
+#define MAX_DEPTH 128
+
+/**
+ * A value shared by the copies of a node, only used if the tree has a free function
+ */
+struct persistent_value{
+
+  /**
+   * The number of nodes holding the value
+   */
+  atomic_size_t references;
+
+  /**
+   * The value
+   */
+  void * value;
+};
+
+struct persistent_node{
+
+  /**
+   * The number of parents and versions referring to the node
+   * A node referred to once is only reachable from a single version and may be changed in place
+   */
+  atomic_size_t references;
+
+  /**
+   * The left child or NULL
+   */
+  struct persistent_node * left;
+
+  /**
+   * The right child or NULL
+   */
+  struct persistent_node * right;
+
+  /**
+   * Whether the node is red
+   */
+  bool red;
+
+  union{
+
+    /**
+     * The value, if the tree has no free function
+     */
+    void * value;
+
+    /**
+     * The shared value, if the tree has a free function
+     */
+    struct persistent_value * shared;
+  };
+};
+
+/**
+ * The default free function (does nothing)
+ */
+static void default_free_value(struct persistent_tree * tree, void * value){}
+
+/*
+ * Helper methods
+ */
+
+/**
+ * Checks whether values are shared between copies of nodes and freed when the last copy goes
+ * Without a free function the value pointer is simply copied along with the node
+ */
+static inline bool has_shared_values(const struct persistent_tree * tree){
+  return tree->free_value != default_free_value;
+}
+
+static inline void * get_node_value(const struct persistent_tree * tree, struct persistent_node * node){
+  return has_shared_values(tree) ? node->shared->value : node->value;
+}
+
+static inline bool is_red(struct persistent_node * node){
+  return node != NULL && node->red;
+}
+
+/**
+ * Gives a node a new value, releasing its old value
+ */
+static void set_node_value(struct persistent_tree * tree, struct persistent_node * node, void * value){
+  if(has_shared_values(tree)){
+    struct persistent_value * shared = malloc_checked(sizeof(struct persistent_value));
+    atomic_init(&shared->references, 1);
+    shared->value = value;
+    node->shared = shared;
+  }else{
+    node->value = value;
+  }
+}
+
+/**
+ * Releases the value of a node, freeing it if no other node holds it
+ */
+static void release_value(struct persistent_tree * tree, struct persistent_node * node){
+  if(has_shared_values(tree) && atomic_fetch_sub_explicit(&node->shared->references, 1, memory_order_acq_rel) == 1){
+    (*tree->free_value)(tree, node->shared->value);
+    free(node->shared);
+  }
+}
+
+static struct persistent_node * create_node(struct persistent_tree * tree, void * value){
+  struct persistent_node * node = malloc_checked(sizeof(struct persistent_node));
+  atomic_init(&node->references, 1);
+  node->left = NULL;
+  node->right = NULL;
+  node->red = true;
+  set_node_value(tree, node, value);
+  return node;
+}
+
+static inline void retain_node(struct persistent_node * node){
+  if(node != NULL){
+    atomic_fetch_add_explicit(&node->references, 1, memory_order_relaxed);
+  }
+}
+
+/**
+ * Drops a reference to a node, freeing the node, its value and its subtrees if nothing else refers to them
+ */
+static void release_node(struct persistent_tree * tree, struct persistent_node * node){
+  while(node != NULL && atomic_fetch_sub_explicit(&node->references, 1, memory_order_acq_rel) == 1){
+    release_node(tree, node->left);
+    struct persistent_node * right = node->right;
+    release_value(tree, node);
+    free(node);
+    node = right;
+  }
+}
+
+/**
+ * Returns a node only the caller refers to, copying the node if it is shared
+ * The reference to the original is handed over to the copy, whose children and value are shared with the original
+ */
+static struct persistent_node * make_unique(struct persistent_tree * tree, struct persistent_node * node){
+  if(atomic_load_explicit(&node->references, memory_order_acquire) == 1){
+    return node;
+  }
+
+  struct persistent_node * copy = malloc_checked(sizeof(struct persistent_node));
+  atomic_init(&copy->references, 1);
+  copy->left = node->left;
+  copy->right = node->right;
+  copy->red = node->red;
+  retain_node(copy->left);
+  retain_node(copy->right);
+  if(has_shared_values(tree)){
+    copy->shared = node->shared;
+    atomic_fetch_add_explicit(&copy->shared->references, 1, memory_order_relaxed);
+  }else{
+    copy->value = node->value;
+  }
+  release_node(tree, node);
+  return copy;
+}
+
+/**
+ * Makes a child of a node that is only referred to by the caller unique as well and links it in place of the original
+ * @param left whether to make the left or the right child unique
+ * @return the unique child or NULL if there is no such child
+ */
+static struct persistent_node * make_child_unique(struct persistent_tree * tree, struct persistent_node * node, bool left){
+  struct persistent_node * child = left ? node->left : node->right;
+  if(child == NULL){
+    return NULL;
+  }
+  child = make_unique(tree, child);
+  if(left){
+    node->left = child;
+  }else{
+    node->right = child;
+  }
+  return child;
+}
+
+/**
+ * Replaces the link from parent to a child by a link to another node
+ * @param parent the parent or NULL if the child is the root
+ */
+static void replace_child(struct persistent_tree * tree, struct persistent_node * parent, struct persistent_node * child, struct persistent_node * repl){
+  if(parent == NULL){
+    tree->root = repl;
+  }else if(parent->left == child){
+    parent->left = repl;
+  }else{
+    parent->right = repl;
+  }
+}
+
+/**
+ * Rotates a node, moving its right child up for a left rotation and its left child for a right rotation
+ * The node and the child moving up should be unique
+ * @param parent the parent of the node or NULL if the node is the root
+ */
+static void rotate(struct persistent_tree * tree, struct persistent_node * parent, struct persistent_node * node, bool left){
+  struct persistent_node * pivot;
+  if(left){
+    pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+  }else{
+    pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+  }
+  replace_child(tree, parent, node, pivot);
+}
+
+/*
+ * Initialization and snapshots
+ */
+
+void persistent_tree_init(struct persistent_tree * tree, persistent_tree_cmp_f cmp_value, persistent_tree_apply_f free_value, void * state){
+  assert(tree != NULL);
+  assert(cmp_value != NULL);
+
+  tree->root = NULL;
+  tree->size = 0;
+  tree->cmp_value = cmp_value;
+  if(free_value == NULL){
+    tree->free_value = default_free_value;
+  }else{
+    tree->free_value = free_value;
+  }
+  tree->state = state;
+}
+
+void persistent_tree_snapshot(const struct persistent_tree * tree, struct persistent_tree * snapshot){
+  assert(tree != NULL);
+  assert(snapshot != NULL);
+
+  *snapshot = *tree;
+  retain_node(snapshot->root);
+}
+
+/*
+ * Finding values
+ */
+
+void * persistent_tree_find(const struct persistent_tree * tree, void * value){
+  assert(tree != NULL);
+
+  struct persistent_node * node = tree->root;
+  while(node != NULL){
+    int cmp = (*tree->cmp_value)(tree, value, get_node_value(tree, node));
+    if(cmp == 0){
+      return get_node_value(tree, node);
+    }
+    node = cmp < 0 ? node->left : node->right;
+  }
+  return NULL;
+}
+
+size_t persistent_tree_size(const struct persistent_tree * tree){
+  assert(tree != NULL);
+  return tree->size;
+}
+
+bool persistent_tree_is_empty(const struct persistent_tree * tree){
+  assert(tree != NULL);
+  return tree->root == NULL;
+}
+
+void persistent_tree_apply(struct persistent_tree * tree, persistent_tree_apply_f apply){
+  assert(tree != NULL);
+  assert(apply != NULL);
+
+  struct persistent_node * stack[MAX_DEPTH];
+  size_t depth = 0;
+  struct persistent_node * node = tree->root;
+  while(node != NULL || depth > 0){
+    while(node != NULL){
+      stack[depth++] = node;
+      node = node->left;
+    }
+    node = stack[--depth];
+    (*apply)(tree, get_node_value(tree, node));
+    node = node->right;
+  }
+}
+
+/*
+ * Insertion
+ */
+
+/**
+ * Fixes the tree after an insert
+ * @param path the unique nodes from the root down to the new node
+ * @param depth the number of nodes on the path
+ */
+static void fix_after_insert(struct persistent_tree * tree, struct persistent_node ** path, size_t depth){
+  size_t index = depth - 1;
+  // the root is black, so a red parent has a grandparent
+  while(index >= 2 && is_red(path[index - 1])){
+    struct persistent_node * node = path[index];
+    struct persistent_node * parent = path[index - 1];
+    struct persistent_node * grandparent = path[index - 2];
+    bool parent_left = grandparent->left == parent;
+    struct persistent_node * uncle = parent_left ? grandparent->right : grandparent->left;
+
+    if(is_red(uncle)){
+      uncle = make_child_unique(tree, grandparent, !parent_left);
+      parent->red = false;
+      uncle->red = false;
+      grandparent->red = true;
+      index -= 2;
+    }else{
+      if(node == (parent_left ? parent->right : parent->left)){
+	rotate(tree, grandparent, parent, parent_left);
+	parent = node;
+      }
+      parent->red = false;
+      grandparent->red = true;
+      rotate(tree, index >= 3 ? path[index - 3] : NULL, grandparent, !parent_left);
+      break;
+    }
+  }
+  tree->root->red = false;
+}
+
+bool persistent_tree_insert(struct persistent_tree * tree, void * value){
+  assert(tree != NULL);
+
+  if(tree->root == NULL){
+    tree->root = create_node(tree, value);
+    tree->root->red = false;
+    tree->size = 1;
+    return false;
+  }
+
+  struct persistent_node * path[MAX_DEPTH];
+  size_t depth = 0;
+  tree->root = make_unique(tree, tree->root);
+  struct persistent_node * node = tree->root;
+  for(;;){
+    assert(depth + 1 < MAX_DEPTH);
+    path[depth++] = node;
+    int cmp = (*tree->cmp_value)(tree, value, get_node_value(tree, node));
+    if(cmp == 0){
+      release_value(tree, node);
+      set_node_value(tree, node, value);
+      return true;
+    }
+
+    bool left = cmp < 0;
+    if((left ? node->left : node->right) == NULL){
+      struct persistent_node * child = create_node(tree, value);
+      if(left){
+	node->left = child;
+      }else{
+	node->right = child;
+      }
+      path[depth++] = child;
+      break;
+    }
+    node = make_child_unique(tree, node, left);
+  }
+
+  ++tree->size;
+  fix_after_insert(tree, path, depth);
+  return false;
+}
+
+/*
+ * Deletion
+ */
+
+/**
+ * Fixes the tree after a black node was removed
+ * @param path the unique nodes from the root down to the parent of node, with room for one more
+ * @param depth the number of nodes on the path, 0 if node is the root
+ * @param node the node that took the place of the removed node or NULL
+ * @param left whether node is the left child of its parent
+ */
+static void fix_after_delete(struct persistent_tree * tree, struct persistent_node ** path, size_t depth, struct persistent_node * node, bool left){
+  while(depth > 0 && !is_red(node)){
+    struct persistent_node * parent = path[depth - 1];
+    struct persistent_node * grandparent = depth >= 2 ? path[depth - 2] : NULL;
+    struct persistent_node * sibling = make_child_unique(tree, parent, !left);
+
+    if(sibling->red){
+      sibling->red = false;
+      parent->red = true;
+      rotate(tree, grandparent, parent, left);
+      // the sibling moved in between the grandparent and the parent
+      assert(depth < MAX_DEPTH);
+      path[depth - 1] = sibling;
+      path[depth] = parent;
+      ++depth;
+      grandparent = sibling;
+      sibling = make_child_unique(tree, parent, !left);
+    }
+
+    struct persistent_node * near = left ? sibling->left : sibling->right;
+    struct persistent_node * far = left ? sibling->right : sibling->left;
+    if(!is_red(near) && !is_red(far)){
+      sibling->red = true;
+      node = parent;
+      --depth;
+      left = depth > 0 && path[depth - 1]->left == node;
+    }else{
+      if(!is_red(far)){
+	near = make_child_unique(tree, sibling, left);
+	near->red = false;
+	sibling->red = true;
+	rotate(tree, parent, sibling, !left);
+	sibling = near;
+      }
+      far = make_child_unique(tree, sibling, !left);
+      sibling->red = parent->red;
+      parent->red = false;
+      far->red = false;
+      rotate(tree, grandparent, parent, left);
+      return;
+    }
+  }
+
+  if(is_red(node)){
+    if(depth > 0){
+      node = make_child_unique(tree, path[depth - 1], left);
+    }else{
+      node = tree->root = make_unique(tree, node);
+    }
+    node->red = false;
+  }
+}
+
+bool persistent_tree_delete(struct persistent_tree * tree, void * value){
+  assert(tree != NULL);
+
+  // nothing is copied for values that are not in the tree
+  if(persistent_tree_find(tree, value) == NULL){
+    return false;
+  }
+
+  struct persistent_node * path[MAX_DEPTH];
+  size_t depth = 0;
+  tree->root = make_unique(tree, tree->root);
+  struct persistent_node * node = tree->root;
+  for(;;){
+    path[depth++] = node;
+    int cmp = (*tree->cmp_value)(tree, value, get_node_value(tree, node));
+    if(cmp == 0){
+      break;
+    }
+    node = make_child_unique(tree, node, cmp < 0);
+  }
+
+  struct persistent_node * target = node;
+  release_value(tree, target);
+  if(target->left != NULL && target->right != NULL){
+    // the successor moves its value to the target and is removed instead
+    node = make_child_unique(tree, target, false);
+    while(node->left != NULL){
+      path[depth++] = node;
+      node = make_child_unique(tree, node, true);
+    }
+    path[depth++] = node;
+    if(has_shared_values(tree)){
+      target->shared = node->shared;
+    }else{
+      target->value = node->value;
+    }
+  }
+
+  struct persistent_node * removed = path[--depth];
+  struct persistent_node * child = removed->left != NULL ? removed->left : removed->right;
+  struct persistent_node * parent = depth > 0 ? path[depth - 1] : NULL;
+  bool left = parent != NULL && parent->left == removed;
+  replace_child(tree, parent, removed, child);
+  bool removed_red = removed->red;
+  free(removed);
+  --tree->size;
+
+  if(!removed_red){
+    fix_after_delete(tree, path, depth, child, left);
+  }
+  return true;
+}
+
+/*
+ * Validation
+ */
+
+/**
+ * Validates the subtree rooted at node
+ * @param lower the node holding the largest smaller value or NULL
+ * @param upper the node holding the smallest larger value or NULL
+ * @return the black height of the subtree or -1 if it is invalid
+ */
+static int validate_node(const struct persistent_tree * tree, struct persistent_node * node, struct persistent_node * lower, struct persistent_node * upper){
+  if(node == NULL){
+    return 1;
+  }
+  if(atomic_load(&node->references) == 0){
+    return -1;
+  }
+  if(node->red && (is_red(node->left) || is_red(node->right))){
+    return -1;
+  }
+  void * value = get_node_value(tree, node);
+  if(lower != NULL && (*tree->cmp_value)(tree, get_node_value(tree, lower), value) >= 0){
+    return -1;
+  }
+  if(upper != NULL && (*tree->cmp_value)(tree, value, get_node_value(tree, upper)) >= 0){
+    return -1;
+  }
+  int left = validate_node(tree, node->left, lower, node);
+  int right = validate_node(tree, node->right, node, upper);
+  if(left == -1 || left != right){
+    return -1;
+  }
+  return left + (node->red ? 0 : 1);
+}
+
+/**
+ * Counts the nodes of a subtree
+ */
+static size_t count_nodes(struct persistent_node * node){
+  return node == NULL ? 0 : 1 + count_nodes(node->left) + count_nodes(node->right);
+}
+
+bool persistent_tree_validate(const struct persistent_tree * tree){
+  assert(tree != NULL);
+
+  return !is_red(tree->root)
+    && validate_node(tree, tree->root, NULL, NULL) != -1
+    && count_nodes(tree->root) == tree->size;
+}
+
+/*
+ * Freeing
+ */
+
+void persistent_tree_free(struct persistent_tree * tree){
+  assert(tree != NULL);
+
+  release_node(tree, tree->root);
+  tree->root = NULL;
+  tree->size = 0;
+}
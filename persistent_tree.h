@@ -0,0 +1,159 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PERSISTENT_TREE_H
+#define PERSISTENT_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A persistent red black tree
+ * Versions of the tree share their nodes. An update copies only the nodes on the path it changes
+ * that are shared with another version, and changes unshared nodes in place.
+ * Nodes and values are reference counted and freed when no version refers to them anymore.
+ * A version is used by one thread at a time, but different versions may be used and freed by different threads concurrently.
+ */
+
+/**
+ * A node in the persistent tree
+ */
+struct persistent_node;
+
+struct persistent_tree;
+
+/**
+ * A function pointer type for the comparison function used in the persistent tree
+ * Signature: int fn(const struct persistent_tree *, void * first, void * second)
+ */
+typedef int (*persistent_tree_cmp_f)(const struct persistent_tree *, void *, void *);
+
+/**
+ * A function pointer type for functions applied to values
+ * Signature: void fn(struct persistent_tree *, void * value)
+ */
+typedef void (*persistent_tree_apply_f)(struct persistent_tree *, void *);
+
+/**
+ * A version of a persistent tree
+ */
+struct persistent_tree{
+
+  /**
+   * The root of the tree or NULL
+   */
+  struct persistent_node * root;
+
+  /**
+   * The number of values in the tree
+   */
+  size_t size;
+
+  /**
+   * The comparison function
+   */
+  persistent_tree_cmp_f cmp_value;
+
+  /**
+   * The free function for values, called once no version holds the value anymore
+   */
+  persistent_tree_apply_f free_value;
+
+  /**
+   * Extra state for the tree
+   */
+  void * state;
+};
+
+/**
+ * Initializes an empty persistent tree
+ * @param tree the tree
+ * @param cmp_value the comparison function
+ * @param free_value the free function for values or NULL, may be called from any thread freeing a version
+ * @param state extra state for the tree
+ */
+void persistent_tree_init(struct persistent_tree * tree, persistent_tree_cmp_f cmp_value, persistent_tree_apply_f free_value, void * state);
+
+/**
+ * Creates an immutable snapshot of a tree in constant time
+ * The snapshot is a version of its own: later updates of the tree do not show in the snapshot and vice versa.
+ * It should be taken by the thread updating the tree, but may then be handed to and freed by another thread.
+ * @param tree the tree
+ * @param snapshot the version to initialize, freed with persistent_tree_free
+ */
+void persistent_tree_snapshot(const struct persistent_tree * tree, struct persistent_tree * snapshot);
+
+/**
+ * Inserts a value in the tree, copying the nodes on its path shared with other versions
+ * @param tree the tree
+ * @param value the value
+ * @return true if the value replaces an existing value, false otherwise
+ */
+bool persistent_tree_insert(struct persistent_tree * tree, void * value);
+
+/**
+ * Deletes the value equal to a value from the tree, copying the nodes on its path shared with other versions
+ * @param tree the tree
+ * @param value the value
+ * @return true if a value was deleted
+ */
+bool persistent_tree_delete(struct persistent_tree * tree, void * value);
+
+/**
+ * Finds the value equal to a value
+ * @param tree the tree
+ * @param value the value
+ * @return the value in the tree or NULL
+ */
+void * persistent_tree_find(const struct persistent_tree * tree, void * value);
+
+/**
+ * Returns the number of values in the tree
+ * @param tree the tree
+ * @return the number of values
+ */
+size_t persistent_tree_size(const struct persistent_tree * tree);
+
+/**
+ * Checks whether the tree is empty
+ * @param tree the tree
+ * @return true if the tree contains no values
+ */
+bool persistent_tree_is_empty(const struct persistent_tree * tree);
+
+/**
+ * Applies a function to all values in the tree in order
+ * @param tree the tree
+ * @param apply the function
+ */
+void persistent_tree_apply(struct persistent_tree * tree, persistent_tree_apply_f apply);
+
+/**
+ * Checks all red black tree invariants and the order of the values
+ * @param tree the tree
+ * @return true if the tree is valid
+ */
+bool persistent_tree_validate(const struct persistent_tree * tree);
+
+/**
+ * Releases a version of the tree, freeing the nodes and values no other version refers to
+ * @param tree the tree
+ */
+void persistent_tree_free(struct persistent_tree * tree);
+
+#endif
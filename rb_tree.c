@@ -18,10 +18,15 @@
 
 #include "memory.h"
 #include "rb_tree.h"
+#include "task_pool.h"
 
 #include <assert.h>
+#include <sched.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * A node in the red black node
@@ -43,6 +48,11 @@ struct rb_node{
    */
   struct rb_node * right;
 
+  /**
+   * The number of nodes in the subtree rooted at this node
+   */
+  size_t size;
+
   /**
    * Whether the node is red
    */
@@ -50,39 +60,203 @@ struct rb_node{
   
   /**
    * A pointer the value
+   * If the tree stores its values inline, the value itself starts here and the node is extended to hold it
    */
   void * value;
 };
 
+/**
+ * Returns a pointer to the value of the node
+ * @param tree the tree
+ * @param node the node
+ * @return the value pointer or a pointer to the inline value
+ */
+static inline void * get_node_value(const struct rb_tree * tree, struct rb_node * node){
+  return tree->value_size == 0 ? node->value : (void *)&node->value;
+}
+
+/**
+ * Stores a value in the node, copying it if the tree stores its values inline
+ * @param tree the tree
+ * @param node the node
+ * @param value the value pointer or a pointer to the value to copy
+ */
+static inline void set_node_value(const struct rb_tree * tree, struct rb_node * node, void * value){
+  if(tree->value_size == 0){
+    node->value = value;
+  }else{
+    memcpy(&node->value, value, tree->value_size);
+  }
+}
+
+/**
+ * The sentinel node shared by all trees
+ * It is black, has size 0 and is never written, so nodes can move between trees
+ */
+static struct rb_node nil_node = {.parent = NULL, .left = NULL, .right = NULL, .size = 0, .red = false, .value = NULL};
+
 /**
  * The default free function (does nothing)
  */
 static void default_free_value(struct rb_tree * tree, void * value){};
 
 /*
- * Assertion functions for testing purposes
+ * Statistics
+ */
+
+#ifdef RB_TREE_STATS
+
+/**
+ * Adds to a counter of a tree, which may be shared by several threads reading the tree
+ */
+#define ADD_STAT(tree, counter, count) __atomic_fetch_add(&((struct rb_tree *)(tree))->stats.counter, (count), __ATOMIC_RELAXED)
+
+/**
+ * Records a search that visited length nodes
+ */
+static void record_path(const struct rb_tree * tree, size_t length){
+  struct rb_tree_stats * stats = &((struct rb_tree *)tree)->stats;
+  __atomic_fetch_add(&stats->searches, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->total_path_length, length, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->path_lengths[length < RB_TREE_STATS_PATH_LENGTHS ? length : RB_TREE_STATS_PATH_LENGTHS - 1], 1, __ATOMIC_RELAXED);
+  size_t max = __atomic_load_n(&stats->max_path_length, __ATOMIC_RELAXED);
+  while(length > max && !__atomic_compare_exchange_n(&stats->max_path_length, &max, length, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+#define RECORD_PATH(tree, length) record_path((tree), (length))
+
+#else
+
+#define ADD_STAT(tree, counter, count) ((void)0)
+
+#define RECORD_PATH(tree, length) ((void)(length))
+
+#endif
+
+/**
+ * Compares two values with the comparison function of the tree, counting the call
+ */
+static inline int compare(const struct rb_tree * tree, void * first, void * second){
+  ADD_STAT(tree, comparisons, 1);
+  return (*tree->cmp_value)(tree, first, second);
+}
+
+/*
+ * Validation
+ */
+
+/**
+ * The mutation period used by sampled validation unless configured otherwise
  */
+#define DEFAULT_VALIDATION_PERIOD 1024
 
-static int assert_node(struct rb_tree * tree, struct rb_node * node){
+/**
+ * Validates the subtree rooted at node
+ * @param lower the node all values in the subtree should be greater than or NIL
+ * @param upper the node all values in the subtree should be less than or NIL
+ * @return the black height of the subtree or -1 if the subtree is invalid
+ */
+static int validate_node(const struct rb_tree * tree, struct rb_node * node, struct rb_node * lower, struct rb_node * upper){
   if(node == tree->nil){
-    return 1;
-  }else{
-    if(node->parent == tree->nil){
-      assert(!node->red);
-    }else if(node->red){
-      assert(!node->left->red);
-      assert(!node->right->red);
+    return 0;
+  }
+  if(node->red && (node->left->red || node->right->red)){
+    return -1;
+  }
+  if((node->left != tree->nil && node->left->parent != node) || (node->right != tree->nil && node->right->parent != node)){
+    return -1;
+  }
+  if(node->size != node->left->size + node->right->size + 1){
+    return -1;
+  }
+  if(lower != tree->nil && (*tree->cmp_value)(tree, get_node_value(tree, lower), get_node_value(tree, node)) >= 0){
+    return -1;
+  }
+  if(upper != tree->nil && (*tree->cmp_value)(tree, get_node_value(tree, node), get_node_value(tree, upper)) >= 0){
+    return -1;
+  }
+  int left = validate_node(tree, node->left, lower, node);
+  if(left < 0){
+    return -1;
+  }
+  int right = validate_node(tree, node->right, node, upper);
+  if(right != left){
+    return -1;
+  }
+  return left + (node->red ? 0 : 1);
+}
+
+/**
+ * Validates a single node against its direct neighbours: its links, its color and the order of its children
+ * @return true if the node is valid, false otherwise
+ */
+static bool validate_local(const struct rb_tree * tree, struct rb_node * node){
+  struct rb_node * left = node->left;
+  struct rb_node * right = node->right;
+  if(node->red && (left->red || right->red)){
+    return false;
+  }
+  if(node->size != left->size + right->size + 1){
+    return false;
+  }
+  if(left != tree->nil && (left->parent != node || (*tree->cmp_value)(tree, get_node_value(tree, left), get_node_value(tree, node)) >= 0)){
+    return false;
+  }
+  if(right != tree->nil && (right->parent != node || (*tree->cmp_value)(tree, get_node_value(tree, node), get_node_value(tree, right)) >= 0)){
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Validates the nodes a mutation may have touched: node, its ancestors and their children
+ * Rebalancing only rotates and recolors nodes on or next to this path
+ * @param node the lowest node touched by the mutation or NIL
+ * @return true if no violation was found, false otherwise
+ */
+static bool validate_path(const struct rb_tree * tree, struct rb_node * node){
+  if(tree->root->red){
+    return false;
+  }
+  while(node != tree->nil){
+    if(!validate_local(tree, node)
+       || (node->left != tree->nil && !validate_local(tree, node->left))
+       || (node->right != tree->nil && !validate_local(tree, node->right))){
+      return false;
     }
-    int left = assert_node(tree, node->left);
-    int right = assert_node(tree, node->right);
-    assert(left == right);
-    return left + (node->red ? 0 : 1);
+    node = node->parent;
   }
+  return true;
 }
 
-static void assert_tree(struct rb_tree * tree){
-  assert(!tree->root->red);
-  assert_node(tree, tree->root);
+/**
+ * Validates the tree after a mutation according to its validation level
+ * Aborts the program if a violation is found
+ * @param node the lowest node touched by the mutation or NIL
+ */
+static void validate_mutation(struct rb_tree * tree, struct rb_node * node){
+  bool valid;
+  switch(tree->validation){
+  case RB_VALIDATION_OFF:
+    return;
+  case RB_VALIDATION_LOCAL:
+    valid = validate_path(tree, node);
+    break;
+  case RB_VALIDATION_SAMPLED:
+    if(++tree->mutations < tree->validation_period){
+      return;
+    }
+    tree->mutations = 0;
+    valid = rb_tree_validate(tree);
+    break;
+  default:
+    valid = rb_tree_validate(tree);
+    break;
+  }
+  if(!valid){
+    fputs("red black tree invariants violated\n", stderr);
+    abort();
+  }
 }
 
 /*
@@ -127,11 +301,67 @@ static struct rb_node * get_max(const struct rb_tree * tree, struct rb_node * no
   }
 }
 
+/**
+ * Returns a pointer to the aggregate of the node
+ */
+static inline void * get_node_aggregate(const struct rb_tree * tree, struct rb_node * node){
+  return (char *)node + tree->aggregate_offset;
+}
+
+/**
+ * Recomputes the aggregate of a node from its value and the aggregates of its children
+ */
+static void update_aggregate(const struct rb_tree * tree, struct rb_node * node){
+  void * aggregate = get_node_aggregate(tree, node);
+  (*tree->lift)(tree, aggregate, get_node_value(tree, node));
+  if(node->left != tree->nil){
+    (*tree->combine)(tree, aggregate, get_node_aggregate(tree, node->left), aggregate);
+  }
+  if(node->right != tree->nil){
+    (*tree->combine)(tree, aggregate, aggregate, get_node_aggregate(tree, node->right));
+  }
+}
+
+/**
+ * Recomputes the size and the aggregate of a node from its children
+ */
+static inline void update_node(const struct rb_tree * tree, struct rb_node * node){
+  node->size = node->left->size + node->right->size + 1;
+  if(tree->combine != NULL){
+    update_aggregate(tree, node);
+  }
+}
+
+/**
+ * Adds nodes to the sizes of a node and its ancestors and recomputes their aggregates
+ * @param node the lowest node whose subtree grew
+ * @param count the number of nodes added
+ */
+static void grow_ancestors(const struct rb_tree * tree, struct rb_node * node, size_t count){
+  for(; node != tree->nil; node = node->parent){
+    node->size += count;
+    if(tree->combine != NULL){
+      update_aggregate(tree, node);
+    }
+  }
+}
+
+/**
+ * Gives the pivot of a rotation the size and aggregate of its old parent, whose subtree it takes over
+ */
+static inline void take_over_node(const struct rb_tree * tree, struct rb_node * pivot, struct rb_node * parent){
+  pivot->size = parent->size;
+  if(tree->combine != NULL){
+    memcpy(get_node_aggregate(tree, pivot), get_node_aggregate(tree, parent), tree->aggregate_size);
+  }
+}
+
 /**
  * Performs a left rotation on a pivot, rotating it into parent position
+ * @param root the root of the tree or subtree being modified, updated when the root changes
  * @param pivot the node to rotate into the parent position
  */
-static void rotate_left(struct rb_tree * tree, struct rb_node * pivot){
+static void rotate_left(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * pivot){
   assert(tree != NULL);
   assert(pivot != NULL);
   assert(pivot != tree->nil);
@@ -143,7 +373,7 @@ static void rotate_left(struct rb_tree * tree, struct rb_node * pivot){
 
   pivot->parent = parent->parent;
   if(parent->parent == tree->nil){
-    tree->root = pivot;
+    *root = pivot;
   }else{
     if(parent == parent->parent->left){
       parent->parent->left = pivot;
@@ -159,13 +389,18 @@ static void rotate_left(struct rb_tree * tree, struct rb_node * pivot){
   if(child != tree->nil){
     child->parent = parent;
   }
+
+  take_over_node(tree, pivot, parent);
+  update_node(tree, parent);
+  ADD_STAT(tree, rotations, 1);
 }
 
 /**
  * Performs a left rotation on a pivot, rotating it into parent position
+ * @param root the root of the tree or subtree being modified, updated when the root changes
  * @param pivot the node to rotate into the parent position
  */
-static void rotate_right(struct rb_tree * tree, struct rb_node * pivot){
+static void rotate_right(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * pivot){
   assert(tree != NULL);
   assert(pivot != NULL);
   assert(pivot != tree->nil);
@@ -177,7 +412,7 @@ static void rotate_right(struct rb_tree * tree, struct rb_node * pivot){
 
   pivot->parent = parent->parent;
   if(parent->parent == tree->nil){
-    tree->root = pivot;
+    *root = pivot;
   }else{
     if(parent == parent->parent->left){
       parent->parent->left = pivot;
@@ -193,6 +428,42 @@ static void rotate_right(struct rb_tree * tree, struct rb_node * pivot){
   if(child != tree->nil){
     child->parent = parent;
   }
+
+  take_over_node(tree, pivot, parent);
+  update_node(tree, parent);
+  ADD_STAT(tree, rotations, 1);
+}
+
+/**
+ * Allocates memory for a node, either from the pool or from the allocator of the tree
+ * @return a pointer to the uninitialized node
+ */
+static struct rb_node * alloc_node(struct rb_tree * tree){
+  assert(tree != NULL);
+
+  ADD_STAT(tree, allocations, 1);
+  if(tree->pool == NULL){
+    return allocator_alloc(tree->allocator, tree->node_size);
+  }else{
+    return memory_pool_alloc(tree->pool, tree->node_size);
+  }
+}
+
+/**
+ * Releases the memory of a node allocated by alloc_node
+ * @param node the node
+ */
+static void free_node(struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  assert(node != NULL);
+  assert(node != tree->nil);
+
+  ADD_STAT(tree, frees, 1);
+  if(tree->pool == NULL){
+    allocator_free(tree->allocator, node, tree->node_size);
+  }else{
+    memory_pool_free(tree->pool, node, tree->node_size);
+  }
 }
 
 /**
@@ -203,11 +474,15 @@ static void rotate_right(struct rb_tree * tree, struct rb_node * pivot){
 static struct rb_node * create_node(struct rb_tree * tree, void * value){
   assert(tree != NULL);
 
-  struct rb_node * node = malloc_checked(sizeof(struct rb_node));
-  node->value = value;
+  struct rb_node * node = alloc_node(tree);
+  set_node_value(tree, node, value);
+  node->size = 1;
   node->red = true;
   node->left = tree->nil;
   node->right = tree->nil;
+  if(tree->combine != NULL){
+    update_aggregate(tree, node);
+  }
   return node;
 }
 
@@ -219,11 +494,7 @@ void rb_tree_init(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_val
   assert(tree != NULL);
   assert(cmp_value != NULL);
 
-  struct rb_node * nil = malloc_checked(sizeof(struct rb_node));
-  nil->value = NULL;
-  nil->red = false;
-  nil->left = NULL;
-  nil->right = NULL;
+  struct rb_node * nil = &nil_node;
   
   tree->root = nil;
   tree->nil = nil;
@@ -234,6 +505,82 @@ void rb_tree_init(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_val
     tree->free_value = free_value;
   }
   tree->state = state;
+  tree->pool = NULL;
+  tree->owns_pool = false;
+  tree->allocator = &libc_allocator;
+  tree->value_size = 0;
+  tree->node_size = sizeof(struct rb_node);
+  tree->aggregate_size = 0;
+  tree->aggregate_offset = 0;
+  tree->lift = NULL;
+  tree->combine = NULL;
+#ifdef NDEBUG
+  tree->validation = RB_VALIDATION_OFF;
+#else
+  tree->validation = RB_VALIDATION_LOCAL;
+#endif
+  tree->validation_period = DEFAULT_VALIDATION_PERIOD;
+  tree->mutations = 0;
+  tree->finger = nil;
+  tree->finger_backoff = 0;
+  tree->finger_skip = 0;
+  tree->tasks = NULL;
+  rb_tree_reset_stats(tree);
+}
+
+void rb_tree_init_pooled(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_value, void * state, struct memory_pool * pool){
+  rb_tree_init(tree, cmp_value, free_value, state);
+
+  if(pool == NULL){
+    tree->pool = malloc_checked(sizeof(struct memory_pool));
+    memory_pool_init(tree->pool);
+    tree->owns_pool = true;
+  }else{
+    tree->pool = pool;
+  }
+}
+
+void rb_tree_init_allocator(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_value, void * state, struct allocator * allocator){
+  assert(allocator != NULL);
+
+  rb_tree_init(tree, cmp_value, free_value, state);
+  tree->allocator = allocator;
+}
+
+/**
+ * Computes the size of the nodes and the offset of their aggregate, which follows the value
+ */
+static void set_node_layout(struct rb_tree * tree){
+  size_t value_end = offsetof(struct rb_node, value) + (tree->value_size < sizeof(void *) ? sizeof(void *) : tree->value_size);
+  if(tree->aggregate_size == 0){
+    tree->aggregate_offset = 0;
+    tree->node_size = value_end < sizeof(struct rb_node) ? sizeof(struct rb_node) : value_end;
+  }else{
+    tree->aggregate_offset = (value_end + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    tree->node_size = tree->aggregate_offset + tree->aggregate_size;
+  }
+}
+
+void rb_tree_set_inline_values(struct rb_tree * tree, size_t value_size){
+  assert(tree != NULL);
+  assert(tree->root == tree->nil);
+  assert(value_size > 0);
+
+  tree->value_size = value_size;
+  set_node_layout(tree);
+}
+
+void rb_tree_set_aggregate(struct rb_tree * tree, size_t aggregate_size, rb_lift_f lift, rb_combine_f combine){
+  assert(tree != NULL);
+  assert(tree->root == tree->nil);
+  assert(aggregate_size > 0);
+  assert(lift != NULL);
+  assert(combine != NULL);
+
+  tree->aggregate_size = aggregate_size;
+  tree->lift = lift;
+  tree->combine = combine;
+  set_node_layout(tree);
 }
 
 /*
@@ -243,32 +590,88 @@ void rb_tree_init(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_val
 struct rb_node * rb_tree_find(const struct rb_tree * tree, void * value){
   assert(tree != NULL);
   
+  size_t length = 0;
   struct rb_node * node = tree->root;
   while(node != tree->nil){
-    int cmp = (*tree->cmp_value)(tree, value, node->value);
+    ++length;
+    int cmp = compare(tree, value, get_node_value(tree, node));
     if(cmp < 0){
       node = node->left;
     }else if(cmp > 0){
       node = node->right;
     }else{
-      break;
+      RECORD_PATH(tree, length);
+      return node;
     }
   }
-  return node;
+  RECORD_PATH(tree, length);
+  return NULL;
 }
 
-struct rb_node * rb_tree_get_begin(const struct rb_tree * tree){
-  assert(tree != NULL);
-  return get_min(tree, tree->root);
+/**
+ * The number of searches a batched find advances in lockstep, enough to cover the latency of a miss with independent loads
+ */
+#define FIND_BATCH_WIDTH 16
+
+/**
+ * Prefetches a node and its inline value
+ */
+static inline void prefetch_node(const struct rb_tree * tree, struct rb_node * node){
+  __builtin_prefetch(node);
+  if(tree->node_size > 64){
+    __builtin_prefetch((char *)node + 64);
+  }
 }
 
-struct rb_node * rb_tree_get_end(const struct rb_tree * tree){
+void rb_tree_find_batch(const struct rb_tree * tree, void ** values, size_t count, struct rb_node ** found){
   assert(tree != NULL);
-  return get_max(tree, tree->root);
-}
+  assert(count == 0 || (values != NULL && found != NULL));
+
+  struct rb_node * nodes[FIND_BATCH_WIDTH];
+  size_t lengths[FIND_BATCH_WIDTH];
+  for(size_t first = 0; first < count; first += FIND_BATCH_WIDTH){
+    size_t width = count - first < FIND_BATCH_WIDTH ? count - first : FIND_BATCH_WIDTH;
+    size_t active = 0;
+    for(size_t i = 0; i < width; ++i){
+      nodes[i] = tree->root;
+      lengths[i] = 0;
+      found[first + i] = NULL;
+      active += tree->root != tree->nil;
+    }
 
+    // every round takes each unfinished search one level down, the nodes of the next round were prefetched by this one
+    while(active > 0){
+      for(size_t i = 0; i < width; ++i){
+	struct rb_node * node = nodes[i];
+	if(node == tree->nil){
+	  continue;
+	}
+	++lengths[i];
+	int cmp = compare(tree, values[first + i], get_node_value(tree, node));
+	if(cmp == 0){
+	  found[first + i] = node;
+	  node = tree->nil;
+	}else{
+	  node = cmp < 0 ? node->left : node->right;
+	}
+	if(node == tree->nil){
+	  RECORD_PATH(tree, lengths[i]);
+	  --active;
+	}else{
+	  prefetch_node(tree, node);
+	}
+	nodes[i] = node;
+      }
+    }
+  }
+}
 
-struct rb_node * rb_tree_next(const struct rb_tree * tree, struct rb_node * node){
+/**
+ * Returns the in order successor of a node
+ * @param node a node, not NIL
+ * @return the successor or NIL if node is the maximum
+ */
+static struct rb_node * get_next_node(const struct rb_tree * tree, struct rb_node * node){
   assert(tree != NULL);
   assert(node != NULL);
   assert(node != tree->nil);
@@ -283,7 +686,12 @@ struct rb_node * rb_tree_next(const struct rb_tree * tree, struct rb_node * node
   }
 }
 
-struct rb_node * rb_tree_previous(const struct rb_tree * tree, struct rb_node * node){
+/**
+ * Returns the in order predecessor of a node
+ * @param node a node, not NIL
+ * @return the predecessor or NIL if node is the minimum
+ */
+static struct rb_node * get_previous_node(const struct rb_tree * tree, struct rb_node * node){
   assert(tree != NULL);
   assert(node != NULL);
   assert(node != tree->nil);
@@ -298,11 +706,78 @@ struct rb_node * rb_tree_previous(const struct rb_tree * tree, struct rb_node *
   }
 }
 
+/**
+ * Converts the NIL node to NULL for the public interface
+ */
+static inline struct rb_node * nil_to_null(const struct rb_tree * tree, struct rb_node * node){
+  return node == tree->nil ? NULL : node;
+}
+
+/**
+ * Finds the first node with a value greater than, or if inclusive is set equal to, a value
+ * @return the node or NIL if no such node exists
+ */
+static struct rb_node * find_bound(const struct rb_tree * tree, void * value, bool inclusive){
+  size_t length = 0;
+  struct rb_node * bound = tree->nil;
+  struct rb_node * node = tree->root;
+  while(node != tree->nil){
+    ++length;
+    int cmp = compare(tree, value, get_node_value(tree, node));
+    if(cmp < 0 || (cmp == 0 && inclusive)){
+      bound = node;
+      node = node->left;
+    }else{
+      node = node->right;
+    }
+  }
+  RECORD_PATH(tree, length);
+  return bound;
+}
+
+struct rb_node * rb_tree_lower_bound(const struct rb_tree * tree, void * value){
+  assert(tree != NULL);
+  return nil_to_null(tree, find_bound(tree, value, true));
+}
+
+struct rb_node * rb_tree_upper_bound(const struct rb_tree * tree, void * value){
+  assert(tree != NULL);
+  return nil_to_null(tree, find_bound(tree, value, false));
+}
+
+struct rb_node * rb_tree_get_begin(const struct rb_tree * tree){
+  assert(tree != NULL);
+  return nil_to_null(tree, get_min(tree, tree->root));
+}
+
+struct rb_node * rb_tree_get_end(const struct rb_tree * tree){
+  assert(tree != NULL);
+  return nil_to_null(tree, get_max(tree, tree->root));
+}
+
+struct rb_node * rb_tree_get_next(const struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  return nil_to_null(tree, get_next_node(tree, node));
+}
+
+struct rb_node * rb_tree_get_previous(const struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  return nil_to_null(tree, get_previous_node(tree, node));
+}
+
+struct rb_node * rb_tree_get_node(const struct rb_tree * tree, void * value){
+  assert(tree != NULL);
+  assert(tree->value_size != 0);
+  assert(value != NULL);
+
+  return (struct rb_node *)((char *)value - offsetof(struct rb_node, value));
+}
+
 void * rb_tree_get_value(const struct rb_tree * tree, struct rb_node * node){
   assert(tree != NULL);
   assert(node != NULL);
   assert(node != tree->nil);
-  return node->value;
+  return get_node_value(tree, node);
 }
 
 void rb_tree_apply(struct rb_tree * tree, rb_apply_f apply){
@@ -311,49 +786,294 @@ void rb_tree_apply(struct rb_tree * tree, rb_apply_f apply){
 
   struct rb_node * node = get_min(tree, tree->root);
   while(node != tree->nil){
-    (*apply)(tree, node->value);
-    node = rb_tree_next(tree, node);
+    (*apply)(tree, get_node_value(tree, node));
+    node = get_next_node(tree, node);
   }
 }
 
-/*
- * Inspection
+/**
+ * The smallest number of nodes for which the recursion of a parallel operation forks
  */
+#define PARALLEL_CUTOFF 4096
 
-bool rb_tree_is_empty(const struct rb_tree * tree){
-  assert(tree !=NULL);
-  
-  return tree->root != tree->nil;
+/**
+ * A subtree to apply a function to, possibly on another thread
+ */
+struct apply_task{
+
+  /**
+   * The tree
+   */
+  struct rb_tree * tree;
+
+  /**
+   * The function to apply
+   */
+  rb_apply_f apply;
+
+  /**
+   * The root of the subtree
+   */
+  struct rb_node * root;
+};
+
+/**
+ * Applies a function to all values in a subtree, forking for both children of large subtrees
+ */
+static void apply_subtree(void * data){
+  struct apply_task * task = (struct apply_task *)data;
+  struct rb_tree * tree = task->tree;
+  struct rb_node * root = task->root;
+  if(root->size < PARALLEL_CUTOFF){
+    struct rb_node * node = get_min(tree, root);
+    for(size_t i = 0; i < root->size; ++i){
+      (*task->apply)(tree, get_node_value(tree, node));
+      node = get_next_node(tree, node);
+    }
+  }else{
+    struct apply_task left = {tree, task->apply, root->left};
+    struct apply_task right = {tree, task->apply, root->right};
+    task_pool_fork_join(tree->tasks, &apply_subtree, &left, &apply_subtree, &right);
+    (*task->apply)(tree, get_node_value(tree, root));
+  }
+}
+
+void rb_tree_apply_parallel(struct rb_tree * tree, rb_apply_f apply){
+  assert(tree != NULL);
+  assert(apply != NULL);
+
+  if(tree->tasks == NULL){
+    rb_tree_apply(tree, apply);
+  }else{
+    struct apply_task task = {tree, apply, tree->root};
+    task_pool_run(tree->tasks, &apply_subtree, &task);
+  }
 }
 
 /*
- * Insertion
+ * Inspection
  */
 
-/**
- * Fixes the tree after an insert
- */
-static void fix_after_insert(struct rb_tree * tree, struct rb_node * node){
+void rb_tree_set_validation(struct rb_tree * tree, enum rb_validation validation, size_t period){
   assert(tree != NULL);
-  assert(node != NULL);
-  assert(node != tree->nil);
-  
-  while(node->parent->red){
-    if(node->parent == node->parent->parent->left){
-      struct rb_node * uncle = node->parent->parent->right;
-      if(uncle->red){
-	node->parent->red = false;
-	uncle->red = false;
+  assert(validation != RB_VALIDATION_SAMPLED || period > 0);
+
+  tree->validation = validation;
+  tree->validation_period = validation == RB_VALIDATION_SAMPLED ? period : DEFAULT_VALIDATION_PERIOD;
+  tree->mutations = 0;
+}
+
+void rb_tree_get_stats(const struct rb_tree * tree, struct rb_tree_stats * stats){
+  assert(tree != NULL);
+  assert(stats != NULL);
+#ifdef RB_TREE_STATS
+  memcpy(stats, &tree->stats, sizeof(struct rb_tree_stats));
+#else
+  memset(stats, 0, sizeof(struct rb_tree_stats));
+#endif
+}
+
+void rb_tree_reset_stats(struct rb_tree * tree){
+  assert(tree != NULL);
+#ifdef RB_TREE_STATS
+  memset(&tree->stats, 0, sizeof(struct rb_tree_stats));
+#endif
+}
+
+void rb_tree_set_task_pool(struct rb_tree * tree, struct task_pool * tasks){
+  assert(tree != NULL);
+  tree->tasks = tasks;
+}
+
+bool rb_tree_validate(const struct rb_tree * tree){
+  assert(tree != NULL);
+
+  return !tree->root->red && validate_node(tree, tree->root, tree->nil, tree->nil) >= 0;
+}
+
+bool rb_tree_is_empty(const struct rb_tree * tree){
+  assert(tree !=NULL);
+  
+  return tree->root == tree->nil;
+}
+
+size_t rb_tree_size(const struct rb_tree * tree){
+  assert(tree != NULL);
+
+  return tree->root->size;
+}
+
+struct rb_node * rb_tree_select(const struct rb_tree * tree, size_t index){
+  assert(tree != NULL);
+
+  struct rb_node * node = tree->root;
+  while(node != tree->nil){
+    size_t left = node->left->size;
+    if(index < left){
+      node = node->left;
+    }else if(index > left){
+      index -= left + 1;
+      node = node->right;
+    }else{
+      return node;
+    }
+  }
+  return NULL;
+}
+
+size_t rb_tree_rank(const struct rb_tree * tree, void * value){
+  assert(tree != NULL);
+
+  size_t length = 0;
+  size_t rank = 0;
+  struct rb_node * node = tree->root;
+  while(node != tree->nil){
+    ++length;
+    int cmp = compare(tree, value, get_node_value(tree, node));
+    if(cmp < 0){
+      node = node->left;
+    }else if(cmp > 0){
+      rank += node->left->size + 1;
+      node = node->right;
+    }else{
+      RECORD_PATH(tree, length);
+      return rank + node->left->size;
+    }
+  }
+  RECORD_PATH(tree, length);
+  return rank;
+}
+
+size_t rb_tree_count_range(const struct rb_tree * tree, void * low, void * high){
+  assert(tree != NULL);
+
+  size_t low_rank = rb_tree_rank(tree, low);
+  size_t high_rank = rb_tree_rank(tree, high);
+  return high_rank > low_rank ? high_rank - low_rank : 0;
+}
+
+/*
+ * Aggregates
+ */
+
+const void * rb_tree_get_aggregate(const struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  assert(tree->combine != NULL);
+  assert(node != NULL && node != tree->nil);
+
+  return get_node_aggregate(tree, node);
+}
+
+void rb_tree_update_aggregate(struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  assert(tree->combine != NULL);
+  assert(node != NULL && node != tree->nil);
+
+  for(; node != tree->nil; node = node->parent){
+    update_aggregate(tree, node);
+  }
+}
+
+/**
+ * The size up to which the scratch aggregate of a range reduction lives on the stack
+ */
+#define REDUCE_STACK_SIZE 64
+
+bool rb_tree_range_reduce(const struct rb_tree * tree, void * low, void * high, void * result){
+  assert(tree != NULL);
+  assert(tree->combine != NULL);
+  assert(result != NULL);
+
+  // the highest node in the range splits it into a suffix of its left subtree and a prefix of its right subtree
+  struct rb_node * split = tree->root;
+  while(split != tree->nil){
+    if(compare(tree, get_node_value(tree, split), low) < 0){
+      split = split->right;
+    }else if(compare(tree, get_node_value(tree, split), high) >= 0){
+      split = split->left;
+    }else{
+      break;
+    }
+  }
+  if(split == tree->nil){
+    return false;
+  }
+
+  void * stack[REDUCE_STACK_SIZE / sizeof(void *)];
+  void * scratch = tree->aggregate_size <= sizeof(stack) ? (void *)stack : malloc_checked(tree->aggregate_size);
+  (*tree->lift)(tree, result, get_node_value(tree, split));
+
+  // nodes of the left subtree in the range come with their whole right subtree and precede what was found so far
+  for(struct rb_node * node = split->left; node != tree->nil;){
+    if(compare(tree, get_node_value(tree, node), low) < 0){
+      node = node->right;
+    }else{
+      (*tree->lift)(tree, scratch, get_node_value(tree, node));
+      if(node->right != tree->nil){
+	(*tree->combine)(tree, scratch, scratch, get_node_aggregate(tree, node->right));
+      }
+      (*tree->combine)(tree, result, scratch, result);
+      node = node->left;
+    }
+  }
+
+  // nodes of the right subtree in the range come after their whole left subtree and after what was found so far
+  for(struct rb_node * node = split->right; node != tree->nil;){
+    if(compare(tree, get_node_value(tree, node), high) >= 0){
+      node = node->left;
+    }else{
+      if(node->left != tree->nil){
+	(*tree->combine)(tree, result, result, get_node_aggregate(tree, node->left));
+      }
+      (*tree->lift)(tree, scratch, get_node_value(tree, node));
+      (*tree->combine)(tree, result, result, scratch);
+      node = node->right;
+    }
+  }
+
+  if(scratch != (void *)stack){
+    free(scratch);
+  }
+  return true;
+}
+
+/*
+ * Insertion
+ */
+
+/**
+ * Fixes the tree after an insert
+ * @param root the root of the tree or subtree being modified, updated when the root changes
+ * @param node the inserted red node
+ * @return true if the black height of the tree grew, false otherwise
+ */
+static bool fix_after_insert(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * node){
+  assert(tree != NULL);
+  assert(node != NULL);
+  assert(node != tree->nil);
+  
+  while(node->parent->red){
+    if(node->parent == node->parent->parent->left){
+      struct rb_node * uncle = node->parent->parent->right;
+      if(uncle->red){
+	node->parent->red = false;
+	uncle->red = false;
 	node->parent->parent->red = true;
 	node = node->parent->parent;
+	ADD_STAT(tree, insert_recolors, 1);
+	ADD_STAT(tree, recolorings, 3);
       }else{
 	if(node == node->parent->right){
-	  rotate_left(tree, node);
+	  rotate_left(tree, root, node);
 	  node = node->left;
+	  ADD_STAT(tree, insert_double_rotations, 1);
+	}else{
+	  ADD_STAT(tree, insert_single_rotations, 1);
 	}
-	rotate_right(tree, node->parent);
+	rotate_right(tree, root, node->parent);
 	node->parent->red = false;
 	node->parent->right->red = true;
+	ADD_STAT(tree, recolorings, 2);
       }
     }else{
       struct rb_node * uncle = node->parent->parent->left;
@@ -362,199 +1082,527 @@ static void fix_after_insert(struct rb_tree * tree, struct rb_node * node){
 	uncle->red = false;
 	node->parent->parent->red = true;
 	node = node->parent->parent;
+	ADD_STAT(tree, insert_recolors, 1);
+	ADD_STAT(tree, recolorings, 3);
       }else{
 	if(node == node->parent->left){
-	  rotate_right(tree, node);
+	  rotate_right(tree, root, node);
 	  node = node->right;
+	  ADD_STAT(tree, insert_double_rotations, 1);
+	}else{
+	  ADD_STAT(tree, insert_single_rotations, 1);
 	}
-	rotate_left(tree, node->parent);
+	rotate_left(tree, root, node->parent);
 	node->parent->red = false;
 	node->parent->left->red = true;
+	ADD_STAT(tree, recolorings, 2);
       }
     }
   }
-  tree->root->red = false;
+  bool grown = (*root)->red;
+  (*root)->red = false;
+  ADD_STAT(tree, recolorings, grown);
+  return grown;
 }
 
-bool rb_tree_insert(struct rb_tree * tree, void * value){
-  assert(tree != NULL);
+/**
+ * The largest number of inserts for which the finger is not tried after repeated misses
+ */
+#define MAX_FINGER_BACKOFF 64
 
-  if(tree->root == tree->nil){
-    struct rb_node * node = create_node(tree, value);
-    node->parent = tree->nil;
-    node->red = false;
+/**
+ * Attaches a new node as a child of parent and rebalances the tree
+ * @param parent the parent of the new node or NIL if the tree is empty
+ * @param left whether the node becomes the left child
+ * @param value the value of the new node
+ * @return the new node
+ */
+static struct rb_node * attach_node(struct rb_tree * tree, struct rb_node * parent, bool left, void * value){
+  struct rb_node * node = create_node(tree, value);
+  node->parent = parent;
+  if(parent == tree->nil){
     tree->root = node;
-
-#ifndef NDEBUG
-    assert_tree(tree);
-#endif
-
-    return false;
+  }else if(left){
+    assert(parent->left == tree->nil);
+    parent->left = node;
   }else{
-    struct rb_node * pos = tree->root;
-    while(true){
-      int cmp = (*tree->cmp_value)(tree, value, pos->value);
-      if(cmp < 0){
-	if(pos->left == tree->nil){
-	  struct rb_node * node = create_node(tree, value);
-	  node->parent = pos;
-	  pos->left = node;
-	  fix_after_insert(tree, node);
+    assert(parent->right == tree->nil);
+    parent->right = node;
+  }
+  grow_ancestors(tree, parent, 1);
+  fix_after_insert(tree, &tree->root, node);
+  validate_mutation(tree, node);
+  tree->finger = node;
+  return node;
+}
 
-#ifndef NDEBUG
-	  assert_tree(tree);
-#endif
+/**
+ * Replaces the value of a node, freeing the old value
+ */
+static void replace_value(struct rb_tree * tree, struct rb_node * node, void * value){
+  (*tree->free_value)(tree, get_node_value(tree, node));
+  set_node_value(tree, node, value);
+  if(tree->combine != NULL){
+    rb_tree_update_aggregate(tree, node);
+  }
+}
 
-	  return false;
-	}else{
-	  pos = pos->left;
-	}
+/**
+ * Handles a value found equal to the value of a node during an insert
+ * @param replace whether the value replaces the value of the node or is dropped
+ * @param found set to true
+ * @return the node
+ */
+static struct rb_node * insert_existing(struct rb_tree * tree, struct rb_node * node, void * value, bool replace, bool * found){
+  if(replace){
+    replace_value(tree, node, value);
+  }
+  *found = true;
+  return node;
+}
+
+/**
+ * Inserts a value at or directly next to a node, using at most two comparisons
+ * @param hint a node, not NIL
+ * @param value the value to insert
+ * @param replace whether the value replaces an equal value or is dropped
+ * @param found set to true if the tree held an equal value
+ * @return the node holding the value or an equal value, or NIL if the value does not belong next to hint
+ */
+static struct rb_node * insert_near(struct rb_tree * tree, struct rb_node * hint, void * value, bool replace, bool * found){
+  int cmp = compare(tree, value, get_node_value(tree, hint));
+  if(cmp == 0){
+    return insert_existing(tree, hint, value, replace, found);
+  }else if(cmp < 0){
+    struct rb_node * previous = get_previous_node(tree, hint);
+    if(previous != tree->nil){
+      cmp = compare(tree, value, get_node_value(tree, previous));
+      if(cmp == 0){
+	return insert_existing(tree, previous, value, replace, found);
+      }else if(cmp < 0){
+	return tree->nil;
+      }
+    }
+    if(hint->left == tree->nil){
+      return attach_node(tree, hint, true, value);
+    }else{
+      return attach_node(tree, previous, false, value);
+    }
+  }else{
+    struct rb_node * next = get_next_node(tree, hint);
+    if(next != tree->nil){
+      cmp = compare(tree, value, get_node_value(tree, next));
+      if(cmp == 0){
+	return insert_existing(tree, next, value, replace, found);
       }else if(cmp > 0){
-	if(pos->right == tree->nil){
-	  struct rb_node * node = create_node(tree, value);
-	  node->parent = pos;
-	  pos->right = node;
-	  fix_after_insert(tree, node);
+	return tree->nil;
+      }
+    }
+    if(hint->right == tree->nil){
+      return attach_node(tree, hint, false, value);
+    }else{
+      return attach_node(tree, next, true, value);
+    }
+  }
+}
 
-#ifndef NDEBUG
-	  assert_tree(tree);
-#endif
-	  
-	  return false;
-	}else{
-	  pos = pos->right;
-	}
-      }else{
-	(*tree->free_value)(tree, pos->value);
-	pos->value = value;
-	return true;
+/**
+ * Inserts a value by descending from the root
+ * @param replace whether the value replaces an equal value or is dropped
+ * @param found set to true if the tree held an equal value
+ * @return the node holding the value or an equal value
+ */
+static struct rb_node * insert_from_root(struct rb_tree * tree, void * value, bool replace, bool * found){
+  size_t length = 0;
+  struct rb_node * parent = tree->nil;
+  struct rb_node * pos = tree->root;
+  int cmp = 0;
+  while(pos != tree->nil){
+    ++length;
+    cmp = compare(tree, value, get_node_value(tree, pos));
+    if(cmp == 0){
+      RECORD_PATH(tree, length);
+      return insert_existing(tree, pos, value, replace, found);
+    }
+    parent = pos;
+    pos = cmp < 0 ? pos->left : pos->right;
+  }
+  RECORD_PATH(tree, length);
+  return attach_node(tree, parent, cmp < 0, value);
+}
+
+/**
+ * Inserts a value next to the finger if it belongs there, from the root otherwise
+ * @param replace whether the value replaces an equal value or is dropped
+ * @param found set to true if the tree held an equal value
+ * @return the node holding the value or an equal value
+ */
+static struct rb_node * insert_value(struct rb_tree * tree, void * value, bool replace, bool * found){
+  *found = false;
+  if(tree->finger != tree->nil){
+    // sequential inserts land next to the previous one, so try there first
+    // and back off exponentially while that keeps failing
+    if(tree->finger_skip == 0){
+      struct rb_node * node = insert_near(tree, tree->finger, value, replace, found);
+      if(node != tree->nil){
+	tree->finger_backoff = 0;
+	return node;
+      }
+      tree->finger_backoff = tree->finger_backoff == 0 ? 1 : tree->finger_backoff * 2;
+      if(tree->finger_backoff > MAX_FINGER_BACKOFF){
+	tree->finger_backoff = MAX_FINGER_BACKOFF;
       }
+      tree->finger_skip = tree->finger_backoff;
+    }else{
+      --tree->finger_skip;
+    }
+  }
+  return insert_from_root(tree, value, replace, found);
+}
+
+bool rb_tree_insert(struct rb_tree * tree, void * value){
+  assert(tree != NULL);
+
+  bool replaced;
+  insert_value(tree, value, true, &replaced);
+  return replaced;
+}
+
+struct rb_node * rb_tree_find_or_insert(struct rb_tree * tree, void * value, bool * inserted){
+  assert(tree != NULL);
+  assert(inserted != NULL);
+
+  bool found;
+  struct rb_node * node = insert_value(tree, value, false, &found);
+  *inserted = !found;
+  return node;
+}
+
+struct rb_node * rb_tree_insert_hint(struct rb_tree * tree, struct rb_node * hint, void * value){
+  assert(tree != NULL);
+  assert(hint != tree->nil);
+
+  if(hint == NULL){
+    hint = get_max(tree, tree->root);
+  }
+  
+  bool replaced = false;
+  if(hint != tree->nil){
+    struct rb_node * node = insert_near(tree, hint, value, true, &replaced);
+    if(node != tree->nil){
+      return node;
     }
   }
+  return insert_from_root(tree, value, true, &replaced);
+}
+
+/*
+ * Bulk construction
+ */
+
+/**
+ * The state of a bulk construction
+ */
+struct build{
+
+  /**
+   * The tree under construction
+   */
+  struct rb_tree * tree;
+
+  /**
+   * The function producing the values in order
+   */
+  rb_next_f next;
+
+  /**
+   * The state of the next function
+   */
+  void * iterator;
+
+  /**
+   * The depth of the red nodes, the only level of the tree that may be incomplete
+   */
+  size_t red_depth;
+
+  /**
+   * The last node created
+   */
+  struct rb_node * last;
+};
+
+/**
+ * Builds a perfectly balanced subtree, creating the nodes in order
+ * @param count the number of nodes in the subtree
+ * @param depth the depth of the root of the subtree
+ * @return the root of the subtree or NIL if count is 0
+ */
+static struct rb_node * build_subtree(struct build * build, size_t count, size_t depth){
+  struct rb_tree * tree = build->tree;
+  if(count == 0){
+    return tree->nil;
+  }
+
+  size_t left_count = count / 2;
+  struct rb_node * left = build_subtree(build, left_count, depth + 1);
+
+  struct rb_node * node = create_node(tree, (*build->next)(tree, build->iterator));
+  assert(build->last == tree->nil || (*tree->cmp_value)(tree, get_node_value(tree, build->last), get_node_value(tree, node)) < 0);
+  build->last = node;
+  node->size = count;
+  node->red = depth == build->red_depth;
+  node->left = left;
+  if(left != tree->nil){
+    left->parent = node;
+  }
+
+  node->right = build_subtree(build, count - left_count - 1, depth + 1);
+  if(node->right != tree->nil){
+    node->right->parent = node;
+  }
+  if(tree->combine != NULL){
+    update_aggregate(tree, node);
+  }
+  return node;
+}
+
+void rb_tree_build_sorted_from(struct rb_tree * tree, size_t count, rb_next_f next, void * iterator){
+  assert(tree != NULL);
+  assert(tree->root == tree->nil);
+  assert(next != NULL);
+
+  // all levels above the deepest one are complete, so coloring the deepest level red
+  // gives every path the same number of black nodes
+  size_t complete_levels = 0;
+  while(((size_t)2 << complete_levels) - 1 <= count){
+    ++complete_levels;
+  }
+  
+  struct build build = {tree, next, iterator, complete_levels, tree->nil};
+  tree->root = build_subtree(&build, count, 0);
+  tree->root->parent = tree->nil;
+  tree->root->red = false;
+  tree->finger = build.last;
+  validate_mutation(tree, tree->root);
+}
+
+/**
+ * The state of a bulk construction from an array
+ */
+struct array_iterator{
+  char * values;
+  size_t stride;
+};
+
+static void * next_array_value(struct rb_tree * tree, void * iterator){
+  struct array_iterator * array = (struct array_iterator *)iterator;
+  void * value = tree->value_size == 0 ? *(void **)array->values : array->values;
+  array->values += array->stride;
+  return value;
+}
+
+void rb_tree_build_sorted(struct rb_tree * tree, void * values, size_t count){
+  assert(tree != NULL);
+  assert(values != NULL || count == 0);
+
+  struct array_iterator array = {(char *)values, tree->value_size == 0 ? sizeof(void *) : tree->value_size};
+  rb_tree_build_sorted_from(tree, count, &next_array_value, &array);
 }
 
 /*
  * Deletion
  */
 
-static void replace_node(struct rb_tree * tree, struct rb_node * node, struct rb_node * repl){
+/**
+ * Replaces the subtree rooted at node by the subtree rooted at repl
+ * The children of node are left untouched
+ * @param root the root of the tree or subtree being modified, updated when the root changes
+ */
+static void replace_node(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * node, struct rb_node * repl){
   assert(tree != NULL);
   assert(node != NULL);
   assert(node != tree->nil);
-  assert((node->left == tree->nil && repl == node->right) || (node->right == tree->nil && repl == node->left));
+  assert(repl != NULL);
 
   if(node->parent == tree->nil){
-    tree->root = repl;
+    *root = repl;
   }else if(node == node->parent->left){
     node->parent->left = repl;
   }else{
     node->parent->right = repl;
   }
-  repl->parent = node->parent;
+  if(repl != tree->nil){
+    repl->parent = node->parent;
+  }
 }
 
-static void fix_after_delete(struct rb_tree * tree, struct rb_node * node){
+/**
+ * Fixes the tree after a black node was removed
+ * The sentinel is never written, so the parent of the node is passed explicitly
+ * @param root the root of the tree or subtree being modified, updated when the root changes
+ * @param node the node that took the place of the removed node, possibly NIL
+ * @param parent the parent of that node
+ * @return true if the black height of the tree shrank, false otherwise
+ */
+static bool fix_after_delete(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * node, struct rb_node * parent){
   assert(tree != NULL);
   assert(node != NULL);
 
-  while(node->parent != tree->nil && !node->red){
-    if(node == node->parent->left){
-      struct rb_node * sibling = node->parent->right;
+  while(node != *root && !node->red){
+    if(node == parent->left){
+      struct rb_node * sibling = parent->right;
       if(sibling->red){
 	sibling->red = false;
-	node->parent->red = true;
-	rotate_left(tree, sibling);
-	sibling = node->parent->right;
+	parent->red = true;
+	rotate_left(tree, root, sibling);
+	sibling = parent->right;
+	ADD_STAT(tree, delete_sibling_rotations, 1);
+	ADD_STAT(tree, recolorings, 2);
       }
       if(!sibling->left->red && !sibling->right->red){
 	sibling->red = true;
-	node = node->parent;
+	node = parent;
+	parent = node->parent;
+	ADD_STAT(tree, delete_recolors, 1);
+	ADD_STAT(tree, recolorings, 1);
       }else{
 	if(!sibling->right->red){
 	  sibling->left->red = false;
 	  sibling->red = true;
-	  rotate_right(tree, sibling->left);
-	  sibling = node->parent->right;
+	  rotate_right(tree, root, sibling->left);
+	  sibling = parent->right;
+	  ADD_STAT(tree, delete_double_rotations, 1);
+	  ADD_STAT(tree, recolorings, 2);
+	}else{
+	  ADD_STAT(tree, delete_single_rotations, 1);
 	}
-	sibling->red = node->parent->red;
-	node->parent->red = false;
+	sibling->red = parent->red;
+	parent->red = false;
 	sibling->right->red = false;
-	rotate_left(tree, node->parent->right);
-	node = tree->root;
+	rotate_left(tree, root, sibling);
+	ADD_STAT(tree, recolorings, 3);
+	return false;
       }
-      
     }else{
-      struct rb_node * sibling = node->parent->left;
+      struct rb_node * sibling = parent->left;
       if(sibling->red){
 	sibling->red = false;
-	node->parent->red = true;
-	rotate_right(tree, sibling);
-	sibling = node->parent->left;
+	parent->red = true;
+	rotate_right(tree, root, sibling);
+	sibling = parent->left;
+	ADD_STAT(tree, delete_sibling_rotations, 1);
+	ADD_STAT(tree, recolorings, 2);
       }
       if(!sibling->right->red && !sibling->left->red){
 	sibling->red = true;
-	node = node->parent;
+	node = parent;
+	parent = node->parent;
+	ADD_STAT(tree, delete_recolors, 1);
+	ADD_STAT(tree, recolorings, 1);
       }else{
 	if(!sibling->left->red){
 	  sibling->right->red = false;
 	  sibling->red = true;
-	  rotate_left(tree, sibling->right);
-	  sibling = node->parent->left;
+	  rotate_left(tree, root, sibling->right);
+	  sibling = parent->left;
+	  ADD_STAT(tree, delete_double_rotations, 1);
+	  ADD_STAT(tree, recolorings, 2);
+	}else{
+	  ADD_STAT(tree, delete_single_rotations, 1);
 	}
-	sibling->red = node->parent->red;
-	node->parent->red = false;
+	sibling->red = parent->red;
+	parent->red = false;
 	sibling->left->red = false;
-	rotate_right(tree, node->parent->left);
-	node = tree->root;
+	rotate_right(tree, root, sibling);
+	ADD_STAT(tree, recolorings, 3);
+	return false;
       }
     }
   }
-  node->red = false;
+  if(node->red){
+    node->red = false;
+    ADD_STAT(tree, recolorings, 1);
+    return false;
+  }else{
+    // the missing black node propagated up to the root
+    return true;
+  }
 }
 
-void rb_tree_delete(struct rb_tree * tree, struct rb_node * node){
+/**
+ * Removes a node from the tree and rebalances it, without freeing the node
+ * Nodes are relinked rather than having their values swapped, so other nodes stay valid
+ * and inline values are never copied
+ * @param root the root of the tree or subtree being modified, updated when the root changes
+ * @param node the node to remove
+ * @param shrank set to true if the black height of the tree shrank
+ * @return the lowest node whose subtree changed or NIL
+ */
+static struct rb_node * unlink_node(const struct rb_tree * tree, struct rb_node ** root, struct rb_node * node, bool * shrank){
   assert(tree != NULL);
   assert(node != NULL);
   assert(node != tree->nil);
-  
-  if(node->left == tree->nil){
-    replace_node(tree, node, node->right);
-    if(!node->red){
-      fix_after_delete(tree, node->right);
-    }
-    (*tree->free_value)(tree, node->value);
-    free(node);
-
-#ifndef NDEBUG
-    assert_tree(tree);
-#endif
 
+  struct rb_node * child;
+  struct rb_node * parent;
+  bool removed_red = node->red;
+  if(node->left == tree->nil){
+    child = node->right;
+    parent = node->parent;
+    replace_node(tree, root, node, child);
   }else if(node->right == tree->nil){
-    replace_node(tree, node, node->left);
-    if(!node->red){
-      fix_after_delete(tree, node->left);
+    child = node->left;
+    parent = node->parent;
+    replace_node(tree, root, node, child);
+  }else{
+    struct rb_node * repl = get_min(tree, node->right);
+    removed_red = repl->red;
+    child = repl->right;
+    if(repl->parent == node){
+      parent = repl;
+    }else{
+      parent = repl->parent;
+      replace_node(tree, root, repl, child);
+      repl->right = node->right;
+      repl->right->parent = repl;
     }
-    (*tree->free_value)(tree, node->value);
-    free(node);
+    replace_node(tree, root, node, repl);
+    repl->left = node->left;
+    repl->left->parent = repl;
+    repl->red = node->red;
+  }
+  // every node whose subtree lost a node lies on the path up from the parent of the child
+  for(struct rb_node * ancestor = parent; ancestor != tree->nil; ancestor = ancestor->parent){
+    update_node(tree, ancestor);
+  }
+  if(removed_red){
+    *shrank = false;
+  }else{
+    *shrank = fix_after_delete(tree, root, child, parent);
+  }
+  return parent;
+}
 
-#ifndef NDEBUG
-    assert_tree(tree);
-#endif
+void rb_tree_delete(struct rb_tree * tree, struct rb_node * node){
+  assert(tree != NULL);
+  assert(node != NULL);
+  assert(node != tree->nil);
 
-  }else{
-    struct rb_node * repl = get_min(tree, node->right);
-    void * value = node->value;
-    node->value = repl->value;
-    repl->value = value;
-    rb_tree_delete(tree, repl);
+  bool shrank;
+  struct rb_node * touched = unlink_node(tree, &tree->root, node, &shrank);
+  if(node == tree->finger){
+    tree->finger = tree->nil;
   }
+  (*tree->free_value)(tree, get_node_value(tree, node));
+  free_node(tree, node);
+  validate_mutation(tree, touched);
 }
 
 bool rb_tree_find_and_delete(struct rb_tree * tree, void * value){
   assert(tree != NULL);
 
   struct rb_node * node = rb_tree_find(tree, value);
-  if(node == tree->nil){
+  if(node == NULL){
     return false;
   }else{
     rb_tree_delete(tree, node);
@@ -562,6 +1610,608 @@ bool rb_tree_find_and_delete(struct rb_tree * tree, void * value){
   }
 }
 
+/**
+ * Frees nodes and values of a detached subtree, cutting each node from its parent on the way down
+ * so the walk can be resumed from the node it stopped at
+ * @param node the node to start at, the subtree left by a previous walk or a subtree whose root has a NIL parent
+ * @param budget the largest number of nodes to free
+ * @return the node to resume at or NIL if the whole subtree is freed
+ */
+static struct rb_node * free_nodes(struct rb_tree * tree, struct rb_node * node, size_t budget){
+  struct rb_node * next;
+  while(node != tree->nil && budget > 0){
+    if(node->left != tree->nil){
+      next = node->left;
+      node->left = tree->nil;
+    }else if(node->right != tree->nil){
+      next = node->right;
+      node->right = tree->nil;
+    }else{
+      next = node->parent;
+      (*tree->free_value)(tree, get_node_value(tree, node));
+      free_node(tree, node);
+      --budget;
+    }
+    node = next;
+  }
+  return node;
+}
+
+/**
+ * Frees all nodes and values of a detached subtree
+ * @param node the root of the subtree, its parent should be NIL
+ */
+static void free_subtree(struct rb_tree * tree, struct rb_node * node){
+  free_nodes(tree, node, SIZE_MAX);
+}
+
+/*
+ * Joining and splitting
+ */
+
+/**
+ * A detached subtree with a black root, or the empty subtree
+ */
+struct subtree{
+
+  /**
+   * The root, whose parent is NIL
+   */
+  struct rb_node * root;
+
+  /**
+   * The number of black nodes on every path from the root to a leaf
+   */
+  size_t black_height;
+};
+
+/**
+ * Detaches a subtree, coloring its root black
+ * @param root the root of the subtree or NIL
+ * @param black_height the black height of the subtree before the root is colored black
+ */
+static struct subtree make_subtree(const struct rb_tree * tree, struct rb_node * root, size_t black_height){
+  if(root != tree->nil){
+    root->parent = tree->nil;
+    if(root->red){
+      root->red = false;
+      ++black_height;
+    }
+  }
+  struct subtree subtree = {root, black_height};
+  return subtree;
+}
+
+/**
+ * Detaches all nodes from a tree, leaving it empty
+ */
+static struct subtree take_subtree(struct rb_tree * tree){
+  size_t black_height = 0;
+  for(struct rb_node * node = tree->root; node != tree->nil; node = node->left){
+    if(!node->red){
+      ++black_height;
+    }
+  }
+  struct subtree subtree = {tree->root, black_height};
+  tree->root = tree->nil;
+  tree->finger = tree->nil;
+  return subtree;
+}
+
+/**
+ * Makes a subtree the contents of an empty tree
+ */
+static void put_subtree(struct rb_tree * tree, struct subtree subtree){
+  assert(tree->root == tree->nil);
+
+  tree->root = subtree.root;
+  tree->finger = tree->nil;
+  validate_mutation(tree, tree->root);
+}
+
+/**
+ * Joins two subtrees and a pivot node, all values in left being smaller and all values in right greater than the pivot
+ * Costs O(|difference of the black heights| + 1)
+ * @param left the left subtree
+ * @param pivot a detached node
+ * @param right the right subtree
+ * @return the joined subtree
+ */
+static struct subtree join_subtrees(const struct rb_tree * tree, struct subtree left, struct rb_node * pivot, struct subtree right){
+  if(left.black_height == right.black_height){
+    pivot->parent = tree->nil;
+    pivot->left = left.root;
+    pivot->right = right.root;
+    pivot->red = false;
+    if(left.root != tree->nil){
+      left.root->parent = pivot;
+    }
+    if(right.root != tree->nil){
+      right.root->parent = pivot;
+    }
+    update_node(tree, pivot);
+    struct subtree joined = {pivot, left.black_height + 1};
+    return joined;
+  }
+
+  // attach the pivot as a red node to the spine of the higher subtree, next to a black node of equal black height,
+  // and let the insert fixup restore the colors
+  bool left_higher = left.black_height > right.black_height;
+  struct subtree higher = left_higher ? left : right;
+  struct subtree lower = left_higher ? right : left;
+  struct rb_node * parent = tree->nil;
+  struct rb_node * node = higher.root;
+  size_t height = higher.black_height;
+  while(node->red || height > lower.black_height){
+    if(!node->red){
+      --height;
+    }
+    parent = node;
+    node = left_higher ? node->right : node->left;
+  }
+
+  pivot->parent = parent;
+  pivot->red = true;
+  if(left_higher){
+    pivot->left = node;
+    pivot->right = right.root;
+    parent->right = pivot;
+  }else{
+    pivot->left = left.root;
+    pivot->right = node;
+    parent->left = pivot;
+  }
+  if(pivot->left != tree->nil){
+    pivot->left->parent = pivot;
+  }
+  if(pivot->right != tree->nil){
+    pivot->right->parent = pivot;
+  }
+  update_node(tree, pivot);
+  grow_ancestors(tree, parent, lower.root->size + 1);
+
+  struct rb_node * root = higher.root;
+  bool grown = fix_after_insert(tree, &root, pivot);
+  struct subtree joined = {root, higher.black_height + (grown ? 1 : 0)};
+  return joined;
+}
+
+/**
+ * Concatenates two subtrees, all values in left being smaller than the values in right
+ */
+static struct subtree concat_subtrees(const struct rb_tree * tree, struct subtree left, struct subtree right){
+  if(left.root == tree->nil){
+    return right;
+  }else if(right.root == tree->nil){
+    return left;
+  }
+
+  struct rb_node * root = left.root;
+  struct rb_node * max = get_max(tree, root);
+  bool shrank;
+  unlink_node(tree, &root, max, &shrank);
+  left = make_subtree(tree, root, left.black_height - (shrank ? 1 : 0));
+  return join_subtrees(tree, left, max, right);
+}
+
+/**
+ * Splits a subtree into the values smaller and the values greater than a value
+ * Costs O(log n)
+ * @param subtree the subtree
+ * @param value the value to split around
+ * @param left set to the subtree of smaller values
+ * @param right set to the subtree of greater values
+ * @return the detached node holding the value or NIL if the value is not in the subtree
+ */
+static struct rb_node * split_subtree(const struct rb_tree * tree, struct subtree subtree, void * value, struct subtree * left, struct subtree * right){
+  struct rb_node * node = subtree.root;
+  if(node == tree->nil){
+    *left = subtree;
+    *right = subtree;
+    return tree->nil;
+  }
+
+  struct subtree node_left = make_subtree(tree, node->left, subtree.black_height - 1);
+  struct subtree node_right = make_subtree(tree, node->right, subtree.black_height - 1);
+  int cmp = compare(tree, value, get_node_value(tree, node));
+  if(cmp == 0){
+    *left = node_left;
+    *right = node_right;
+    return node;
+  }else if(cmp < 0){
+    struct subtree middle;
+    struct rb_node * found = split_subtree(tree, node_left, value, left, &middle);
+    *right = join_subtrees(tree, middle, node, node_right);
+    return found;
+  }else{
+    struct subtree middle;
+    struct rb_node * found = split_subtree(tree, node_right, value, &middle, right);
+    *left = join_subtrees(tree, node_left, node, middle);
+    return found;
+  }
+}
+
+/*
+ * Set operations
+ */
+
+/**
+ * The state of a set operation or of one branch of its recursion
+ */
+struct set_operation{
+
+  /**
+   * The tree receiving the result
+   */
+  struct rb_tree * tree;
+
+  /**
+   * The filter deciding which values are kept, only used by filters
+   */
+  rb_filter_f keep;
+
+  /**
+   * The roots of the removed subtrees, linked through their parents, if the operation runs in parallel
+   * Freeing is deferred as neither pools nor free functions need to be thread safe
+   */
+  struct rb_node * garbage;
+
+  /**
+   * The last removed subtree in the list
+   */
+  struct rb_node * garbage_tail;
+};
+
+/**
+ * A recursive step of a set operation, combining two subtrees
+ */
+typedef struct subtree (*set_f)(struct set_operation *, struct subtree, struct subtree);
+
+/**
+ * Initializes the state of a set operation with an empty garbage list
+ */
+static void init_set_operation(struct set_operation * operation, struct rb_tree * tree, rb_filter_f keep){
+  operation->tree = tree;
+  operation->keep = keep;
+  operation->garbage = tree->nil;
+  operation->garbage_tail = tree->nil;
+}
+
+/**
+ * Removes a detached subtree, freeing it right away unless the operation runs in parallel
+ */
+static void discard_subtree(struct set_operation * operation, struct rb_node * root){
+  struct rb_tree * tree = operation->tree;
+  if(root == tree->nil){
+    return;
+  }else if(tree->tasks == NULL){
+    free_subtree(tree, root);
+  }else if(operation->garbage == tree->nil){
+    operation->garbage = root;
+    operation->garbage_tail = root;
+  }else{
+    operation->garbage_tail->parent = root;
+    operation->garbage_tail = root;
+  }
+}
+
+/**
+ * Removes a single node whose children have been moved elsewhere
+ */
+static void discard_node(struct set_operation * operation, struct rb_node * node){
+  node->parent = operation->tree->nil;
+  node->left = operation->tree->nil;
+  node->right = operation->tree->nil;
+  discard_subtree(operation, node);
+}
+
+/**
+ * Moves the removed subtrees of a branch to the operation it was forked from
+ */
+static void collect_garbage(struct set_operation * operation, struct set_operation * branch){
+  struct rb_node * nil = operation->tree->nil;
+  if(branch->garbage == nil){
+    return;
+  }else if(operation->garbage == nil){
+    operation->garbage = branch->garbage;
+  }else{
+    operation->garbage_tail->parent = branch->garbage;
+  }
+  operation->garbage_tail = branch->garbage_tail;
+}
+
+/**
+ * Frees all removed subtrees of an operation
+ */
+static void free_garbage(struct set_operation * operation){
+  struct rb_tree * tree = operation->tree;
+  struct rb_node * root = operation->garbage;
+  while(root != tree->nil){
+    struct rb_node * next = root->parent;
+    root->parent = tree->nil;
+    free_subtree(tree, root);
+    root = next;
+  }
+  operation->garbage = tree->nil;
+  operation->garbage_tail = tree->nil;
+}
+
+/**
+ * A branch of a set operation that may run on another thread
+ */
+struct set_task{
+
+  /**
+   * The state of the branch
+   */
+  struct set_operation operation;
+
+  /**
+   * The step to run
+   */
+  set_f step;
+
+  /**
+   * The first argument of the step
+   */
+  struct subtree first;
+
+  /**
+   * The second argument of the step
+   */
+  struct subtree second;
+
+  /**
+   * The result of the step
+   */
+  struct subtree result;
+};
+
+static void run_set_task(void * data){
+  struct set_task * task = (struct set_task *)data;
+  task->result = (*task->step)(&task->operation, task->first, task->second);
+}
+
+/**
+ * Runs a step on the left and right parts of its arguments, in parallel if the tree has a task pool and enough nodes are involved
+ * @param size the number of nodes involved
+ */
+static void recurse(struct set_operation * operation, set_f step, size_t size,
+		    struct subtree first_left, struct subtree second_left, struct subtree * left,
+		    struct subtree first_right, struct subtree second_right, struct subtree * right){
+  struct rb_tree * tree = operation->tree;
+  if(tree->tasks == NULL || size < PARALLEL_CUTOFF){
+    *left = (*step)(operation, first_left, second_left);
+    *right = (*step)(operation, first_right, second_right);
+    return;
+  }
+
+  struct set_task left_task = {.step = step, .first = first_left, .second = second_left};
+  struct set_task right_task = {.step = step, .first = first_right, .second = second_right};
+  init_set_operation(&left_task.operation, tree, operation->keep);
+  init_set_operation(&right_task.operation, tree, operation->keep);
+  task_pool_fork_join(tree->tasks, &run_set_task, &left_task, &run_set_task, &right_task);
+  collect_garbage(operation, &left_task.operation);
+  collect_garbage(operation, &right_task.operation);
+  *left = left_task.result;
+  *right = right_task.result;
+}
+
+/**
+ * Runs a set operation on the task pool of the tree, if any, and frees the removed nodes afterwards
+ */
+static struct subtree run_set_operation(struct rb_tree * tree, rb_filter_f keep, set_f step, struct subtree first, struct subtree second){
+  struct set_task task = {.step = step, .first = first, .second = second};
+  init_set_operation(&task.operation, tree, keep);
+  if(tree->tasks == NULL){
+    run_set_task(&task);
+  }else{
+    task_pool_run(tree->tasks, &run_set_task, &task);
+    free_garbage(&task.operation);
+  }
+  return task.result;
+}
+
+/**
+ * Computes the union of two subtrees, reusing their nodes
+ * Values of first replace equal values of second
+ */
+static struct subtree union_subtrees(struct set_operation * operation, struct subtree first, struct subtree second){
+  const struct rb_tree * tree = operation->tree;
+  if(first.root == tree->nil){
+    return second;
+  }else if(second.root == tree->nil){
+    return first;
+  }
+
+  size_t size = first.root->size + second.root->size;
+  struct rb_node * pivot = first.root;
+  struct subtree first_left = make_subtree(tree, pivot->left, first.black_height - 1);
+  struct subtree first_right = make_subtree(tree, pivot->right, first.black_height - 1);
+  struct subtree second_left;
+  struct subtree second_right;
+  struct rb_node * found = split_subtree(tree, second, get_node_value(tree, pivot), &second_left, &second_right);
+  if(found != tree->nil){
+    discard_node(operation, found);
+  }
+  struct subtree left;
+  struct subtree right;
+  recurse(operation, &union_subtrees, size, first_left, second_left, &left, first_right, second_right, &right);
+  return join_subtrees(tree, left, pivot, right);
+}
+
+/**
+ * Computes the intersection of two subtrees, keeping the nodes of first and freeing all others
+ */
+static struct subtree intersect_subtrees(struct set_operation * operation, struct subtree first, struct subtree second){
+  const struct rb_tree * tree = operation->tree;
+  if(first.root == tree->nil || second.root == tree->nil){
+    discard_subtree(operation, first.root);
+    discard_subtree(operation, second.root);
+    struct subtree empty = {tree->nil, 0};
+    return empty;
+  }
+
+  size_t size = first.root->size + second.root->size;
+  struct rb_node * pivot = first.root;
+  struct subtree first_left = make_subtree(tree, pivot->left, first.black_height - 1);
+  struct subtree first_right = make_subtree(tree, pivot->right, first.black_height - 1);
+  struct subtree second_left;
+  struct subtree second_right;
+  struct rb_node * found = split_subtree(tree, second, get_node_value(tree, pivot), &second_left, &second_right);
+  struct subtree left;
+  struct subtree right;
+  recurse(operation, &intersect_subtrees, size, first_left, second_left, &left, first_right, second_right, &right);
+  if(found != tree->nil){
+    discard_node(operation, found);
+    return join_subtrees(tree, left, pivot, right);
+  }else{
+    discard_node(operation, pivot);
+    return concat_subtrees(tree, left, right);
+  }
+}
+
+/**
+ * Computes the difference of two subtrees, keeping the nodes of first not in second and freeing all others
+ */
+static struct subtree subtract_subtrees(struct set_operation * operation, struct subtree first, struct subtree second){
+  const struct rb_tree * tree = operation->tree;
+  if(first.root == tree->nil || second.root == tree->nil){
+    discard_subtree(operation, second.root);
+    return first;
+  }
+
+  size_t size = first.root->size + second.root->size;
+  struct rb_node * pivot = second.root;
+  struct subtree second_left = make_subtree(tree, pivot->left, second.black_height - 1);
+  struct subtree second_right = make_subtree(tree, pivot->right, second.black_height - 1);
+  struct subtree first_left;
+  struct subtree first_right;
+  struct rb_node * found = split_subtree(tree, first, get_node_value(tree, pivot), &first_left, &first_right);
+  if(found != tree->nil){
+    discard_node(operation, found);
+  }
+  discard_node(operation, pivot);
+  struct subtree left;
+  struct subtree right;
+  recurse(operation, &subtract_subtrees, size, first_left, second_left, &left, first_right, second_right, &right);
+  return concat_subtrees(tree, left, right);
+}
+
+/**
+ * Keeps the values of first accepted by the filter of the operation, second is always empty
+ */
+static struct subtree filter_subtrees(struct set_operation * operation, struct subtree first, struct subtree second){
+  const struct rb_tree * tree = operation->tree;
+  if(first.root == tree->nil){
+    return first;
+  }
+
+  struct rb_node * pivot = first.root;
+  bool keep = (*operation->keep)(operation->tree, get_node_value(tree, pivot));
+  struct subtree first_left = make_subtree(tree, pivot->left, first.black_height - 1);
+  struct subtree first_right = make_subtree(tree, pivot->right, first.black_height - 1);
+  struct subtree left;
+  struct subtree right;
+  recurse(operation, &filter_subtrees, pivot->size, first_left, second, &left, first_right, second, &right);
+  if(keep){
+    return join_subtrees(tree, left, pivot, right);
+  }else{
+    discard_node(operation, pivot);
+    return concat_subtrees(tree, left, right);
+  }
+}
+
+#ifndef NDEBUG
+/**
+ * Checks whether nodes can move between two trees
+ */
+static bool is_compatible(const struct rb_tree * first, const struct rb_tree * second){
+  return first->cmp_value == second->cmp_value
+    && first->node_size == second->node_size
+    && first->value_size == second->value_size
+    && first->aggregate_size == second->aggregate_size
+    && first->lift == second->lift
+    && first->combine == second->combine
+    && first->pool == second->pool
+    && first->allocator == second->allocator;
+}
+#endif
+
+void rb_tree_join(struct rb_tree * left, void * pivot, struct rb_tree * right){
+  assert(left != NULL);
+  assert(right != NULL);
+  assert(left != right);
+  assert(is_compatible(left, right));
+
+  struct rb_node * node = create_node(left, pivot);
+  assert(left->root == left->nil || (*left->cmp_value)(left, get_node_value(left, get_max(left, left->root)), get_node_value(left, node)) < 0);
+  assert(right->root == right->nil || (*left->cmp_value)(left, get_node_value(left, node), get_node_value(left, get_min(right, right->root))) < 0);
+
+  struct subtree left_subtree = take_subtree(left);
+  struct subtree right_subtree = take_subtree(right);
+  put_subtree(left, join_subtrees(left, left_subtree, node, right_subtree));
+}
+
+void rb_tree_split(struct rb_tree * tree, void * value, struct rb_tree * right){
+  assert(tree != NULL);
+  assert(right != NULL);
+  assert(tree != right);
+  assert(right->root == right->nil);
+  assert(is_compatible(tree, right));
+
+  struct subtree left_subtree;
+  struct subtree right_subtree;
+  struct rb_node * found = split_subtree(tree, take_subtree(tree), value, &left_subtree, &right_subtree);
+  if(found != tree->nil){
+    struct subtree empty = {tree->nil, 0};
+    right_subtree = join_subtrees(tree, empty, found, right_subtree);
+  }
+  put_subtree(tree, left_subtree);
+  put_subtree(right, right_subtree);
+}
+
+void rb_tree_union(struct rb_tree * tree, struct rb_tree * other){
+  assert(tree != NULL);
+  assert(other != NULL);
+  assert(tree != other);
+  assert(is_compatible(tree, other));
+
+  struct subtree first = take_subtree(other);
+  struct subtree second = take_subtree(tree);
+  put_subtree(tree, run_set_operation(tree, NULL, &union_subtrees, first, second));
+}
+
+void rb_tree_intersection(struct rb_tree * tree, struct rb_tree * other){
+  assert(tree != NULL);
+  assert(other != NULL);
+  assert(tree != other);
+  assert(is_compatible(tree, other));
+
+  struct subtree first = take_subtree(tree);
+  struct subtree second = take_subtree(other);
+  put_subtree(tree, run_set_operation(tree, NULL, &intersect_subtrees, first, second));
+}
+
+void rb_tree_difference(struct rb_tree * tree, struct rb_tree * other){
+  assert(tree != NULL);
+  assert(other != NULL);
+  assert(tree != other);
+  assert(is_compatible(tree, other));
+
+  struct subtree first = take_subtree(tree);
+  struct subtree second = take_subtree(other);
+  put_subtree(tree, run_set_operation(tree, NULL, &subtract_subtrees, first, second));
+}
+
+void rb_tree_filter(struct rb_tree * tree, rb_filter_f keep){
+  assert(tree != NULL);
+  assert(keep != NULL);
+
+  struct subtree empty = {tree->nil, 0};
+  put_subtree(tree, run_set_operation(tree, keep, &filter_subtrees, take_subtree(tree), empty));
+}
+
 /*
  * Freeing
  */
@@ -569,23 +2219,179 @@ bool rb_tree_find_and_delete(struct rb_tree * tree, void * value){
 void rb_tree_free(struct rb_tree * tree){
   assert(tree != NULL);
 
-  struct rb_node * pos = tree->root;
-  struct rb_node * next;
-  
-  while(pos != tree->nil){
-    if(pos->left != tree->nil){
-      next = pos->left;
-      pos->left = tree->nil;
-    }else if(pos->right != tree->nil){
-      next = pos->right;
-      pos->right = tree->nil;
-    }else{
-      next = pos->parent;
-      (*tree->free_value)(tree, pos->value);
-      free(pos);
+  if(!tree->owns_pool || tree->free_value != default_free_value){
+    free_subtree(tree, tree->root);
+  }
+  // otherwise the nodes are released along with the pool
+
+  if(tree->owns_pool){
+    memory_pool_destroy(tree->pool);
+    free(tree->pool);
+  }
+}
+
+bool rb_tree_free_incremental(struct rb_tree * tree, size_t budget){
+  assert(tree != NULL);
+  assert(budget > 0);
+
+  // the root is the node the previous call stopped at, the tree is not searchable anymore
+  tree->finger = tree->nil;
+  if(!tree->owns_pool || tree->free_value != default_free_value){
+    tree->root = free_nodes(tree, tree->root, budget);
+  }else{
+    tree->root = tree->nil;
+  }
+  if(tree->root != tree->nil){
+    return false;
+  }
+
+  if(tree->owns_pool){
+    memory_pool_destroy(tree->pool);
+    free(tree->pool);
+    tree->pool = NULL;
+    tree->owns_pool = false;
+  }
+  return true;
+}
+
+/*
+ * Background reclamation
+ */
+
+/**
+ * A tree waiting to be freed by a reclaimer
+ */
+struct rb_tree_reclaim_job{
+
+  /**
+   * The next job in submission order
+   */
+  struct rb_tree_reclaim_job * next;
+
+  /**
+   * The tree
+   */
+  struct rb_tree * tree;
+
+  /**
+   * The heap block holding the tree, released once the tree is freed
+   */
+  void * block;
+};
+
+/**
+ * Frees the submitted trees in submission order, a step of budget nodes at a time
+ */
+static void * run_reclaimer(void * data){
+  struct rb_tree_reclaimer * reclaimer = (struct rb_tree_reclaimer *)data;
+  pthread_mutex_lock(&reclaimer->lock);
+  for(;;){
+    while(reclaimer->jobs == NULL && !reclaimer->stopping){
+      pthread_cond_wait(&reclaimer->work, &reclaimer->lock);
+    }
+    struct rb_tree_reclaim_job * job = reclaimer->jobs;
+    if(job == NULL){
+      break;
+    }
+    reclaimer->jobs = job->next;
+    if(reclaimer->jobs == NULL){
+      reclaimer->last = NULL;
+    }
+    pthread_mutex_unlock(&reclaimer->lock);
+
+    while(!rb_tree_free_incremental(job->tree, reclaimer->budget)){
+      // lets the threads sharing the processor or the allocator in between steps
+      sched_yield();
+    }
+    free(job->block);
+    free(job);
+
+    pthread_mutex_lock(&reclaimer->lock);
+    if(--reclaimer->pending == 0){
+      pthread_cond_broadcast(&reclaimer->idle);
     }
-    pos = next;
   }
-  free(tree->nil);
+  pthread_mutex_unlock(&reclaimer->lock);
+  return NULL;
+}
+
+void rb_tree_reclaimer_init(struct rb_tree_reclaimer * reclaimer, size_t budget){
+  assert(reclaimer != NULL);
+  assert(budget > 0);
+
+  reclaimer->budget = budget;
+  reclaimer->jobs = NULL;
+  reclaimer->last = NULL;
+  reclaimer->pending = 0;
+  reclaimer->stopping = false;
+  pthread_mutex_init(&reclaimer->lock, NULL);
+  pthread_cond_init(&reclaimer->work, NULL);
+  pthread_cond_init(&reclaimer->idle, NULL);
+  if(pthread_create(&reclaimer->thread, NULL, &run_reclaimer, reclaimer) != 0){
+    fputs("Failed to start the reclamation thread\n", stderr);
+    exit(-1);
+  }
+}
+
+void rb_tree_reclaimer_submit_block(struct rb_tree_reclaimer * reclaimer, struct rb_tree * tree, void * block){
+  assert(reclaimer != NULL);
+  assert(tree != NULL);
+  assert(block != NULL);
+  // a shared pool would be used by two threads at once
+  assert(tree->pool == NULL || tree->owns_pool);
+
+  struct rb_tree_reclaim_job * job = malloc_checked(sizeof(struct rb_tree_reclaim_job));
+  job->next = NULL;
+  job->tree = tree;
+  job->block = block;
+
+  pthread_mutex_lock(&reclaimer->lock);
+  assert(!reclaimer->stopping);
+  if(reclaimer->last == NULL){
+    reclaimer->jobs = job;
+  }else{
+    reclaimer->last->next = job;
+  }
+  reclaimer->last = job;
+  ++reclaimer->pending;
+  pthread_cond_signal(&reclaimer->work);
+  pthread_mutex_unlock(&reclaimer->lock);
+}
+
+void rb_tree_reclaimer_submit(struct rb_tree_reclaimer * reclaimer, struct rb_tree * tree){
+  assert(tree != NULL);
+
+  struct rb_tree * detached = malloc_checked(sizeof(struct rb_tree));
+  *detached = *tree;
+  // the nodes and the pool now belong to the detached copy
+  tree->root = tree->nil;
+  tree->finger = tree->nil;
+  tree->pool = NULL;
+  tree->owns_pool = false;
+  rb_tree_reclaimer_submit_block(reclaimer, detached, detached);
+}
+
+void rb_tree_reclaimer_drain(struct rb_tree_reclaimer * reclaimer){
+  assert(reclaimer != NULL);
+
+  pthread_mutex_lock(&reclaimer->lock);
+  while(reclaimer->pending > 0){
+    pthread_cond_wait(&reclaimer->idle, &reclaimer->lock);
+  }
+  pthread_mutex_unlock(&reclaimer->lock);
 }
 
+void rb_tree_reclaimer_destroy(struct rb_tree_reclaimer * reclaimer){
+  assert(reclaimer != NULL);
+
+  pthread_mutex_lock(&reclaimer->lock);
+  reclaimer->stopping = true;
+  pthread_cond_signal(&reclaimer->work);
+  pthread_mutex_unlock(&reclaimer->lock);
+  pthread_join(reclaimer->thread, NULL);
+  assert(reclaimer->pending == 0);
+
+  pthread_mutex_destroy(&reclaimer->lock);
+  pthread_cond_destroy(&reclaimer->work);
+  pthread_cond_destroy(&reclaimer->idle);
+}
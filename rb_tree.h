@@ -19,7 +19,15 @@
 #ifndef RB_TREE_H
 #define RB_TREE_H
 
+#include "memory.h"
+
+#include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
  * A simple implementation of a red black tree
@@ -33,6 +41,10 @@ struct rb_node;
 
 struct rb_tree;
 
+struct memory_pool;
+
+struct task_pool;
+
 /**
  * A function pointer type for the comparison function used
  * in the red black tree.
@@ -50,6 +62,154 @@ typedef int (*rb_cmp_f)(const struct rb_tree *, void *, void *);
  */
 typedef void (*rb_apply_f)(struct rb_tree *, void *);
 
+/**
+ * A function pointer type for a function producing a sequence of values
+ * Signature: void * fn(struct rb_tree *, void * iterator)
+ * Returns the next value in the sequence
+ */
+typedef void * (*rb_next_f)(struct rb_tree *, void *);
+
+/**
+ * A function pointer type for filters
+ * Signature: bool fn(struct rb_tree *, void * value)
+ * Returns true if the value should be kept
+ */
+typedef bool (*rb_filter_f)(struct rb_tree *, void *);
+
+/**
+ * A function pointer type for computing the aggregate of a single value
+ * Signature: void fn(const struct rb_tree *, void * aggregate, void * value)
+ * Sets the aggregate to the aggregate of the value
+ */
+typedef void (*rb_lift_f)(const struct rb_tree *, void * aggregate, void * value);
+
+/**
+ * A function pointer type for combining aggregates, which must be associative
+ * Signature: void fn(const struct rb_tree *, void * result, const void * first, const void * second)
+ * Sets result to the aggregate of the values of first followed by the values of second,
+ * result may be the same as first or second
+ */
+typedef void (*rb_combine_f)(const struct rb_tree *, void * result, const void * first, const void * second);
+
+/**
+ * The levels of invariant validation performed after each mutation
+ * A violation aborts the program
+ */
+enum rb_validation{
+
+  /**
+   * No validation
+   */
+  RB_VALIDATION_OFF,
+
+  /**
+   * Validates the nodes touched by rebalancing, O(log n) per mutation
+   */
+  RB_VALIDATION_LOCAL,
+
+  /**
+   * Validates the whole tree once every period mutations
+   */
+  RB_VALIDATION_SAMPLED,
+
+  /**
+   * Validates the whole tree after every mutation, O(n) per mutation
+   */
+  RB_VALIDATION_FULL
+};
+
+/**
+ * The number of buckets of the histogram of search path lengths, longer paths are counted in the last bucket
+ */
+#define RB_TREE_STATS_PATH_LENGTHS 64
+
+/**
+ * Counters of the work done by a tree, collected when the library is built with RB_TREE_STATS defined (configure --enable-stats)
+ * Without it the counters are not compiled in and always read as zero.
+ */
+struct rb_tree_stats{
+
+  /**
+   * The number of calls to the comparison function, excluding those made by validation
+   */
+  size_t comparisons;
+
+  /**
+   * The number of rotations, including those made by joins and set operations
+   */
+  size_t rotations;
+
+  /**
+   * The number of times an insert recolored a red uncle and moved up the tree
+   */
+  size_t insert_recolors;
+
+  /**
+   * The number of times an insert was fixed by a single rotation, with the new node an outer grandchild
+   */
+  size_t insert_single_rotations;
+
+  /**
+   * The number of times an insert was fixed by a double rotation, with the new node an inner grandchild
+   */
+  size_t insert_double_rotations;
+
+  /**
+   * The number of times a delete rotated a red sibling above the parent
+   */
+  size_t delete_sibling_rotations;
+
+  /**
+   * The number of times a delete recolored a black sibling with black children and moved up the tree
+   */
+  size_t delete_recolors;
+
+  /**
+   * The number of times a delete was fixed by a single rotation, with the far child of the sibling red
+   */
+  size_t delete_single_rotations;
+
+  /**
+   * The number of times a delete was fixed by a double rotation, with only the near child of the sibling red
+   */
+  size_t delete_double_rotations;
+
+  /**
+   * The number of color changes made by rebalancing
+   */
+  size_t recolorings;
+
+  /**
+   * The number of nodes allocated
+   */
+  size_t allocations;
+
+  /**
+   * The number of nodes freed
+   */
+  size_t frees;
+
+  /**
+   * The number of descents from the root by finds, bounds, ranks and inserts
+   */
+  size_t searches;
+
+  /**
+   * The total number of nodes visited by the searches, divided by searches for the average depth
+   */
+  size_t total_path_length;
+
+  /**
+   * The number of nodes visited by the longest search
+   */
+  size_t max_path_length;
+
+  /**
+   * The number of searches by the number of nodes they visited
+   */
+  size_t path_lengths[RB_TREE_STATS_PATH_LENGTHS];
+};
+
 /**
  * A red black tree
  */
@@ -79,7 +239,93 @@ struct rb_tree{
    * Extra state for the tree
    */
   void * state;
-  
+
+  /**
+   * The pool the nodes are allocated from or NULL if nodes are allocated on the heap
+   */
+  struct memory_pool * pool;
+
+  /**
+   * Whether the pool is private to this tree and released along with it
+   */
+  bool owns_pool;
+
+  /**
+   * The allocator the nodes are allocated from if the tree has no pool
+   */
+  struct allocator * allocator;
+
+  /**
+   * The size of the values stored inline in the nodes or 0 if the nodes store value pointers
+   */
+  size_t value_size;
+
+  /**
+   * The allocation size of a node
+   */
+  size_t node_size;
+
+  /**
+   * The size of the aggregate stored in every node or 0 if the tree maintains no aggregates
+   */
+  size_t aggregate_size;
+
+  /**
+   * The offset of the aggregate in a node
+   */
+  size_t aggregate_offset;
+
+  /**
+   * The function computing the aggregate of a value or NULL
+   */
+  rb_lift_f lift;
+
+  /**
+   * The function combining aggregates or NULL
+   */
+  rb_combine_f combine;
+
+  /**
+   * The validation performed after each mutation
+   */
+  enum rb_validation validation;
+
+  /**
+   * The number of mutations between validations when sampling
+   */
+  size_t validation_period;
+
+  /**
+   * The number of mutations since the last sampled validation
+   */
+  size_t mutations;
+
+  /**
+   * The last inserted node, where the next insert is tried first, or NIL
+   */
+  struct rb_node * finger;
+
+  /**
+   * The number of inserts the finger is skipped for after its last miss
+   */
+  size_t finger_backoff;
+
+  /**
+   * The number of inserts left before the finger is tried again
+   */
+  size_t finger_skip;
+
+  /**
+   * The task pool parallel operations run on or NULL
+   */
+  struct task_pool * tasks;
+
+#ifdef RB_TREE_STATS
+  /**
+   * The counters of the tree, updated atomically since lookups and parallel operations may run on several threads
+   */
+  struct rb_tree_stats stats;
+#endif
 };
 
 /**
@@ -91,6 +337,109 @@ struct rb_tree{
  */
 void rb_tree_init(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_value, void * state);
 
+/**
+ * Initializes a red black tree that allocates its nodes from a memory pool
+ * If the tree owns its pool and does not free its values, rb_tree_free releases the nodes slab by slab
+ * without visiting them
+ * @param a pointer to the tree
+ * @param cmp_value a pointer to a comparison function
+ * @param free_value a pointer to a function to free the values or NULL if the values should not be freed
+ * @param free_state a pointer to state data used in the free function
+ * @param pool a pool that may be shared with other trees or NULL to create a pool private to this tree
+ */
+void rb_tree_init_pooled(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_value, void * state, struct memory_pool * pool);
+
+/**
+ * Initializes a red black tree that allocates its nodes from an allocator
+ * rb_tree_init uses libc_allocator
+ * @param a pointer to the tree
+ * @param cmp_value a pointer to a comparison function
+ * @param free_value a pointer to a function to free the values or NULL if the values should not be freed
+ * @param free_state a pointer to state data used in the free function
+ * @param allocator the allocator, which must outlive the tree and may be shared with other trees
+ */
+void rb_tree_init_allocator(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_value, void * state, struct allocator * allocator);
+
+/**
+ * Makes the tree store its values inside the nodes instead of storing value pointers
+ * Each value then costs a single allocation and comparisons read it without following a pointer.
+ * Values passed to the tree are pointers to value_size bytes that are copied into the node,
+ * values handed out by the tree are pointers into the node that remain valid until the node is deleted.
+ * Inline values are aligned like a pointer.
+ * Must be called on an empty tree
+ * @param tree the tree
+ * @param value_size the size of a value in bytes
+ */
+void rb_tree_set_inline_values(struct rb_tree * tree, size_t value_size);
+
+/**
+ * Makes the tree maintain in every node the aggregate of the values of its subtree, such as a sum, a minimum or a count
+ * The aggregates are kept up to date by inserts, deletes, rotations, joins and splits at the cost of a few combines per node
+ * whose subtree changes, and allow rb_tree_range_reduce to aggregate any range in logarithmic time.
+ * The functions run on the workers of the task pool of the tree during parallel set operations.
+ * Must be called on an empty tree
+ * @param tree the tree
+ * @param aggregate_size the size of an aggregate in bytes, aggregates are aligned like a pointer
+ * @param lift the function computing the aggregate of a value
+ * @param combine the associative function combining aggregates
+ */
+void rb_tree_set_aggregate(struct rb_tree * tree, size_t aggregate_size, rb_lift_f lift, rb_combine_f combine);
+
+/**
+ * Returns the aggregate of the values of the subtree rooted at a node
+ * @param tree a tree maintaining aggregates
+ * @param node the node, the root of the tree gives the aggregate of all values
+ * @return the aggregate, valid until the tree is modified
+ */
+const void * rb_tree_get_aggregate(const struct rb_tree * tree, struct rb_node * node);
+
+/**
+ * Recomputes the aggregates after the value of a node was changed in place, in logarithmic time
+ * The change must not affect the order of the value
+ * @param tree a tree maintaining aggregates
+ * @param node the node
+ */
+void rb_tree_update_aggregate(struct rb_tree * tree, struct rb_node * node);
+
+/**
+ * Sets the validation performed after each mutation of the tree
+ * Trees validate locally by default, or not at all if NDEBUG is defined
+ * @param tree the tree
+ * @param validation the validation level
+ * @param period the number of mutations between validations for RB_VALIDATION_SAMPLED, ignored otherwise
+ */
+void rb_tree_set_validation(struct rb_tree * tree, enum rb_validation validation, size_t period);
+
+/**
+ * Copies the counters of a tree
+ * @param tree the tree
+ * @param stats set to the counters, all zero unless RB_TREE_STATS is defined
+ */
+void rb_tree_get_stats(const struct rb_tree * tree, struct rb_tree_stats * stats);
+
+/**
+ * Sets all counters of a tree to zero
+ * @param tree the tree
+ */
+void rb_tree_reset_stats(struct rb_tree * tree);
+
+/**
+ * Checks all red black tree invariants: the colors, the black heights, the parent links and the order of the values
+ * @param tree the tree
+ * @return true if the tree is valid, false otherwise
+ */
+bool rb_tree_validate(const struct rb_tree * tree);
+
+/**
+ * Sets the task pool the tree runs parallel operations on
+ * With a task pool, rb_tree_apply_parallel, the set operations and rb_tree_filter recurse into large subtrees in parallel,
+ * so the comparison function and the function passed to them should be thread safe.
+ * Removed values are still freed on the calling thread, after the operation.
+ * @param tree the tree
+ * @param tasks the task pool or NULL to run all operations on the calling thread
+ */
+void rb_tree_set_task_pool(struct rb_tree * tree, struct task_pool * tasks);
+
 /**
  * Finds the node associated to the specified value in the tree
  * @param tree the tree
@@ -99,6 +448,33 @@ void rb_tree_init(struct rb_tree * tree, rb_cmp_f cmp_value, rb_apply_f free_val
  */
 struct rb_node * rb_tree_find(const struct rb_tree * tree, void * value);
 
+/**
+ * Finds the nodes associated to many values at once
+ * The searches advance level by level in groups, prefetching the next node of every search before comparing against any of them,
+ * so the cache misses of a group overlap instead of stalling one after another
+ * @param tree the tree
+ * @param values an array of count values to find
+ * @param count the number of values
+ * @param found an array of count nodes, set to the node associated to values[i] or NULL at found[i]
+ */
+void rb_tree_find_batch(const struct rb_tree * tree, void ** values, size_t count, struct rb_node ** found);
+
+/**
+ * Finds the first node with a value not smaller than the specified value
+ * @param tree the tree
+ * @param value the value, which need not be in the tree
+ * @return the node or NULL if all values are smaller
+ */
+struct rb_node * rb_tree_lower_bound(const struct rb_tree * tree, void * value);
+
+/**
+ * Finds the first node with a value greater than the specified value
+ * @param tree the tree
+ * @param value the value, which need not be in the tree
+ * @return the node or NULL if no value is greater
+ */
+struct rb_node * rb_tree_upper_bound(const struct rb_tree * tree, void * value);
+
 /**
  * Returns the first in the tree, or NULL if the tree is empty
  * @param tree the tree
@@ -114,7 +490,7 @@ struct rb_node * rb_tree_get_begin(const struct rb_tree * tree);
 struct rb_node * rb_tree_get_end(const struct rb_tree * tree);
 
 /**
- * Returns the next node in the tree, or NULL if the tree is empty
+ * Returns the next node in the tree, or NULL if node is the last node
  * @param tree the tree
  * @param node the current node
  * @return a pointer to the node
@@ -123,7 +499,7 @@ struct rb_node * rb_tree_get_next(const struct rb_tree * tree, struct rb_node *
 
 
 /**
- * Returns the previous node in the tree, or NULL if the tree is empty
+ * Returns the previous node in the tree, or NULL if node is the first node
  * @param tree the tree
  * @param node the current node
  * @return a pointer to the node
@@ -138,6 +514,14 @@ struct rb_node * rb_tree_get_previous(const struct rb_tree * tree, struct rb_nod
  */
 void * rb_tree_get_value(const struct rb_tree * tree, struct rb_node * node);
 
+/**
+ * Returns the node holding a value of a tree that stores its values inline
+ * @param tree the tree
+ * @param value a value handed out by the tree
+ * @return the node
+ */
+struct rb_node * rb_tree_get_node(const struct rb_tree * tree, void * value);
+
 /**
  * Checks whether the tree is empty
  * @param tree the tree
@@ -145,6 +529,49 @@ void * rb_tree_get_value(const struct rb_tree * tree, struct rb_node * node);
  */
 bool rb_tree_is_empty(const struct rb_tree * tree);
 
+/**
+ * Returns the number of values in the tree in constant time
+ * @param tree the tree
+ * @return the number of values
+ */
+size_t rb_tree_size(const struct rb_tree * tree);
+
+/**
+ * Returns the node holding the value at a position in the order of the tree in logarithmic time
+ * @param tree the tree
+ * @param index the zero based position of the value
+ * @return the node or NULL if index is not smaller than the size of the tree
+ */
+struct rb_node * rb_tree_select(const struct rb_tree * tree, size_t index);
+
+/**
+ * Returns the number of values in the tree smaller than a value in logarithmic time
+ * If the value is in the tree, this is its zero based position
+ * @param tree the tree
+ * @param value the value, which need not be in the tree
+ * @return the number of smaller values
+ */
+size_t rb_tree_rank(const struct rb_tree * tree, void * value);
+
+/**
+ * Returns the number of values in the range [low, high) in logarithmic time
+ * @param tree the tree
+ * @param low the inclusive lower bound
+ * @param high the exclusive upper bound
+ * @return the number of values in the range
+ */
+size_t rb_tree_count_range(const struct rb_tree * tree, void * low, void * high);
+
+/**
+ * Aggregates the values in the range [low, high) in logarithmic time
+ * @param tree a tree maintaining aggregates
+ * @param low the inclusive lower bound
+ * @param high the exclusive upper bound
+ * @param result set to the aggregate of the values in order, untouched if the range is empty
+ * @return true if the range holds any value
+ */
+bool rb_tree_range_reduce(const struct rb_tree * tree, void * low, void * high, void * result);
+
 /**
  * Applies the function to all values in the red black tree in order
  * @param tree the tree
@@ -152,14 +579,64 @@ bool rb_tree_is_empty(const struct rb_tree * tree);
  */
 void rb_tree_apply(struct rb_tree * tree, rb_apply_f apply);
 
+/**
+ * Applies the function to all values in the red black tree in no particular order,
+ * in parallel on the task pool of the tree if it has one
+ * @param tree the tree
+ * @param apply a thread safe function to apply to all values
+ */
+void rb_tree_apply_parallel(struct rb_tree * tree, rb_apply_f apply);
+
 /**
  * Inserts a value in the red black tree
+ * The insert is first tried next to the previously inserted value, so sequential inserts take a constant number of comparisons
  * @param tree the tree
  * @param value the value to insert
  * @return true if the value replaces an existing value, false otherwise
  */
 bool rb_tree_insert(struct rb_tree * tree, void * value);
 
+/**
+ * Inserts a value in the red black tree unless it holds an equal value, with a single descent
+ * The node is only allocated if the value is inserted, an equal value is neither replaced nor freed
+ * @param tree the tree
+ * @param value the value to insert
+ * @param inserted set to true if the value was inserted, false if the tree already held an equal value
+ * @return the node holding the value or the equal value
+ */
+struct rb_node * rb_tree_find_or_insert(struct rb_tree * tree, void * value, bool * inserted);
+
+/**
+ * Inserts a value in the red black tree, using a node next to the value as a hint
+ * If the value belongs directly before or after the hint, or replaces it, the insert takes at most two comparisons,
+ * otherwise the value is inserted from the root
+ * @param tree the tree
+ * @param hint the node the value belongs next to or NULL if the value belongs after the last node
+ * @param value the value to insert
+ * @return the node holding the value
+ */
+struct rb_node * rb_tree_insert_hint(struct rb_tree * tree, struct rb_node * hint, void * value);
+
+/**
+ * Builds the tree from an array of values in strictly ascending order in linear time
+ * The nodes are created in order, so trees with a pool get contiguous nodes
+ * Must be called on an empty tree
+ * @param tree the tree
+ * @param values an array of count value pointers or, if the tree stores its values inline, of count values
+ * @param count the number of values
+ */
+void rb_tree_build_sorted(struct rb_tree * tree, void * values, size_t count);
+
+/**
+ * Builds the tree from a sequence of values in strictly ascending order in linear time
+ * Must be called on an empty tree
+ * @param tree the tree
+ * @param count the number of values in the sequence
+ * @param next a function returning the values of the sequence in order, called exactly count times
+ * @param iterator the state passed to the next function
+ */
+void rb_tree_build_sorted_from(struct rb_tree * tree, size_t count, rb_next_f next, void * iterator);
+
 /**
  * Deletes a node from the tree
  * @param tree the tree
@@ -175,6 +652,61 @@ void rb_tree_delete(struct rb_tree * tree, struct rb_node * node);
  */
 bool rb_tree_find_and_delete(struct rb_tree * tree, void * value);
 
+/**
+ * Joins two trees around a pivot value in O(log n)
+ * All values in left should be smaller and all values in right greater than the pivot.
+ * The nodes of right are moved to left, leaving right empty.
+ * Both trees should have the same comparison function, value layout and aggregates, and share their allocation:
+ * both allocate from the heap or from the same shared pool
+ * @param left the left tree, receiving the result
+ * @param pivot the pivot value
+ * @param right the right tree
+ */
+void rb_tree_join(struct rb_tree * left, void * pivot, struct rb_tree * right);
+
+/**
+ * Splits a tree around a value in O(log n)
+ * The values smaller than the value stay in the tree, the other values are moved to right.
+ * The trees should be compatible as for rb_tree_join
+ * @param tree the tree to split
+ * @param value the value to split around, which need not be in the tree
+ * @param right an empty tree, receiving the values not smaller than the value
+ */
+void rb_tree_split(struct rb_tree * tree, void * value, struct rb_tree * right);
+
+/**
+ * Moves all values of other to the tree, reusing the nodes of both trees
+ * Values of other replace equal values of the tree, which are freed.
+ * For trees of sizes m <= n, this costs O(m log(n / m + 1)).
+ * The trees should be compatible as for rb_tree_join
+ * @param tree the tree, receiving the union
+ * @param other the other tree, left empty
+ */
+void rb_tree_union(struct rb_tree * tree, struct rb_tree * other);
+
+/**
+ * Keeps only the values of the tree that are also in other, freeing all other values of both trees
+ * The trees should be compatible as for rb_tree_join
+ * @param tree the tree, receiving the intersection
+ * @param other the other tree, left empty
+ */
+void rb_tree_intersection(struct rb_tree * tree, struct rb_tree * other);
+
+/**
+ * Removes the values of other from the tree, freeing the removed values and all values of other
+ * The trees should be compatible as for rb_tree_join
+ * @param tree the tree, receiving the difference
+ * @param other the other tree, left empty
+ */
+void rb_tree_difference(struct rb_tree * tree, struct rb_tree * other);
+
+/**
+ * Removes and frees the values of the tree rejected by a filter in O(n), reusing the nodes of the kept values
+ * @param tree the tree
+ * @param keep the filter, called once for every value
+ */
+void rb_tree_filter(struct rb_tree * tree, rb_filter_f keep);
+
 /**
  * Frees all data associated to the red black tree
  * Does not free the tree struct itself
@@ -182,4 +714,714 @@ bool rb_tree_find_and_delete(struct rb_tree * tree, void * value);
  */
 void rb_tree_free(struct rb_tree * tree);
 
+/**
+ * Frees at most budget nodes and their values of the red black tree, so a large tree can be freed
+ * in steps interleaved with other work
+ * Once called, the tree may only be passed to rb_tree_free_incremental or rb_tree_free until it is freed
+ * @param tree a pointer to a tree
+ * @param budget the largest number of nodes to free, at least 1
+ * @return true once all data of the tree is freed, after which the tree is empty
+ */
+bool rb_tree_free_incremental(struct rb_tree * tree, size_t budget);
+
+/*
+ * Background reclamation
+ */
+
+struct rb_tree_reclaim_job;
+
+/**
+ * A thread freeing the trees handed to it, so dropping a large tree does not stall the thread owning it
+ * The free functions of the submitted trees are called on the reclamation thread
+ * and their allocators must be safe to use from it.
+ */
+struct rb_tree_reclaimer{
+
+  /**
+   * The number of nodes freed per step, the thread yields between steps
+   */
+  size_t budget;
+
+  /**
+   * The trees waiting to be freed, oldest first
+   */
+  struct rb_tree_reclaim_job * jobs;
+
+  /**
+   * The newest waiting tree or NULL
+   */
+  struct rb_tree_reclaim_job * last;
+
+  /**
+   * The number of trees submitted and not freed yet
+   */
+  size_t pending;
+
+  /**
+   * Whether the reclaimer is being destroyed
+   */
+  bool stopping;
+
+  pthread_mutex_t lock;
+
+  /**
+   * Signaled when a tree is submitted or the reclaimer is destroyed
+   */
+  pthread_cond_t work;
+
+  /**
+   * Signaled when no tree is pending anymore
+   */
+  pthread_cond_t idle;
+
+  pthread_t thread;
+};
+
+/**
+ * Starts a reclamation thread
+ * @param reclaimer the reclaimer
+ * @param budget the number of nodes freed per step, at least 1
+ */
+void rb_tree_reclaimer_init(struct rb_tree_reclaimer * reclaimer, size_t budget);
+
+/**
+ * Hands the nodes of a tree over to the reclaimer in constant time, leaving the tree empty
+ * The tree should not allocate from a pool shared with other trees
+ * @param reclaimer the reclaimer
+ * @param tree the tree, which may be used or freed with rb_tree_free again right away
+ */
+void rb_tree_reclaimer_submit(struct rb_tree_reclaimer * reclaimer, struct rb_tree * tree);
+
+/**
+ * Hands a tree stored in a heap block over to the reclaimer, which frees the tree and then releases the block with free
+ * Allows the free function to reach a structure embedding the tree through its state
+ * @param reclaimer the reclaimer
+ * @param tree the tree, within or referenced from the block, not to be used by the caller anymore
+ * @param block the block
+ */
+void rb_tree_reclaimer_submit_block(struct rb_tree_reclaimer * reclaimer, struct rb_tree * tree, void * block);
+
+/**
+ * Waits until all trees submitted so far are freed
+ * @param reclaimer the reclaimer
+ */
+void rb_tree_reclaimer_drain(struct rb_tree_reclaimer * reclaimer);
+
+/**
+ * Frees all pending trees and stops the reclamation thread
+ * @param reclaimer the reclaimer
+ */
+void rb_tree_reclaimer_destroy(struct rb_tree_reclaimer * reclaimer);
+
+/*
+ * Type specialized trees
+ */
+
+/**
+ * Compares two numbers of any arithmetic type, for use as the comparison of a generated tree
+ */
+#define RB_TREE_CMP_NUMBER(first, second) (((first) > (second)) - ((first) < (second)))
+
+/**
+ * Compares two null terminated strings, for use as the comparison of a generated tree
+ */
+#define RB_TREE_CMP_STRING(first, second) strcmp((first), (second))
+
+/**
+ * The largest index of a node in an indexed tree, one bit of the parent index holds the color
+ */
+#define RB_TREE_MAX_INDEX (UINT32_MAX >> 1)
+
+/**
+ * Generates the nodes of a tree linked by pointers, with the color in the low bit of the parent pointer
+ * Nodes are allocated with malloc_checked and stay in place until their key is deleted.
+ * A node holds three pointers and its key, followed by the extra members.
+ * @param name the name of the tree type, prefixing all generated names
+ * @param key_type the type of the keys
+ * @param members declarations of extra members of the nodes, may be empty
+ */
+#define RB_TREE_DEFINE_POINTER_LINKS(name, key_type, members) \
+  typedef struct name##_node * name##_ref; \
+\
+  struct name##_node{ \
+    uintptr_t parent_color; \
+    name##_ref left; \
+    name##_ref right; \
+    key_type key; \
+    members \
+  }; \
+\
+  struct name{ \
+    name##_ref root; \
+    size_t size; \
+  }; \
+\
+  static inline struct name##_node * name##_at(const struct name * tree, name##_ref ref){ \
+    return ref; \
+  } \
+\
+  static inline name##_ref name##_ref_of(const struct name * tree, struct name##_node * node){ \
+    return node; \
+  } \
+\
+  static inline name##_ref name##_parent(const struct name * tree, name##_ref ref){ \
+    return (name##_ref)(ref->parent_color & ~(uintptr_t)1); \
+  } \
+\
+  static inline void name##_set_parent(const struct name * tree, name##_ref ref, name##_ref parent){ \
+    ref->parent_color = (uintptr_t)parent | (ref->parent_color & 1); \
+  } \
+\
+  static inline bool name##_is_red(const struct name * tree, name##_ref ref){ \
+    return ref != 0 && (ref->parent_color & 1) != 0; \
+  } \
+\
+  static inline void name##_set_red(const struct name * tree, name##_ref ref, bool red){ \
+    ref->parent_color = (ref->parent_color & ~(uintptr_t)1) | (uintptr_t)red; \
+  } \
+\
+  static inline void name##_init(struct name * tree){ \
+    tree->root = 0; \
+    tree->size = 0; \
+  } \
+\
+  static inline name##_ref name##_alloc(struct name * tree){ \
+    name##_ref ref = (name##_ref)malloc_checked(sizeof(struct name##_node)); \
+    ref->parent_color = 0; \
+    ref->left = 0; \
+    ref->right = 0; \
+    return ref; \
+  } \
+\
+  static inline void name##_release(struct name * tree, name##_ref ref){ \
+    free(ref); \
+  } \
+\
+  static inline void name##_free(struct name * tree){ \
+    name##_ref ref = tree->root; \
+    while(ref != 0){ \
+      if(ref->left != 0){ \
+	name##_ref left = ref->left; \
+	ref->left = 0; \
+	ref = left; \
+      }else if(ref->right != 0){ \
+	name##_ref right = ref->right; \
+	ref->right = 0; \
+	ref = right; \
+      }else{ \
+	name##_ref parent = name##_parent(tree, ref); \
+	free(ref); \
+	ref = parent; \
+      } \
+    } \
+    name##_init(tree); \
+  }
+
+/**
+ * Generates the nodes of a tree linked by 32 bit indices into an arena, with the color in the low bit of the parent index
+ * Index 0 stands for no node. The arena doubles when it is full and reuses the slots of deleted nodes,
+ * so node pointers are only valid until the next insert, and the arena is only released when the tree is freed.
+ * A tree holds at most RB_TREE_MAX_INDEX nodes.
+ * @param name the name of the tree type, prefixing all generated names
+ * @param key_type the type of the keys
+ * @param members declarations of extra members of the nodes, may be empty
+ */
+#define RB_TREE_DEFINE_INDEX_LINKS(name, key_type, members) \
+  typedef uint32_t name##_ref; \
+\
+  struct name##_node{ \
+    uint32_t parent_color; \
+    name##_ref left; \
+    name##_ref right; \
+    key_type key; \
+    members \
+  }; \
+\
+  struct name{ \
+    name##_ref root; \
+    size_t size; \
+    struct name##_node * nodes; \
+    uint32_t capacity; \
+    uint32_t used; \
+    name##_ref free_list; \
+  }; \
+\
+  static inline struct name##_node * name##_at(const struct name * tree, name##_ref ref){ \
+    return &tree->nodes[ref]; \
+  } \
+\
+  static inline name##_ref name##_ref_of(const struct name * tree, struct name##_node * node){ \
+    return (name##_ref)(node - tree->nodes); \
+  } \
+\
+  static inline name##_ref name##_parent(const struct name * tree, name##_ref ref){ \
+    return tree->nodes[ref].parent_color >> 1; \
+  } \
+\
+  static inline void name##_set_parent(const struct name * tree, name##_ref ref, name##_ref parent){ \
+    tree->nodes[ref].parent_color = (parent << 1) | (tree->nodes[ref].parent_color & 1); \
+  } \
+\
+  static inline bool name##_is_red(const struct name * tree, name##_ref ref){ \
+    return ref != 0 && (tree->nodes[ref].parent_color & 1) != 0; \
+  } \
+\
+  static inline void name##_set_red(const struct name * tree, name##_ref ref, bool red){ \
+    tree->nodes[ref].parent_color = (tree->nodes[ref].parent_color & ~(uint32_t)1) | (uint32_t)red; \
+  } \
+\
+  static inline void name##_init(struct name * tree){ \
+    tree->root = 0; \
+    tree->size = 0; \
+    tree->nodes = NULL; \
+    tree->capacity = 0; \
+    tree->used = 1; \
+    tree->free_list = 0; \
+  } \
+\
+  static inline name##_ref name##_alloc(struct name * tree){ \
+    name##_ref ref = tree->free_list; \
+    if(ref != 0){ \
+      tree->free_list = tree->nodes[ref].left; \
+    }else{ \
+      if(tree->used >= tree->capacity){ \
+	assert(tree->capacity <= RB_TREE_MAX_INDEX / 2); \
+	tree->capacity = tree->capacity == 0 ? 16 : 2 * tree->capacity; \
+	tree->nodes = (struct name##_node *)realloc_checked(tree->nodes, tree->capacity * sizeof(struct name##_node)); \
+      } \
+      ref = tree->used++; \
+    } \
+    tree->nodes[ref].parent_color = 0; \
+    tree->nodes[ref].left = 0; \
+    tree->nodes[ref].right = 0; \
+    return ref; \
+  } \
+\
+  static inline void name##_release(struct name * tree, name##_ref ref){ \
+    tree->nodes[ref].left = tree->free_list; \
+    tree->free_list = ref; \
+  } \
+\
+  static inline void name##_free(struct name * tree){ \
+    free(tree->nodes); \
+    name##_init(tree); \
+  }
+
+/**
+ * Generates the operations of a red black tree specialized for a key type, on the nodes generated by one of the link macros
+ * All operations are static inline code. The comparison is expanded inline and keys are stored in the nodes,
+ * so there are no indirect calls and no void pointers. Keys are copied by assignment and never freed by the tree.
+ * Defines
+ *   void name##_init(struct name * tree)
+ *   struct name##_node * name##_insert(struct name * tree, key_type key, bool * inserted), returning the new or the existing node
+ *   bool name##_delete(struct name * tree, key_type key)
+ *   void name##_erase(struct name * tree, struct name##_node * node)
+ *   struct name##_node * name##_find(const struct name * tree, key_type key)
+ *   struct name##_node * name##_lower_bound(const struct name * tree, key_type key)
+ *   struct name##_node * name##_get_first(const struct name * tree)
+ *   struct name##_node * name##_get_next(const struct name * tree, struct name##_node * node)
+ *   size_t name##_size(const struct name * tree)
+ *   bool name##_validate(const struct name * tree)
+ *   void name##_free(struct name * tree)
+ * @param name the name of the tree type
+ * @param key_type the type of the keys
+ * @param cmp a function or function like macro called as cmp(first, second), returning an int smaller than, equal to or greater than 0
+ */
+#define RB_TREE_DEFINE_OPERATIONS(name, key_type, cmp) \
+  static inline name##_ref name##_left(const struct name * tree, name##_ref ref){ \
+    return name##_at(tree, ref)->left; \
+  } \
+\
+  static inline name##_ref name##_right(const struct name * tree, name##_ref ref){ \
+    return name##_at(tree, ref)->right; \
+  } \
+\
+  static inline struct name##_node * name##_node_of(const struct name * tree, name##_ref ref){ \
+    return ref == 0 ? NULL : name##_at(tree, ref); \
+  } \
+\
+  static inline size_t name##_size(const struct name * tree){ \
+    return tree->size; \
+  } \
+\
+  static inline struct name##_node * name##_find(const struct name * tree, key_type key){ \
+    name##_ref ref = tree->root; \
+    while(ref != 0){ \
+      int result = cmp(key, name##_at(tree, ref)->key); \
+      if(result < 0){ \
+	ref = name##_left(tree, ref); \
+      }else if(result > 0){ \
+	ref = name##_right(tree, ref); \
+      }else{ \
+	return name##_at(tree, ref); \
+      } \
+    } \
+    return NULL; \
+  } \
+\
+  static inline struct name##_node * name##_lower_bound(const struct name * tree, key_type key){ \
+    name##_ref ref = tree->root; \
+    name##_ref bound = 0; \
+    while(ref != 0){ \
+      if(cmp(name##_at(tree, ref)->key, key) < 0){ \
+	ref = name##_right(tree, ref); \
+      }else{ \
+	bound = ref; \
+	ref = name##_left(tree, ref); \
+      } \
+    } \
+    return name##_node_of(tree, bound); \
+  } \
+\
+  static inline struct name##_node * name##_get_first(const struct name * tree){ \
+    name##_ref ref = tree->root; \
+    while(ref != 0 && name##_left(tree, ref) != 0){ \
+      ref = name##_left(tree, ref); \
+    } \
+    return name##_node_of(tree, ref); \
+  } \
+\
+  static inline struct name##_node * name##_get_next(const struct name * tree, struct name##_node * node){ \
+    name##_ref ref = name##_ref_of(tree, node); \
+    if(name##_right(tree, ref) != 0){ \
+      ref = name##_right(tree, ref); \
+      while(name##_left(tree, ref) != 0){ \
+	ref = name##_left(tree, ref); \
+      } \
+      return name##_at(tree, ref); \
+    } \
+    name##_ref parent = name##_parent(tree, ref); \
+    while(parent != 0 && ref == name##_right(tree, parent)){ \
+      ref = parent; \
+      parent = name##_parent(tree, ref); \
+    } \
+    return name##_node_of(tree, parent); \
+  } \
+\
+  static inline void name##_replace_child(struct name * tree, name##_ref parent, name##_ref old_child, name##_ref new_child){ \
+    if(parent == 0){ \
+      tree->root = new_child; \
+    }else if(name##_left(tree, parent) == old_child){ \
+      name##_at(tree, parent)->left = new_child; \
+    }else{ \
+      name##_at(tree, parent)->right = new_child; \
+    } \
+  } \
+\
+  static inline void name##_rotate_left(struct name * tree, name##_ref ref){ \
+    name##_ref right = name##_right(tree, ref); \
+    name##_ref inner = name##_left(tree, right); \
+    name##_at(tree, ref)->right = inner; \
+    if(inner != 0){ \
+      name##_set_parent(tree, inner, ref); \
+    } \
+    name##_set_parent(tree, right, name##_parent(tree, ref)); \
+    name##_replace_child(tree, name##_parent(tree, ref), ref, right); \
+    name##_at(tree, right)->left = ref; \
+    name##_set_parent(tree, ref, right); \
+  } \
+\
+  static inline void name##_rotate_right(struct name * tree, name##_ref ref){ \
+    name##_ref left = name##_left(tree, ref); \
+    name##_ref inner = name##_right(tree, left); \
+    name##_at(tree, ref)->left = inner; \
+    if(inner != 0){ \
+      name##_set_parent(tree, inner, ref); \
+    } \
+    name##_set_parent(tree, left, name##_parent(tree, ref)); \
+    name##_replace_child(tree, name##_parent(tree, ref), ref, left); \
+    name##_at(tree, left)->right = ref; \
+    name##_set_parent(tree, ref, left); \
+  } \
+\
+  static inline void name##_insert_fixup(struct name * tree, name##_ref ref){ \
+    name##_ref parent; \
+    while((parent = name##_parent(tree, ref)) != 0 && name##_is_red(tree, parent)){ \
+      name##_ref grandparent = name##_parent(tree, parent); \
+      if(parent == name##_left(tree, grandparent)){ \
+	name##_ref uncle = name##_right(tree, grandparent); \
+	if(name##_is_red(tree, uncle)){ \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, uncle, false); \
+	  name##_set_red(tree, grandparent, true); \
+	  ref = grandparent; \
+	}else{ \
+	  if(ref == name##_right(tree, parent)){ \
+	    name##_rotate_left(tree, parent); \
+	    parent = ref; \
+	  } \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, grandparent, true); \
+	  name##_rotate_right(tree, grandparent); \
+	  break; \
+	} \
+      }else{ \
+	name##_ref uncle = name##_left(tree, grandparent); \
+	if(name##_is_red(tree, uncle)){ \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, uncle, false); \
+	  name##_set_red(tree, grandparent, true); \
+	  ref = grandparent; \
+	}else{ \
+	  if(ref == name##_left(tree, parent)){ \
+	    name##_rotate_right(tree, parent); \
+	    parent = ref; \
+	  } \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, grandparent, true); \
+	  name##_rotate_left(tree, grandparent); \
+	  break; \
+	} \
+      } \
+    } \
+    name##_set_red(tree, tree->root, false); \
+  } \
+\
+  static inline struct name##_node * name##_insert(struct name * tree, key_type key, bool * inserted){ \
+    name##_ref parent = 0; \
+    name##_ref ref = tree->root; \
+    int result = 0; \
+    while(ref != 0){ \
+      parent = ref; \
+      result = cmp(key, name##_at(tree, ref)->key); \
+      if(result < 0){ \
+	ref = name##_left(tree, ref); \
+      }else if(result > 0){ \
+	ref = name##_right(tree, ref); \
+      }else{ \
+	if(inserted != NULL){ \
+	  *inserted = false; \
+	} \
+	return name##_at(tree, ref); \
+      } \
+    } \
+    ref = name##_alloc(tree); \
+    name##_at(tree, ref)->key = key; \
+    name##_set_parent(tree, ref, parent); \
+    name##_set_red(tree, ref, true); \
+    if(parent == 0){ \
+      tree->root = ref; \
+    }else if(result < 0){ \
+      name##_at(tree, parent)->left = ref; \
+    }else{ \
+      name##_at(tree, parent)->right = ref; \
+    } \
+    ++tree->size; \
+    name##_insert_fixup(tree, ref); \
+    if(inserted != NULL){ \
+      *inserted = true; \
+    } \
+    return name##_at(tree, ref); \
+  } \
+\
+  static inline void name##_erase_fixup(struct name * tree, name##_ref ref, name##_ref parent){ \
+    while(ref != tree->root && !name##_is_red(tree, ref)){ \
+      if(ref == name##_left(tree, parent)){ \
+	name##_ref sibling = name##_right(tree, parent); \
+	if(name##_is_red(tree, sibling)){ \
+	  name##_set_red(tree, sibling, false); \
+	  name##_set_red(tree, parent, true); \
+	  name##_rotate_left(tree, parent); \
+	  sibling = name##_right(tree, parent); \
+	} \
+	if(!name##_is_red(tree, name##_left(tree, sibling)) && !name##_is_red(tree, name##_right(tree, sibling))){ \
+	  name##_set_red(tree, sibling, true); \
+	  ref = parent; \
+	  parent = name##_parent(tree, ref); \
+	}else{ \
+	  if(!name##_is_red(tree, name##_right(tree, sibling))){ \
+	    name##_set_red(tree, name##_left(tree, sibling), false); \
+	    name##_set_red(tree, sibling, true); \
+	    name##_rotate_right(tree, sibling); \
+	    sibling = name##_right(tree, parent); \
+	  } \
+	  name##_set_red(tree, sibling, name##_is_red(tree, parent)); \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, name##_right(tree, sibling), false); \
+	  name##_rotate_left(tree, parent); \
+	  ref = tree->root; \
+	} \
+      }else{ \
+	name##_ref sibling = name##_left(tree, parent); \
+	if(name##_is_red(tree, sibling)){ \
+	  name##_set_red(tree, sibling, false); \
+	  name##_set_red(tree, parent, true); \
+	  name##_rotate_right(tree, parent); \
+	  sibling = name##_left(tree, parent); \
+	} \
+	if(!name##_is_red(tree, name##_left(tree, sibling)) && !name##_is_red(tree, name##_right(tree, sibling))){ \
+	  name##_set_red(tree, sibling, true); \
+	  ref = parent; \
+	  parent = name##_parent(tree, ref); \
+	}else{ \
+	  if(!name##_is_red(tree, name##_left(tree, sibling))){ \
+	    name##_set_red(tree, name##_right(tree, sibling), false); \
+	    name##_set_red(tree, sibling, true); \
+	    name##_rotate_left(tree, sibling); \
+	    sibling = name##_left(tree, parent); \
+	  } \
+	  name##_set_red(tree, sibling, name##_is_red(tree, parent)); \
+	  name##_set_red(tree, parent, false); \
+	  name##_set_red(tree, name##_left(tree, sibling), false); \
+	  name##_rotate_right(tree, parent); \
+	  ref = tree->root; \
+	} \
+      } \
+    } \
+    if(ref != 0){ \
+      name##_set_red(tree, ref, false); \
+    } \
+  } \
+\
+  static inline void name##_erase(struct name * tree, struct name##_node * node){ \
+    name##_ref ref = name##_ref_of(tree, node); \
+    name##_ref left = name##_left(tree, ref); \
+    name##_ref right = name##_right(tree, ref); \
+    name##_ref child; \
+    name##_ref parent; \
+    bool red; \
+    if(left == 0 || right == 0){ \
+      child = left != 0 ? left : right; \
+      parent = name##_parent(tree, ref); \
+      red = name##_is_red(tree, ref); \
+      name##_replace_child(tree, parent, ref, child); \
+      if(child != 0){ \
+	name##_set_parent(tree, child, parent); \
+      } \
+    }else{ \
+      name##_ref successor = right; \
+      while(name##_left(tree, successor) != 0){ \
+	successor = name##_left(tree, successor); \
+      } \
+      child = name##_right(tree, successor); \
+      red = name##_is_red(tree, successor); \
+      if(successor == right){ \
+	parent = successor; \
+      }else{ \
+	parent = name##_parent(tree, successor); \
+	name##_at(tree, parent)->left = child; \
+	if(child != 0){ \
+	  name##_set_parent(tree, child, parent); \
+	} \
+	name##_at(tree, successor)->right = right; \
+	name##_set_parent(tree, right, successor); \
+      } \
+      name##_at(tree, successor)->left = left; \
+      name##_set_parent(tree, left, successor); \
+      name##_set_parent(tree, successor, name##_parent(tree, ref)); \
+      name##_set_red(tree, successor, name##_is_red(tree, ref)); \
+      name##_replace_child(tree, name##_parent(tree, ref), ref, successor); \
+    } \
+    --tree->size; \
+    if(!red){ \
+      name##_erase_fixup(tree, child, parent); \
+    } \
+    name##_release(tree, ref); \
+  } \
+\
+  static inline bool name##_delete(struct name * tree, key_type key){ \
+    struct name##_node * node = name##_find(tree, key); \
+    if(node == NULL){ \
+      return false; \
+    } \
+    name##_erase(tree, node); \
+    return true; \
+  } \
+\
+  static inline int name##_validate_node(const struct name * tree, name##_ref ref, const key_type * lower, const key_type * upper, size_t * count){ \
+    if(ref == 0){ \
+      return 1; \
+    } \
+    struct name##_node * node = name##_at(tree, ref); \
+    if((lower != NULL && cmp(*lower, node->key) >= 0) || (upper != NULL && cmp(node->key, *upper) >= 0)){ \
+      return -1; \
+    } \
+    if((node->left != 0 && name##_parent(tree, node->left) != ref) || (node->right != 0 && name##_parent(tree, node->right) != ref)){ \
+      return -1; \
+    } \
+    if(name##_is_red(tree, ref) && (name##_is_red(tree, node->left) || name##_is_red(tree, node->right))){ \
+      return -1; \
+    } \
+    int left = name##_validate_node(tree, node->left, lower, &node->key, count); \
+    int right = name##_validate_node(tree, node->right, &node->key, upper, count); \
+    if(left < 0 || left != right){ \
+      return -1; \
+    } \
+    ++*count; \
+    return name##_is_red(tree, ref) ? left : left + 1; \
+  } \
+\
+  static inline bool name##_validate(const struct name * tree){ \
+    size_t count = 0; \
+    if(tree->root != 0 && (name##_parent(tree, tree->root) != 0 || name##_is_red(tree, tree->root))){ \
+      return false; \
+    } \
+    return name##_validate_node(tree, tree->root, NULL, NULL, &count) > 0 && count == tree->size; \
+  }
+
+/**
+ * Generates the operations of a map on top of the tree operations, for nodes with a value member
+ *   bool name##_put(struct name * map, key_type key, value_type value), returning true if the value of an existing key was replaced
+ *   value_type * name##_get(const struct name * map, key_type key), returning a pointer to the value or NULL
+ * @param name the name of the map type
+ * @param key_type the type of the keys
+ * @param value_type the type of the values
+ */
+#define RB_MAP_DEFINE_OPERATIONS(name, key_type, value_type) \
+  static inline bool name##_put(struct name * map, key_type key, value_type value){ \
+    bool inserted; \
+    struct name##_node * node = name##_insert(map, key, &inserted); \
+    node->value = value; \
+    return !inserted; \
+  } \
+\
+  static inline value_type * name##_get(const struct name * map, key_type key){ \
+    struct name##_node * node = name##_find(map, key); \
+    return node == NULL ? NULL : &node->value; \
+  }
+
+/**
+ * Generates a set of keys linked by pointers, see RB_TREE_DEFINE_OPERATIONS
+ * @param name the name of the tree type
+ * @param key_type the type of the keys
+ * @param cmp the comparison
+ */
+#define RB_TREE_DEFINE(name, key_type, cmp) \
+  RB_TREE_DEFINE_POINTER_LINKS(name, key_type, ) \
+  RB_TREE_DEFINE_OPERATIONS(name, key_type, cmp)
+
+/**
+ * Generates a set of keys stored in an arena and linked by 32 bit indices, see RB_TREE_DEFINE_INDEX_LINKS
+ * @param name the name of the tree type
+ * @param key_type the type of the keys
+ * @param cmp the comparison
+ */
+#define RB_TREE_DEFINE_INDEXED(name, key_type, cmp) \
+  RB_TREE_DEFINE_INDEX_LINKS(name, key_type, ) \
+  RB_TREE_DEFINE_OPERATIONS(name, key_type, cmp)
+
+/**
+ * Generates a map from keys to values linked by pointers, see RB_MAP_DEFINE_OPERATIONS
+ * @param name the name of the map type
+ * @param key_type the type of the keys
+ * @param value_type the type of the values
+ * @param cmp the comparison of the keys
+ */
+#define RB_MAP_DEFINE(name, key_type, value_type, cmp) \
+  RB_TREE_DEFINE_POINTER_LINKS(name, key_type, value_type value;) \
+  RB_TREE_DEFINE_OPERATIONS(name, key_type, cmp) \
+  RB_MAP_DEFINE_OPERATIONS(name, key_type, value_type)
+
+/**
+ * Generates a map from keys to values stored in an arena and linked by 32 bit indices, see RB_TREE_DEFINE_INDEX_LINKS
+ * @param name the name of the map type
+ * @param key_type the type of the keys
+ * @param value_type the type of the values
+ * @param cmp the comparison of the keys
+ */
+#define RB_MAP_DEFINE_INDEXED(name, key_type, value_type, cmp) \
+  RB_TREE_DEFINE_INDEX_LINKS(name, key_type, value_type value;) \
+  RB_TREE_DEFINE_OPERATIONS(name, key_type, cmp) \
+  RB_MAP_DEFINE_OPERATIONS(name, key_type, value_type)
+
 #endif
@@ -0,0 +1,481 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Replays a trace of operations against a red black tree and ordered maps and reports their latencies
+ *
+ * A text trace holds one operation per line, keys being unsigned 64 bit integers:
+ *   i <key>          inserts the key
+ *   f <key>          finds the key
+ *   d <key>          deletes the key
+ *   r <low> <high>   visits the keys in [low, high)
+ * Empty lines and lines starting with # are ignored.
+ *
+ * A binary trace starts with the 8 bytes of TRACE_MAGIC, followed by one record of three native endian
+ * 64 bit words per operation: the operation character, the key and the upper bound of a range or 0.
+ *
+ * usage: replay [-c csv_file] trace_file
+ *        replay -g count [-b] > trace_file
+ */
+
+#include "histogram.h"
+#include "memory.h"
+#include "ordered_map.h"
+#include "rb_tree.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The first bytes of a binary trace
+ */
+#define TRACE_MAGIC "RBTRACE1"
+
+/**
+ * The number of distinct keys in a generated trace, relative to the number of operations
+ */
+#define GENERATED_KEY_SPACE_DIVISOR 4
+
+/**
+ * The largest number of keys a generated range spans
+ */
+#define GENERATED_RANGE_SPAN 64
+
+/**
+ * The kinds of operations in a trace
+ */
+enum operation{
+  OPERATION_INSERT,
+  OPERATION_FIND,
+  OPERATION_DELETE,
+  OPERATION_RANGE,
+  OPERATION_COUNT
+};
+
+static const char operation_codes[OPERATION_COUNT] = {'i', 'f', 'd', 'r'};
+
+static const char * operation_names[OPERATION_COUNT] = {"insert", "find", "delete", "range"};
+
+/**
+ * An operation of a trace
+ */
+struct record{
+  enum operation operation;
+  uint64_t key;
+  uint64_t high;
+};
+
+/**
+ * A trace loaded in memory, so reading it does not disturb the measurements
+ */
+struct trace{
+  struct record * records;
+  size_t size;
+  size_t capacity;
+};
+
+/**
+ * Keeps the results of lookups alive so they are not optimized away
+ */
+static volatile uintptr_t sink;
+
+static uint64_t get_time_ns(){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+
+/*
+ * Traces
+ */
+
+static void add_record(struct trace * trace, enum operation operation, uint64_t key, uint64_t high){
+  if(trace->size == trace->capacity){
+    trace->capacity = trace->capacity == 0 ? 1024 : 2 * trace->capacity;
+    trace->records = realloc_checked(trace->records, trace->capacity * sizeof(struct record));
+  }
+  trace->records[trace->size].operation = operation;
+  trace->records[trace->size].key = key;
+  trace->records[trace->size].high = high;
+  ++trace->size;
+}
+
+/**
+ * Returns the operation of a code or OPERATION_COUNT if the code is unknown
+ */
+static enum operation get_operation(int code){
+  for(int operation = 0; operation < OPERATION_COUNT; ++operation){
+    if(operation_codes[operation] == code){
+      return (enum operation)operation;
+    }
+  }
+  return OPERATION_COUNT;
+}
+
+/**
+ * Reads the records of a binary trace after its magic
+ * @return false if the trace is malformed
+ */
+static bool read_binary_trace(FILE * file, struct trace * trace){
+  uint64_t words[3];
+  size_t read;
+  while((read = fread(words, sizeof(uint64_t), 3, file)) == 3){
+    enum operation operation = get_operation((int)words[0]);
+    if(operation == OPERATION_COUNT){
+      return false;
+    }
+    add_record(trace, operation, words[1], words[2]);
+  }
+  return read == 0 && !ferror(file);
+}
+
+/**
+ * Reads the lines of a text trace
+ * @return false if the trace is malformed, after reporting the offending line
+ */
+static bool read_text_trace(FILE * file, struct trace * trace){
+  char line[256];
+  size_t number = 0;
+  while(fgets(line, sizeof(line), file) != NULL){
+    ++number;
+    char code;
+    unsigned long long key;
+    unsigned long long high = 0;
+    int fields = sscanf(line, " %c %llu %llu", &code, &key, &high);
+    if(fields <= 0 || code == '#'){
+      continue;
+    }
+    enum operation operation = get_operation(code);
+    if(operation == OPERATION_COUNT || fields < (operation == OPERATION_RANGE ? 3 : 2)){
+      fprintf(stderr, "malformed operation on line %zu: %s", number, line);
+      return false;
+    }
+    add_record(trace, operation, key, high);
+  }
+  return !ferror(file);
+}
+
+/**
+ * Loads a text or binary trace
+ * @return false if the file cannot be read or is malformed
+ */
+static bool read_trace(const char * path, struct trace * trace){
+  FILE * file = fopen(path, "rb");
+  if(file == NULL){
+    perror(path);
+    return false;
+  }
+  char magic[sizeof(TRACE_MAGIC) - 1];
+  bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+  if(!binary){
+    rewind(file);
+  }
+  bool valid = binary ? read_binary_trace(file, trace) : read_text_trace(file, trace);
+  fclose(file);
+  if(!valid){
+    fprintf(stderr, "%s: malformed trace\n", path);
+  }
+  return valid;
+}
+
+/**
+ * Returns the next value of a splitmix64 generator
+ */
+static uint64_t next_random(uint64_t * state){
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * Writes a trace of uniformly random operations to stdout: half finds, a quarter inserts, the rest deletes and ranges
+ */
+static void generate_trace(size_t count, bool binary){
+  uint64_t state = 42;
+  uint64_t key_space = count / GENERATED_KEY_SPACE_DIVISOR + 1;
+  if(binary){
+    fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC) - 1, stdout);
+  }
+  for(size_t i = 0; i < count; ++i){
+    uint64_t choice = next_random(&state) % 8;
+    enum operation operation = choice < 4 ? OPERATION_FIND : choice < 6 ? OPERATION_INSERT : choice < 7 ? OPERATION_DELETE : OPERATION_RANGE;
+    uint64_t key = next_random(&state) % key_space;
+    uint64_t high = operation == OPERATION_RANGE ? key + 1 + next_random(&state) % GENERATED_RANGE_SPAN : 0;
+    if(binary){
+      uint64_t words[3] = {(uint64_t)operation_codes[operation], key, high};
+      fwrite(words, sizeof(uint64_t), 3, stdout);
+    }else if(operation == OPERATION_RANGE){
+      printf("%c %llu %llu\n", operation_codes[operation], (unsigned long long)key, (unsigned long long)high);
+    }else{
+      printf("%c %llu\n", operation_codes[operation], (unsigned long long)key);
+    }
+  }
+}
+
+/*
+ * Targets
+ */
+
+static int cmp_tree(const struct rb_tree * tree, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+static int cmp_map(const struct ordered_map * map, void * first, void * second){
+  uintptr_t first_key = (uintptr_t)first;
+  uintptr_t second_key = (uintptr_t)second;
+  return (first_key > second_key) - (first_key < second_key);
+}
+
+/**
+ * The latencies of each kind of operation against a target
+ */
+struct latencies{
+  struct histogram histograms[OPERATION_COUNT];
+};
+
+static void init_latencies(struct latencies * latencies){
+  for(int operation = 0; operation < OPERATION_COUNT; ++operation){
+    histogram_init(&latencies->histograms[operation]);
+  }
+}
+
+static void replay_tree(const struct trace * trace, struct latencies * latencies){
+  struct rb_tree tree;
+  rb_tree_init(&tree, &cmp_tree, NULL, NULL);
+  rb_tree_set_validation(&tree, RB_VALIDATION_OFF, 0);
+
+  for(size_t i = 0; i < trace->size; ++i){
+    const struct record * record = &trace->records[i];
+    void * key = (void *)(uintptr_t)record->key;
+    uint64_t start = get_time_ns();
+    switch(record->operation){
+    case OPERATION_INSERT:
+      rb_tree_insert(&tree, key);
+      break;
+    case OPERATION_FIND:
+      sink = (uintptr_t)rb_tree_find(&tree, key);
+      break;
+    case OPERATION_DELETE:
+      rb_tree_find_and_delete(&tree, key);
+      break;
+    case OPERATION_RANGE:
+      for(struct rb_node * node = rb_tree_lower_bound(&tree, key); node != NULL && (uintptr_t)rb_tree_get_value(&tree, node) < record->high; node = rb_tree_get_next(&tree, node)){
+	sink = (uintptr_t)node;
+      }
+      break;
+    case OPERATION_COUNT:
+      break;
+    }
+    histogram_record(&latencies->histograms[record->operation], get_time_ns() - start);
+  }
+  rb_tree_free(&tree);
+}
+
+static void replay_map(const struct trace * trace, enum ordered_map_engine engine, struct latencies * latencies){
+  struct ordered_map map;
+  ordered_map_init_engine(&map, engine, &cmp_map, NULL, NULL, NULL);
+  if(engine == ORDERED_MAP_RB_TREE){
+    // as in replay_tree, so debug builds compare the targets on equal terms
+    rb_tree_set_validation(&map.tree, RB_VALIDATION_OFF, 0);
+  }
+
+  for(size_t i = 0; i < trace->size; ++i){
+    const struct record * record = &trace->records[i];
+    void * key = (void *)(uintptr_t)record->key;
+    uint64_t start = get_time_ns();
+    switch(record->operation){
+    case OPERATION_INSERT:
+      ordered_map_insert(&map, key, key);
+      break;
+    case OPERATION_FIND:
+      sink = (uintptr_t)ordered_map_get(&map, key);
+      break;
+    case OPERATION_DELETE:
+      ordered_map_delete(&map, key);
+      break;
+    case OPERATION_RANGE:{
+      struct ordered_map_range range;
+      ordered_map_range_init(&range, &map, key, (void *)(uintptr_t)record->high);
+      for(struct ordered_map_entry * entry = ordered_map_range_next(&range); entry != NULL; entry = ordered_map_range_next(&range)){
+	sink = (uintptr_t)entry->value;
+      }
+      break;
+    }
+    case OPERATION_COUNT:
+      break;
+    }
+    histogram_record(&latencies->histograms[record->operation], get_time_ns() - start);
+  }
+  ordered_map_free(&map);
+}
+
+/*
+ * Reports
+ */
+
+/**
+ * The percentiles reported for each operation, in the spirit of HdrHistogram
+ */
+static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+static void print_header(FILE * csv){
+  printf("%-12s %-8s %10s %10s %8s %8s %8s %8s %8s %10s\n", "target", "op", "count", "mean ns", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+  if(csv != NULL){
+    fputs("target,operation,count,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,p9999_ns,max_ns\n", csv);
+  }
+}
+
+static void print_latencies(FILE * csv, const char * target, const struct latencies * latencies){
+  for(int operation = 0; operation < OPERATION_COUNT; ++operation){
+    const struct histogram * histogram = &latencies->histograms[operation];
+    if(histogram->total == 0){
+      continue;
+    }
+    uint64_t values[sizeof(percentiles) / sizeof(percentiles[0])];
+    for(size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i){
+      values[i] = histogram_get_percentile(histogram, percentiles[i]);
+    }
+
+    printf("%-12s %-8s %10llu %10.1f %8llu %8llu %8llu %8llu %8llu %10llu\n",
+	   target,
+	   operation_names[operation],
+	   (unsigned long long)histogram->total,
+	   histogram_get_mean(histogram),
+	   (unsigned long long)values[0],
+	   (unsigned long long)values[1],
+	   (unsigned long long)values[2],
+	   (unsigned long long)values[3],
+	   (unsigned long long)values[4],
+	   (unsigned long long)histogram->max);
+    if(csv != NULL){
+      fprintf(csv, "%s,%s,%llu,%.1f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+	      target,
+	      operation_names[operation],
+	      (unsigned long long)histogram->total,
+	      histogram_get_mean(histogram),
+	      (unsigned long long)values[0],
+	      (unsigned long long)values[1],
+	      (unsigned long long)values[2],
+	      (unsigned long long)values[3],
+	      (unsigned long long)values[4],
+	      (unsigned long long)histogram->max);
+    }
+  }
+}
+
+static void print_usage(){
+  fputs("usage: replay [-c csv_file] trace_file\n"
+	"       replay -g count [-b] > trace_file\n", stderr);
+}
+
+/**
+ * The replay application entry point
+ * Replays a trace against each target in turn, or generates a trace
+ * @param arg_count the number of command line arguments
+ * @param args the command line arguments
+ * @return the exit code
+ */
+int main(int arg_count, const char ** args){
+  const char * csv_path = NULL;
+  const char * trace_path = NULL;
+  size_t generate_count = 0;
+  bool binary = false;
+
+  for(int i = 1; i < arg_count; ++i){
+    if(strcmp(args[i], "-c") == 0 && i + 1 < arg_count){
+      csv_path = args[++i];
+    }else if(strcmp(args[i], "-g") == 0 && i + 1 < arg_count){
+      char * end;
+      generate_count = (size_t)strtoull(args[++i], &end, 10);
+      if(*end != '\0' || generate_count == 0){
+	fputs("count should be a positive number\n", stderr);
+	return 1;
+      }
+    }else if(strcmp(args[i], "-b") == 0){
+      binary = true;
+    }else if(args[i][0] != '-' && trace_path == NULL){
+      trace_path = args[i];
+    }else{
+      print_usage();
+      return 1;
+    }
+  }
+
+  if(generate_count > 0){
+    if(trace_path != NULL || csv_path != NULL){
+      print_usage();
+      return 1;
+    }
+    generate_trace(generate_count, binary);
+    return 0;
+  }
+  if(trace_path == NULL || binary){
+    print_usage();
+    return 1;
+  }
+
+  struct trace trace = {NULL, 0, 0};
+  if(!read_trace(trace_path, &trace)){
+    free(trace.records);
+    return 1;
+  }
+  FILE * csv = NULL;
+  if(csv_path != NULL){
+    csv = fopen(csv_path, "w");
+    if(csv == NULL){
+      perror(csv_path);
+      free(trace.records);
+      return 1;
+    }
+  }
+
+  static const struct{
+    const char * name;
+    enum ordered_map_engine engine;
+  } engines[] = {
+    {"map_rb_tree", ORDERED_MAP_RB_TREE},
+    {"map_skip", ORDERED_MAP_SKIP_LIST},
+    {"map_b_tree", ORDERED_MAP_B_TREE}
+  };
+
+  // the histograms are too large for the stack
+  struct latencies * latencies = malloc_checked(sizeof(struct latencies));
+  print_header(csv);
+  init_latencies(latencies);
+  replay_tree(&trace, latencies);
+  print_latencies(csv, "rb_tree", latencies);
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e){
+    init_latencies(latencies);
+    replay_map(&trace, engines[e].engine, latencies);
+    print_latencies(csv, engines[e].name, latencies);
+  }
+
+  free(latencies);
+  if(csv != NULL){
+    fclose(csv);
+  }
+  free(trace.records);
+  return 0;
+}
@@ -0,0 +1,403 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "memory.h"
+#include "sharded_ordered_map.h"
+#include "task_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void default_free(struct sharded_ordered_map * map, void * data){}
+
+/**
+ * The free function of the shards while their entries are moved elsewhere
+ */
+static void keep_entry_part(struct ordered_map * shard_map, void * data){}
+
+static int cmp_shard_key(const struct ordered_map * shard_map, void * first, void * second){
+  const struct sharded_ordered_map * map = (const struct sharded_ordered_map *)shard_map->state;
+  return (*map->cmp)(map, first, second);
+}
+
+static void free_shard_key(struct ordered_map * shard_map, void * key){
+  struct sharded_ordered_map * map = (struct sharded_ordered_map *)shard_map->state;
+  (*map->free_key)(map, key);
+}
+
+static void free_shard_value(struct ordered_map * shard_map, void * value){
+  struct sharded_ordered_map * map = (struct sharded_ordered_map *)shard_map->state;
+  (*map->free_value)(map, value);
+}
+
+/**
+ * Initializes the ordered map of a shard on the allocator of the shard
+ */
+static void init_shard_map(struct sharded_ordered_map * map, struct sharded_ordered_map_shard * shard){
+  ordered_map_init_allocator(&shard->map, &cmp_shard_key,
+			     map->free_key == default_free ? NULL : &free_shard_key,
+			     map->free_value == default_free ? NULL : &free_shard_value,
+			     map, &shard->memory.allocator);
+}
+
+/**
+ * Returns the index of the shard holding a key, the number of split keys not greater than the key
+ * Must be called with the routing lock held
+ */
+static size_t route(const struct sharded_ordered_map * map, void * key){
+  size_t low = 0;
+  size_t high = map->split_count;
+  while(low < high){
+    size_t middle = low + (high - low) / 2;
+    if((*map->cmp)(map, map->splits[middle], key) <= 0){
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/**
+ * Returns whether a shard is large enough to rebalance the map
+ */
+static bool is_skewed(const struct sharded_ordered_map * map, size_t shard_size, size_t size){
+  return map->shard_count > 1 && size >= SHARDED_ORDERED_MAP_MIN_REBALANCE && shard_size > SHARDED_ORDERED_MAP_SKEW * (size / map->shard_count);
+}
+
+void sharded_ordered_map_init(struct sharded_ordered_map * map, size_t shard_count, sharded_ordered_map_cmp_f cmp, sharded_ordered_map_copy_f copy_key, sharded_ordered_map_free_f free_key, sharded_ordered_map_free_f free_value, void * state){
+  assert(map != NULL);
+  assert(shard_count > 0);
+  assert(cmp != NULL);
+  // split keys borrowed from the entries would dangle once their entries are freed
+  assert(copy_key != NULL || free_key == NULL);
+
+  map->shard_count = shard_count;
+  map->splits = malloc_checked(shard_count * sizeof(void *));
+  map->split_count = 0;
+  pthread_rwlock_init(&map->routing, NULL);
+  atomic_init(&map->size, 0);
+  atomic_init(&map->rebalances, 0);
+  map->tasks = NULL;
+  map->cmp = cmp;
+  map->copy_key = copy_key;
+  map->free_key = free_key == NULL ? default_free : free_key;
+  map->free_value = free_value == NULL ? default_free : free_value;
+  map->state = state;
+
+  map->shards = malloc_checked(shard_count * sizeof(struct sharded_ordered_map_shard));
+  for(size_t i = 0; i < shard_count; ++i){
+    struct sharded_ordered_map_shard * shard = &map->shards[i];
+    pthread_rwlock_init(&shard->lock, NULL);
+    accounting_allocator_init(&shard->memory, &libc_allocator);
+    init_shard_map(map, shard);
+  }
+}
+
+void sharded_ordered_map_set_task_pool(struct sharded_ordered_map * map, struct task_pool * tasks){
+  assert(map != NULL);
+  map->tasks = tasks;
+}
+
+/*
+ * Rebalancing
+ */
+
+/**
+ * Rebuilds the shards from all entries with evenly spaced split keys
+ * Must be called with the routing lock held for writing, which excludes every other operation
+ */
+static void rebalance(struct sharded_ordered_map * map){
+  size_t size = atomic_load(&map->size);
+  void ** keys = malloc_checked((size + 1) * sizeof(void *));
+  void ** values = malloc_checked((size + 1) * sizeof(void *));
+
+  size_t count = 0;
+  for(size_t i = 0; i < map->shard_count; ++i){
+    struct sharded_ordered_map_shard * shard = &map->shards[i];
+    for(struct rb_node * node = rb_tree_get_begin(&shard->map.tree); node != NULL; node = rb_tree_get_next(&shard->map.tree, node)){
+      struct ordered_map_entry * entry = (struct ordered_map_entry *)rb_tree_get_value(&shard->map.tree, node);
+      keys[count] = entry->key;
+      values[count] = entry->value;
+      ++count;
+    }
+    // the entries move to the rebuilt shards, so only the nodes are freed
+    shard->map.free_key = &keep_entry_part;
+    shard->map.free_value = &keep_entry_part;
+    ordered_map_free(&shard->map);
+    init_shard_map(map, shard);
+  }
+  assert(count == size);
+
+  if(map->copy_key != NULL){
+    for(size_t i = 0; i < map->split_count; ++i){
+      (*map->free_key)(map, map->splits[i]);
+    }
+  }
+
+  size_t used = size < map->shard_count ? (size == 0 ? 1 : size) : map->shard_count;
+  map->split_count = used - 1;
+  for(size_t i = 0; i < used; ++i){
+    size_t first = i * size / used;
+    size_t end = (i + 1) * size / used;
+    if(i > 0){
+      map->splits[i - 1] = map->copy_key == NULL ? keys[first] : (*map->copy_key)(map, keys[first]);
+    }
+    ordered_map_build_sorted(&map->shards[i].map, keys + first, values + first, end - first);
+  }
+
+  free(keys);
+  free(values);
+  atomic_fetch_add(&map->rebalances, 1);
+}
+
+void sharded_ordered_map_rebalance(struct sharded_ordered_map * map){
+  assert(map != NULL);
+
+  pthread_rwlock_wrlock(&map->routing);
+  rebalance(map);
+  pthread_rwlock_unlock(&map->routing);
+}
+
+/**
+ * Rebalances the map unless another thread did so since the skew was seen
+ */
+static void rebalance_if_skewed(struct sharded_ordered_map * map){
+  pthread_rwlock_wrlock(&map->routing);
+  size_t largest = 0;
+  for(size_t i = 0; i < map->shard_count; ++i){
+    size_t shard_size = ordered_map_size(&map->shards[i].map);
+    largest = shard_size > largest ? shard_size : largest;
+  }
+  if(is_skewed(map, largest, atomic_load(&map->size))){
+    rebalance(map);
+  }
+  pthread_rwlock_unlock(&map->routing);
+}
+
+/*
+ * Point operations
+ */
+
+bool sharded_ordered_map_insert(struct sharded_ordered_map * map, void * key, void * value){
+  assert(map != NULL);
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct sharded_ordered_map_shard * shard = &map->shards[route(map, key)];
+  pthread_rwlock_wrlock(&shard->lock);
+  bool replaced = ordered_map_insert(&shard->map, key, value);
+  size_t shard_size = ordered_map_size(&shard->map);
+  pthread_rwlock_unlock(&shard->lock);
+  size_t size = replaced ? atomic_load(&map->size) : atomic_fetch_add(&map->size, 1) + 1;
+  bool skewed = !replaced && is_skewed(map, shard_size, size);
+  pthread_rwlock_unlock(&map->routing);
+
+  if(skewed){
+    rebalance_if_skewed(map);
+  }
+  return replaced;
+}
+
+bool sharded_ordered_map_delete(struct sharded_ordered_map * map, void * key){
+  assert(map != NULL);
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct sharded_ordered_map_shard * shard = &map->shards[route(map, key)];
+  pthread_rwlock_wrlock(&shard->lock);
+  bool deleted = ordered_map_delete(&shard->map, key);
+  pthread_rwlock_unlock(&shard->lock);
+  if(deleted){
+    atomic_fetch_sub(&map->size, 1);
+  }
+  pthread_rwlock_unlock(&map->routing);
+  return deleted;
+}
+
+void * sharded_ordered_map_get(struct sharded_ordered_map * map, void * key){
+  assert(map != NULL);
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct sharded_ordered_map_shard * shard = &map->shards[route(map, key)];
+  pthread_rwlock_rdlock(&shard->lock);
+  void * value = ordered_map_get(&shard->map, key);
+  pthread_rwlock_unlock(&shard->lock);
+  pthread_rwlock_unlock(&map->routing);
+  return value;
+}
+
+bool sharded_ordered_map_visit(struct sharded_ordered_map * map, void * key, sharded_ordered_map_visit_f visit, void * data){
+  assert(map != NULL);
+  assert(visit != NULL);
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct sharded_ordered_map_shard * shard = &map->shards[route(map, key)];
+  pthread_rwlock_rdlock(&shard->lock);
+  struct ordered_map_entry * entry = ordered_map_find(&shard->map, key);
+  if(entry != NULL){
+    (*visit)(map, entry, data);
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  pthread_rwlock_unlock(&map->routing);
+  return entry != NULL;
+}
+
+size_t sharded_ordered_map_size(struct sharded_ordered_map * map){
+  assert(map != NULL);
+  return atomic_load(&map->size);
+}
+
+/*
+ * Scans
+ */
+
+/**
+ * The entries a scan found in one shard
+ */
+struct scan_result{
+  struct ordered_map_entry * entries;
+  size_t count;
+  size_t capacity;
+};
+
+/**
+ * A scan of the shards first to last
+ */
+struct scan_task{
+  struct sharded_ordered_map * map;
+  size_t first;
+  size_t last;
+  void * low;
+  void * high;
+  struct scan_result * results;
+};
+
+static void scan_shard(struct sharded_ordered_map * map, size_t index, void * low, void * high, struct scan_result * result){
+  struct sharded_ordered_map_shard * shard = &map->shards[index];
+  struct ordered_map_range range;
+  pthread_rwlock_rdlock(&shard->lock);
+  ordered_map_range_init(&range, &shard->map, low, high);
+  for(struct ordered_map_entry * entry = ordered_map_range_next(&range); entry != NULL; entry = ordered_map_range_next(&range)){
+    if(result->count == result->capacity){
+      result->capacity = result->capacity == 0 ? 64 : 2 * result->capacity;
+      result->entries = realloc_checked(result->entries, result->capacity * sizeof(struct ordered_map_entry));
+    }
+    result->entries[result->count++] = *entry;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+/**
+ * Scans a single shard or forks a task for each half of the shards
+ */
+static void run_scan_task(void * data){
+  struct scan_task * task = (struct scan_task *)data;
+  if(task->first == task->last){
+    scan_shard(task->map, task->first, task->low, task->high, &task->results[task->first]);
+    return;
+  }
+  size_t middle = task->first + (task->last - task->first) / 2;
+  struct scan_task left = *task;
+  struct scan_task right = *task;
+  left.last = middle;
+  right.first = middle + 1;
+  task_pool_fork_join(task->map->tasks, &run_scan_task, &left, &run_scan_task, &right);
+}
+
+size_t sharded_ordered_map_scan(struct sharded_ordered_map * map, void * low, void * high, struct ordered_map_entry ** entries){
+  assert(map != NULL);
+  assert(entries != NULL);
+
+  *entries = NULL;
+  if((*map->cmp)(map, low, high) >= 0){
+    return 0;
+  }
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct scan_task task = {map, route(map, low), route(map, high), low, high, NULL};
+  task.results = malloc_checked(map->shard_count * sizeof(struct scan_result));
+  for(size_t i = task.first; i <= task.last; ++i){
+    task.results[i].entries = NULL;
+    task.results[i].count = 0;
+    task.results[i].capacity = 0;
+  }
+  if(map->tasks == NULL){
+    for(size_t i = task.first; i <= task.last; ++i){
+      scan_shard(map, i, low, high, &task.results[i]);
+    }
+  }else{
+    task_pool_run(map->tasks, &run_scan_task, &task);
+  }
+  pthread_rwlock_unlock(&map->routing);
+
+  // the shards cover consecutive key ranges, so concatenating their results keeps the entries in order
+  size_t count = 0;
+  for(size_t i = task.first; i <= task.last; ++i){
+    count += task.results[i].count;
+  }
+  if(count > 0){
+    *entries = malloc_checked(count * sizeof(struct ordered_map_entry));
+  }
+  size_t offset = 0;
+  for(size_t i = task.first; i <= task.last; ++i){
+    if(task.results[i].count > 0){
+      memcpy(*entries + offset, task.results[i].entries, task.results[i].count * sizeof(struct ordered_map_entry));
+    }
+    offset += task.results[i].count;
+    free(task.results[i].entries);
+  }
+  free(task.results);
+  return count;
+}
+
+void sharded_ordered_map_get_stats(struct sharded_ordered_map * map, size_t index, struct sharded_ordered_map_stats * stats){
+  assert(map != NULL);
+  assert(index < map->shard_count);
+  assert(stats != NULL);
+
+  pthread_rwlock_rdlock(&map->routing);
+  struct sharded_ordered_map_shard * shard = &map->shards[index];
+  pthread_rwlock_rdlock(&shard->lock);
+  stats->size = ordered_map_size(&shard->map);
+  stats->live_bytes = shard->memory.live;
+  stats->peak_bytes = shard->memory.peak;
+  ordered_map_get_stats(&shard->map, &stats->tree);
+  pthread_rwlock_unlock(&shard->lock);
+  pthread_rwlock_unlock(&map->routing);
+}
+
+void sharded_ordered_map_free(struct sharded_ordered_map * map){
+  assert(map != NULL);
+
+  for(size_t i = 0; i < map->shard_count; ++i){
+    ordered_map_free(&map->shards[i].map);
+    pthread_rwlock_destroy(&map->shards[i].lock);
+  }
+  if(map->copy_key != NULL){
+    for(size_t i = 0; i < map->split_count; ++i){
+      (*map->free_key)(map, map->splits[i]);
+    }
+  }
+  free(map->shards);
+  free(map->splits);
+  pthread_rwlock_destroy(&map->routing);
+  map->shards = NULL;
+  map->splits = NULL;
+  map->split_count = 0;
+  atomic_store(&map->size, 0);
+}
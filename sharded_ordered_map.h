@@ -0,0 +1,257 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHARDED_ORDERED_MAP_H
+#define SHARDED_ORDERED_MAP_H
+
+#include "memory.h"
+#include "ordered_map.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * An ordered map split by key ranges into shards, each an ordered map with its own lock, allocator and counters
+ * Point operations lock a single shard, so threads working on different shards do not contend.
+ * Shard i holds the keys in [splits[i - 1], splits[i]), the split keys are chosen from the keys of the map
+ * and moved whenever a shard grows to SHARDED_ORDERED_MAP_SKEW times its fair share of the entries.
+ * Rebalancing takes every shard at once and rebuilds them in linear time.
+ */
+
+/**
+ * The factor by which a shard may exceed the mean size of the shards before the map is rebalanced
+ */
+#define SHARDED_ORDERED_MAP_SKEW 2
+
+/**
+ * The number of entries below which the map is never rebalanced
+ */
+#define SHARDED_ORDERED_MAP_MIN_REBALANCE 1024
+
+struct sharded_ordered_map;
+
+struct task_pool;
+
+typedef int (*sharded_ordered_map_cmp_f)(const struct sharded_ordered_map *, void *, void *);
+
+typedef void (*sharded_ordered_map_free_f)(struct sharded_ordered_map *, void *);
+
+/**
+ * A function pointer type for copying keys
+ * Signature: void * fn(struct sharded_ordered_map *, void * key)
+ * Returns a copy of the key, which is freed with the free function for keys
+ */
+typedef void * (*sharded_ordered_map_copy_f)(struct sharded_ordered_map *, void *);
+
+/**
+ * A function pointer type for reading an entry under the lock of its shard
+ * Signature: void fn(struct sharded_ordered_map *, const struct ordered_map_entry * entry, void * data)
+ * Called with the entry of a key, which should not be kept nor change the map
+ */
+typedef void (*sharded_ordered_map_visit_f)(struct sharded_ordered_map *, const struct ordered_map_entry *, void *);
+
+/**
+ * A shard of a sharded ordered map
+ */
+struct sharded_ordered_map_shard{
+
+  /**
+   * Held for reading by gets and scans and for writing by inserts and deletes
+   */
+  pthread_rwlock_t lock;
+
+  /**
+   * The entries of the shard, on ORDERED_MAP_RB_TREE
+   */
+  struct ordered_map map;
+
+  /**
+   * The allocator of the nodes of the shard, which counts the memory it holds
+   */
+  struct accounting_allocator memory;
+};
+
+/**
+ * The counters of a shard
+ */
+struct sharded_ordered_map_stats{
+
+  /**
+   * The number of entries of the shard
+   */
+  size_t size;
+
+  /**
+   * The number of bytes allocated for the entries of the shard
+   */
+  size_t live_bytes;
+
+  /**
+   * The largest number of bytes the shard has held
+   */
+  size_t peak_bytes;
+
+  /**
+   * The counters of the tree of the shard since the last rebalance, all zero unless RB_TREE_STATS is defined
+   */
+  struct rb_tree_stats tree;
+};
+
+/**
+ * A sharded ordered map
+ */
+struct sharded_ordered_map{
+
+  /**
+   * The shards in the order of their keys
+   */
+  struct sharded_ordered_map_shard * shards;
+
+  /**
+   * The number of shards
+   */
+  size_t shard_count;
+
+  /**
+   * The keys splitting the shards, only the first split_count are set and the shards after split_count are empty
+   */
+  void ** splits;
+
+  /**
+   * The number of split keys
+   */
+  size_t split_count;
+
+  /**
+   * Held for reading by all operations and for writing while the split keys change
+   */
+  pthread_rwlock_t routing;
+
+  /**
+   * The number of entries in the map
+   */
+  atomic_size_t size;
+
+  /**
+   * The number of times the map was rebalanced
+   */
+  atomic_size_t rebalances;
+
+  /**
+   * The task pool scans fan out on or NULL
+   */
+  struct task_pool * tasks;
+
+  sharded_ordered_map_cmp_f cmp;
+  sharded_ordered_map_copy_f copy_key;
+  sharded_ordered_map_free_f free_key;
+  sharded_ordered_map_free_f free_value;
+  void * state;
+};
+
+/**
+ * Initializes an empty sharded map
+ * @param map the map
+ * @param shard_count the number of shards, at least 1
+ * @param cmp the comparison function for keys, which must be thread safe
+ * @param copy_key the function copying keys to use as split keys, or NULL if keys are used as split keys as they are,
+ * which requires free_key to be NULL, and then every key inserted must stay valid until the map is freed, even after it is deleted
+ * @param free_key the free function for keys or NULL
+ * @param free_value the free function for values or NULL
+ * @param state extra state for the map
+ */
+void sharded_ordered_map_init(struct sharded_ordered_map * map, size_t shard_count, sharded_ordered_map_cmp_f cmp, sharded_ordered_map_copy_f copy_key, sharded_ordered_map_free_f free_key, sharded_ordered_map_free_f free_value, void * state);
+
+/**
+ * Sets the task pool scans fan out on
+ * @param map the map
+ * @param tasks the task pool or NULL to scan the shards on the calling thread
+ */
+void sharded_ordered_map_set_task_pool(struct sharded_ordered_map * map, struct task_pool * tasks);
+
+/**
+ * Inserts an entry, replacing and freeing an entry with an equal key, and rebalances the map if the shard of the key grew too large
+ * @return true if an entry was replaced
+ */
+bool sharded_ordered_map_insert(struct sharded_ordered_map * map, void * key, void * value);
+
+/**
+ * Deletes and frees the entry with a key
+ * @return true if an entry was deleted
+ */
+bool sharded_ordered_map_delete(struct sharded_ordered_map * map, void * key);
+
+/**
+ * Returns the value of a key
+ * If the map has a free function for values, the value is freed as soon as another thread replaces or deletes the key,
+ * so values other threads may change should be read with sharded_ordered_map_visit instead.
+ * @return the value or NULL
+ */
+void * sharded_ordered_map_get(struct sharded_ordered_map * map, void * key);
+
+/**
+ * Calls a function with the entry of a key while holding the lock of its shard, so the entry stays valid during the call
+ * @param map the map
+ * @param key the key
+ * @param visit the function reading the entry
+ * @param data the argument of visit
+ * @return true if the key was found and visited
+ */
+bool sharded_ordered_map_visit(struct sharded_ordered_map * map, void * key, sharded_ordered_map_visit_f visit, void * data);
+
+/**
+ * Returns the number of entries of the map
+ */
+size_t sharded_ordered_map_size(struct sharded_ordered_map * map);
+
+/**
+ * Collects the entries with keys in the range [low, high) in order
+ * Each shard overlapping the range is scanned by its own task if the map has a task pool, the results are concatenated in shard order
+ * Scans on the same task pool run one at a time.
+ * @param map the map
+ * @param low the inclusive lower bound
+ * @param high the exclusive upper bound
+ * @param entries set to an array of copies of the entries, to be released with free, or NULL if there are none.
+ * The copies share their keys and values with the map, which frees them as soon as another thread replaces or deletes their keys.
+ * @return the number of entries
+ */
+size_t sharded_ordered_map_scan(struct sharded_ordered_map * map, void * low, void * high, struct ordered_map_entry ** entries);
+
+/**
+ * Moves the split keys so the shards hold equal numbers of entries, in linear time
+ * @param map the map
+ */
+void sharded_ordered_map_rebalance(struct sharded_ordered_map * map);
+
+/**
+ * Copies the counters of a shard
+ * @param map the map
+ * @param index the index of the shard
+ * @param stats set to the counters
+ */
+void sharded_ordered_map_get_stats(struct sharded_ordered_map * map, size_t index, struct sharded_ordered_map_stats * stats);
+
+/**
+ * Frees all entries and split keys of the map, which must not be used by other threads anymore
+ * @param map the map
+ */
+void sharded_ordered_map_free(struct sharded_ordered_map * map);
+
+#endif
@@ -0,0 +1,676 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "memory.h"
+#include "skip_list.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of retired items after which a thread tries to advance the epoch and free its garbage
+ */
+#define RECLAIM_PERIOD 64
+
+/**
+ * The number of lists a thread remembers its reclamation state for
+ */
+#define THREAD_CACHE_SIZE 8
+
+/**
+ * The number of times a lock is polled before yielding the processor
+ */
+#define LOCK_SPINS 64
+
+struct skip_list_node{
+
+  /**
+   * Whether the node is locked by an insert or delete
+   */
+  atomic_bool locked;
+
+  /**
+   * Whether the node is logically deleted
+   */
+  atomic_bool marked;
+
+  /**
+   * Whether the node is linked at all of its levels
+   */
+  atomic_bool linked;
+
+  /**
+   * The number of levels of the node
+   */
+  unsigned char height;
+
+  /**
+   * The first word of the value, which extends over the following bytes and is followed by height next pointers
+   */
+  void * value;
+};
+
+/**
+ * A link to the next node at some level
+ */
+typedef _Atomic(struct skip_list_node *) skip_list_link;
+
+/**
+ * Data waiting to be freed
+ */
+struct skip_list_garbage{
+
+  /**
+   * The next item
+   */
+  struct skip_list_garbage * next;
+
+  /**
+   * The global epoch when the data was retired
+   */
+  uint64_t epoch;
+
+  /**
+   * The data
+   */
+  void * data;
+
+  /**
+   * The function freeing the data
+   */
+  skip_list_free_f free_data;
+};
+
+struct skip_list_thread{
+
+  /**
+   * The next state in the list of all thread states, never changed once published
+   */
+  struct skip_list_thread * next;
+
+  /**
+   * The thread owning the state
+   */
+  pthread_t owner;
+
+  /**
+   * 0 while the thread is outside any critical section, the global epoch it observed plus one otherwise
+   */
+  atomic_uint_fast64_t epoch;
+
+  /**
+   * The nesting depth of the critical sections of the thread
+   */
+  size_t depth;
+
+  /**
+   * The data retired by the thread, newest first
+   */
+  struct skip_list_garbage * garbage;
+
+  /**
+   * The number of items in the garbage list
+   */
+  size_t garbage_count;
+
+  /**
+   * The state of the generator for node heights
+   */
+  uint64_t random;
+};
+
+/**
+ * A remembered reclamation state
+ */
+struct thread_cache_entry{
+
+  /**
+   * The id of the list
+   */
+  uint64_t id;
+
+  /**
+   * The state of the current thread for the list
+   */
+  struct skip_list_thread * thread;
+};
+
+/**
+ * The states of the current thread for the lists it used last
+ */
+static _Thread_local struct thread_cache_entry thread_cache[THREAD_CACHE_SIZE];
+
+/**
+ * The next entry of the cache to replace
+ */
+static _Thread_local size_t thread_cache_next = 0;
+
+/**
+ * The id of the next list to be created, ids are never reused so stale cache entries cannot match
+ */
+static atomic_uint_fast64_t next_list_id = 1;
+
+/*
+ * Helper methods
+ */
+
+static inline skip_list_link * get_next(const struct skip_list * list, struct skip_list_node * node){
+  return (skip_list_link *)((char *)node + list->next_offset);
+}
+
+static inline struct skip_list_node * load_next(const struct skip_list * list, struct skip_list_node * node, size_t level){
+  return atomic_load_explicit(&get_next(list, node)[level], memory_order_acquire);
+}
+
+static inline void * get_node_value(struct skip_list_node * node){
+  return &node->value;
+}
+
+static inline struct skip_list_node * get_value_node(void * value){
+  return (struct skip_list_node *)((char *)value - offsetof(struct skip_list_node, value));
+}
+
+/**
+ * Compares the value of a node to a value, NULL being the end of a level and greater than all values
+ */
+static inline int cmp_node(const struct skip_list * list, struct skip_list_node * node, void * value){
+  if(node == NULL){
+    return 1;
+  }else{
+    return (*list->cmp_value)(list, get_node_value(node), value);
+  }
+}
+
+static void default_free_value(struct skip_list * list, void * value){}
+
+static struct skip_list_node * alloc_node(struct skip_list * list, size_t height){
+  struct skip_list_node * node = malloc_checked(list->next_offset + height * sizeof(skip_list_link));
+  atomic_init(&node->locked, false);
+  atomic_init(&node->marked, false);
+  atomic_init(&node->linked, false);
+  node->height = (unsigned char)height;
+  for(size_t level = 0; level < height; ++level){
+    atomic_init(&get_next(list, node)[level], NULL);
+  }
+  return node;
+}
+
+/**
+ * Frees a node and its value, used as the free function of retired nodes
+ */
+static void free_node(struct skip_list * list, void * data){
+  struct skip_list_node * node = (struct skip_list_node *)data;
+  (*list->free_value)(list, get_node_value(node));
+  free(node);
+}
+
+static void lock_node(struct skip_list_node * node){
+  while(atomic_exchange_explicit(&node->locked, true, memory_order_acquire)){
+    for(size_t spins = 0; atomic_load_explicit(&node->locked, memory_order_relaxed); ++spins){
+      if(spins >= LOCK_SPINS){
+	sched_yield();
+      }
+    }
+  }
+}
+
+static void unlock_node(struct skip_list_node * node){
+  atomic_store_explicit(&node->locked, false, memory_order_release);
+}
+
+/**
+ * Unlocks the distinct predecessors locked at levels 0 up to and including highest
+ */
+static void unlock_preds(struct skip_list_node ** preds, int highest){
+  for(int level = 0; level <= highest; ++level){
+    if(level == 0 || preds[level] != preds[level - 1]){
+      unlock_node(preds[level]);
+    }
+  }
+}
+
+/*
+ * Reclamation
+ */
+
+/**
+ * Returns the reclamation state of the current thread for a list, creating it on first use
+ */
+static struct skip_list_thread * get_thread(struct skip_list * list){
+  for(size_t i = 0; i < THREAD_CACHE_SIZE; ++i){
+    if(thread_cache[i].id == list->id){
+      return thread_cache[i].thread;
+    }
+  }
+
+  pthread_t self = pthread_self();
+  struct skip_list_thread * thread = atomic_load(&list->threads);
+  while(thread != NULL && !pthread_equal(thread->owner, self)){
+    thread = thread->next;
+  }
+  if(thread == NULL){
+    // states are never removed while the list exists, a state left by a finished thread is taken over by its successor
+    thread = malloc_checked(sizeof(struct skip_list_thread));
+    thread->owner = self;
+    atomic_init(&thread->epoch, 0);
+    thread->depth = 0;
+    thread->garbage = NULL;
+    thread->garbage_count = 0;
+    thread->random = (uint64_t)(uintptr_t)thread * 0x9e3779b97f4a7c15ULL | 1;
+    thread->next = atomic_load(&list->threads);
+    while(!atomic_compare_exchange_weak(&list->threads, &thread->next, thread));
+  }
+
+  thread_cache[thread_cache_next].id = list->id;
+  thread_cache[thread_cache_next].thread = thread;
+  thread_cache_next = (thread_cache_next + 1) % THREAD_CACHE_SIZE;
+  return thread;
+}
+
+/**
+ * Advances the global epoch if every thread inside a critical section has observed it
+ */
+static void try_advance(struct skip_list * list){
+  uint_fast64_t epoch = atomic_load(&list->epoch);
+  for(struct skip_list_thread * thread = atomic_load(&list->threads); thread != NULL; thread = thread->next){
+    uint_fast64_t local = atomic_load(&thread->epoch);
+    if(local != 0 && local != epoch + 1){
+      return;
+    }
+  }
+  atomic_compare_exchange_strong(&list->epoch, &epoch, epoch + 1);
+}
+
+/**
+ * Frees the garbage of a thread retired at least two epochs ago
+ * Any thread that could still see such data has left its critical section since
+ */
+static void reclaim(struct skip_list * list, struct skip_list_thread * thread){
+  try_advance(list);
+  uint_fast64_t epoch = atomic_load(&list->epoch);
+  struct skip_list_garbage ** link = &thread->garbage;
+  while(*link != NULL){
+    struct skip_list_garbage * garbage = *link;
+    if(garbage->epoch + 2 <= epoch){
+      *link = garbage->next;
+      (*garbage->free_data)(list, garbage->data);
+      free(garbage);
+      --thread->garbage_count;
+    }else{
+      link = &garbage->next;
+    }
+  }
+}
+
+void skip_list_pin(struct skip_list * list){
+  assert(list != NULL);
+
+  struct skip_list_thread * thread = get_thread(list);
+  if(thread->depth++ == 0){
+    atomic_store(&thread->epoch, atomic_load(&list->epoch) + 1);
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+}
+
+void skip_list_unpin(struct skip_list * list){
+  assert(list != NULL);
+
+  struct skip_list_thread * thread = get_thread(list);
+  assert(thread->depth > 0);
+  if(--thread->depth == 0){
+    atomic_store(&thread->epoch, 0);
+  }
+}
+
+void skip_list_retire(struct skip_list * list, void * data, skip_list_free_f free_data){
+  assert(list != NULL);
+  assert(free_data != NULL);
+
+  struct skip_list_thread * thread = get_thread(list);
+  struct skip_list_garbage * garbage = malloc_checked(sizeof(struct skip_list_garbage));
+  garbage->epoch = atomic_load(&list->epoch);
+  garbage->data = data;
+  garbage->free_data = free_data;
+  garbage->next = thread->garbage;
+  thread->garbage = garbage;
+  if(++thread->garbage_count >= RECLAIM_PERIOD){
+    reclaim(list, thread);
+  }
+}
+
+/*
+ * Initialization
+ */
+
+void skip_list_init(struct skip_list * list, skip_list_cmp_f cmp_value, skip_list_free_f free_value, void * state, size_t value_size){
+  assert(list != NULL);
+  assert(cmp_value != NULL);
+  assert(value_size > 0);
+
+  list->cmp_value = cmp_value;
+  if(free_value == NULL){
+    list->free_value = default_free_value;
+  }else{
+    list->free_value = free_value;
+  }
+  list->state = state;
+  list->value_size = value_size;
+  size_t end = offsetof(struct skip_list_node, value) + (value_size < sizeof(void *) ? sizeof(void *) : value_size);
+  list->next_offset = (end + sizeof(skip_list_link) - 1) / sizeof(skip_list_link) * sizeof(skip_list_link);
+  list->id = atomic_fetch_add(&next_list_id, 1);
+  atomic_init(&list->epoch, 0);
+  atomic_init(&list->threads, NULL);
+  atomic_init(&list->height, 1);
+  atomic_init(&list->size, 0);
+  list->head = alloc_node(list, SKIP_LIST_MAX_HEIGHT);
+  atomic_init(&list->head->linked, true);
+}
+
+/*
+ * Finding values
+ */
+
+/**
+ * Finds the predecessors and successors of a value at every level
+ * @return the highest level at which a node equal to the value was found or -1
+ */
+static int find_node(const struct skip_list * list, void * value, struct skip_list_node ** preds, struct skip_list_node ** succs){
+  int found = -1;
+  struct skip_list_node * pred = list->head;
+  for(int level = SKIP_LIST_MAX_HEIGHT - 1; level >= 0; --level){
+    struct skip_list_node * curr = load_next(list, pred, (size_t)level);
+    int cmp;
+    while((cmp = cmp_node(list, curr, value)) < 0){
+      pred = curr;
+      curr = load_next(list, pred, (size_t)level);
+    }
+    if(found == -1 && cmp == 0){
+      found = level;
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return found;
+}
+
+/**
+ * Checks whether a node is fully inserted and not deleted
+ */
+static inline bool is_present(struct skip_list_node * node){
+  return atomic_load_explicit(&node->linked, memory_order_acquire) && !atomic_load_explicit(&node->marked, memory_order_acquire);
+}
+
+void * skip_list_find(struct skip_list * list, void * value){
+  assert(list != NULL);
+
+  skip_list_pin(list);
+  void * found = NULL;
+  struct skip_list_node * pred = list->head;
+  for(size_t level = atomic_load_explicit(&list->height, memory_order_relaxed); level-- > 0;){
+    struct skip_list_node * curr = load_next(list, pred, level);
+    int cmp;
+    while((cmp = cmp_node(list, curr, value)) < 0){
+      pred = curr;
+      curr = load_next(list, pred, level);
+    }
+    if(cmp == 0){
+      found = is_present(curr) ? get_node_value(curr) : NULL;
+      break;
+    }
+  }
+  skip_list_unpin(list);
+  return found;
+}
+
+/**
+ * Returns the first present node at or after a node at the lowest level
+ */
+static struct skip_list_node * skip_absent(const struct skip_list * list, struct skip_list_node * node){
+  while(node != NULL && !is_present(node)){
+    node = load_next(list, node, 0);
+  }
+  return node;
+}
+
+void * skip_list_lower_bound(struct skip_list * list, void * value){
+  assert(list != NULL);
+
+  skip_list_pin(list);
+  struct skip_list_node * pred = list->head;
+  struct skip_list_node * curr = NULL;
+  for(size_t level = atomic_load_explicit(&list->height, memory_order_relaxed); level-- > 0;){
+    curr = load_next(list, pred, level);
+    while(cmp_node(list, curr, value) < 0){
+      pred = curr;
+      curr = load_next(list, pred, level);
+    }
+  }
+  curr = skip_absent(list, curr);
+  skip_list_unpin(list);
+  return curr == NULL ? NULL : get_node_value(curr);
+}
+
+void * skip_list_get_begin(struct skip_list * list){
+  assert(list != NULL);
+
+  skip_list_pin(list);
+  struct skip_list_node * node = skip_absent(list, load_next(list, list->head, 0));
+  skip_list_unpin(list);
+  return node == NULL ? NULL : get_node_value(node);
+}
+
+void * skip_list_get_next(struct skip_list * list, void * value){
+  assert(list != NULL);
+  assert(value != NULL);
+
+  skip_list_pin(list);
+  struct skip_list_node * node = skip_absent(list, load_next(list, get_value_node(value), 0));
+  skip_list_unpin(list);
+  return node == NULL ? NULL : get_node_value(node);
+}
+
+size_t skip_list_size(const struct skip_list * list){
+  assert(list != NULL);
+  return atomic_load_explicit(&list->size, memory_order_relaxed);
+}
+
+/*
+ * Insertion and deletion
+ */
+
+/**
+ * Returns a random height, each level being present with probability 1/4
+ */
+static size_t get_random_height(struct skip_list_thread * thread){
+  uint64_t x = thread->random;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  thread->random = x;
+  return 1 + (size_t)__builtin_ctzll(x | (1ULL << (2 * (SKIP_LIST_MAX_HEIGHT - 1)))) / 2;
+}
+
+void * skip_list_insert(struct skip_list * list, void * value, bool * inserted){
+  assert(list != NULL);
+  assert(inserted != NULL);
+
+  struct skip_list_node * preds[SKIP_LIST_MAX_HEIGHT];
+  struct skip_list_node * succs[SKIP_LIST_MAX_HEIGHT];
+  skip_list_pin(list);
+  size_t height = get_random_height(get_thread(list));
+  struct skip_list_node * node = NULL;
+
+  for(;;){
+    int found = find_node(list, value, preds, succs);
+    if(found != -1){
+      struct skip_list_node * existing = succs[found];
+      if(!atomic_load_explicit(&existing->marked, memory_order_acquire)){
+	while(!atomic_load_explicit(&existing->linked, memory_order_acquire)){
+	  sched_yield();
+	}
+	free(node);
+	skip_list_unpin(list);
+	*inserted = false;
+	return get_node_value(existing);
+      }
+      // the existing node is being deleted, wait for it to be unlinked
+      sched_yield();
+      continue;
+    }
+
+    int highest = -1;
+    bool valid = true;
+    for(size_t level = 0; valid && level < height; ++level){
+      struct skip_list_node * pred = preds[level];
+      struct skip_list_node * succ = succs[level];
+      if(level == 0 || pred != preds[level - 1]){
+	lock_node(pred);
+      }
+      highest = (int)level;
+      valid = !atomic_load(&pred->marked)
+	&& (succ == NULL || !atomic_load(&succ->marked))
+	&& load_next(list, pred, level) == succ;
+    }
+    if(!valid){
+      unlock_preds(preds, highest);
+      continue;
+    }
+
+    if(node == NULL){
+      node = alloc_node(list, height);
+      memcpy(get_node_value(node), value, list->value_size);
+    }
+    for(size_t level = 0; level < height; ++level){
+      atomic_store_explicit(&get_next(list, node)[level], succs[level], memory_order_relaxed);
+    }
+    for(size_t level = 0; level < height; ++level){
+      atomic_store_explicit(&get_next(list, preds[level])[level], node, memory_order_release);
+    }
+    atomic_store_explicit(&node->linked, true, memory_order_release);
+    unlock_preds(preds, highest);
+    break;
+  }
+
+  size_t list_height = atomic_load(&list->height);
+  while(list_height < height && !atomic_compare_exchange_weak(&list->height, &list_height, height));
+  atomic_fetch_add_explicit(&list->size, 1, memory_order_relaxed);
+  skip_list_unpin(list);
+  *inserted = true;
+  return get_node_value(node);
+}
+
+bool skip_list_delete(struct skip_list * list, void * value){
+  assert(list != NULL);
+
+  struct skip_list_node * preds[SKIP_LIST_MAX_HEIGHT];
+  struct skip_list_node * succs[SKIP_LIST_MAX_HEIGHT];
+  struct skip_list_node * victim = NULL;
+  skip_list_pin(list);
+
+  for(;;){
+    int found = find_node(list, value, preds, succs);
+    if(victim == NULL){
+      if(found == -1){
+	skip_list_unpin(list);
+	return false;
+      }
+      struct skip_list_node * candidate = succs[found];
+      if(!atomic_load(&candidate->linked) || candidate->height != (size_t)found + 1 || atomic_load(&candidate->marked)){
+	// an insert that is not complete yet has not taken effect, a marked node is deleted by another thread
+	skip_list_unpin(list);
+	return false;
+      }
+      lock_node(candidate);
+      if(atomic_load(&candidate->marked)){
+	unlock_node(candidate);
+	skip_list_unpin(list);
+	return false;
+      }
+      atomic_store(&candidate->marked, true);
+      victim = candidate;
+    }
+
+    int highest = -1;
+    bool valid = true;
+    for(size_t level = 0; valid && level < victim->height; ++level){
+      struct skip_list_node * pred = preds[level];
+      if(level == 0 || pred != preds[level - 1]){
+	lock_node(pred);
+      }
+      highest = (int)level;
+      valid = !atomic_load(&pred->marked) && load_next(list, pred, level) == victim;
+    }
+    if(!valid){
+      unlock_preds(preds, highest);
+      continue;
+    }
+
+    for(size_t level = victim->height; level-- > 0;){
+      atomic_store_explicit(&get_next(list, preds[level])[level], load_next(list, victim, level), memory_order_release);
+    }
+    unlock_node(victim);
+    unlock_preds(preds, highest);
+    break;
+  }
+
+  atomic_fetch_sub_explicit(&list->size, 1, memory_order_relaxed);
+  skip_list_retire(list, victim, &free_node);
+  skip_list_unpin(list);
+  return true;
+}
+
+/*
+ * Freeing
+ */
+
+void skip_list_reclaim_all(struct skip_list * list){
+  assert(list != NULL);
+
+  for(struct skip_list_thread * thread = atomic_load(&list->threads); thread != NULL; thread = thread->next){
+    while(thread->garbage != NULL){
+      struct skip_list_garbage * garbage = thread->garbage;
+      thread->garbage = garbage->next;
+      (*garbage->free_data)(list, garbage->data);
+      free(garbage);
+    }
+    thread->garbage_count = 0;
+  }
+}
+
+void skip_list_free(struct skip_list * list){
+  assert(list != NULL);
+
+  struct skip_list_node * node = load_next(list, list->head, 0);
+  while(node != NULL){
+    struct skip_list_node * next = load_next(list, node, 0);
+    free_node(list, node);
+    node = next;
+  }
+  free(list->head);
+
+  skip_list_reclaim_all(list);
+  struct skip_list_thread * thread = atomic_load(&list->threads);
+  while(thread != NULL){
+    struct skip_list_thread * next = thread->next;
+    free(thread);
+    thread = next;
+  }
+}
@@ -0,0 +1,225 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SKIP_LIST_H
+#define SKIP_LIST_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A concurrent skip list, after Herlihy et al., "A Simple Optimistic Skiplist Algorithm"
+ * Lookups never block: they traverse the list without taking locks or writing shared memory.
+ * Inserts and deletes lock only the predecessors of the node they link or unlink.
+ * Removed nodes are freed once no thread can still be traversing them, using epoch based reclamation.
+ * Values are stored inline in the nodes, like rb_tree_set_inline_values.
+ */
+
+/**
+ * The largest number of levels of a skip list
+ */
+#define SKIP_LIST_MAX_HEIGHT 32
+
+/**
+ * A node in the skip list
+ */
+struct skip_list_node;
+
+/**
+ * The reclamation state of a thread using a skip list
+ */
+struct skip_list_thread;
+
+struct skip_list;
+
+/**
+ * A function pointer type for the comparison function used in the skip list
+ * Signature: int fn(const struct skip_list *, void * first, void * second)
+ * Must be thread safe
+ */
+typedef int (*skip_list_cmp_f)(const struct skip_list *, void *, void *);
+
+/**
+ * A function pointer type for freeing values and retired data
+ * Signature: void fn(struct skip_list *, void * data)
+ * May be called from any thread using the list
+ */
+typedef void (*skip_list_free_f)(struct skip_list *, void *);
+
+struct skip_list{
+
+  /**
+   * The sentinel node before all others, of maximum height
+   */
+  struct skip_list_node * head;
+
+  /**
+   * The number of levels in use, a hint for where lookups start
+   */
+  atomic_size_t height;
+
+  /**
+   * The number of values in the list
+   */
+  atomic_size_t size;
+
+  /**
+   * The comparison function
+   */
+  skip_list_cmp_f cmp_value;
+
+  /**
+   * The free function for values
+   */
+  skip_list_free_f free_value;
+
+  /**
+   * Extra state for the list
+   */
+  void * state;
+
+  /**
+   * The size of a value in bytes
+   */
+  size_t value_size;
+
+  /**
+   * The offset of the next pointers in a node
+   */
+  size_t next_offset;
+
+  /**
+   * A number identifying the list among all lists created by the program
+   */
+  uint64_t id;
+
+  /**
+   * The global epoch
+   */
+  atomic_uint_fast64_t epoch;
+
+  /**
+   * The reclamation states of all threads that used the list
+   */
+  _Atomic(struct skip_list_thread *) threads;
+};
+
+/**
+ * Initializes an empty skip list
+ * @param list the list
+ * @param cmp_value the comparison function
+ * @param free_value the free function for values or NULL
+ * @param state extra state for the list
+ * @param value_size the size of a value in bytes
+ */
+void skip_list_init(struct skip_list * list, skip_list_cmp_f cmp_value, skip_list_free_f free_value, void * state, size_t value_size);
+
+/**
+ * Enters a read side critical section
+ * Values found by the calling thread stay allocated until it leaves the critical section, even if they are deleted concurrently.
+ * Critical sections may nest and are entered by all other functions as needed.
+ * @param list the list
+ */
+void skip_list_pin(struct skip_list * list);
+
+/**
+ * Leaves a read side critical section entered with skip_list_pin
+ * @param list the list
+ */
+void skip_list_unpin(struct skip_list * list);
+
+/**
+ * Inserts a copy of a value unless an equal value is in the list
+ * @param list the list
+ * @param value the value to copy
+ * @param inserted set to true if the value was inserted, false if an equal value was found
+ * @return the value in the list, either the new copy or the existing equal value
+ */
+void * skip_list_insert(struct skip_list * list, void * value, bool * inserted);
+
+/**
+ * Deletes the value equal to a value from the list
+ * The value is freed once no thread can be reading it
+ * @param list the list
+ * @param value the value to delete
+ * @return true if a value was deleted
+ */
+bool skip_list_delete(struct skip_list * list, void * value);
+
+/**
+ * Finds the value equal to a value without blocking
+ * @param list the list
+ * @param value the value to find
+ * @return the value in the list or NULL
+ */
+void * skip_list_find(struct skip_list * list, void * value);
+
+/**
+ * Finds the first value not smaller than a value
+ * @param list the list
+ * @param value the value
+ * @return the value in the list or NULL
+ */
+void * skip_list_lower_bound(struct skip_list * list, void * value);
+
+/**
+ * Returns the first value of the list
+ * @param list the list
+ * @return the value or NULL if the list is empty
+ */
+void * skip_list_get_begin(struct skip_list * list);
+
+/**
+ * Returns the value following a value of the list, skipping deleted values
+ * @param list the list
+ * @param value a value in the list
+ * @return the next value or NULL
+ */
+void * skip_list_get_next(struct skip_list * list, void * value);
+
+/**
+ * Returns the number of values in the list
+ * The count is exact when no updates are in progress
+ * @param list the list
+ * @return the number of values
+ */
+size_t skip_list_size(const struct skip_list * list);
+
+/**
+ * Frees data once no thread can be reading it, for data that was reachable from a value of the list
+ * @param list the list
+ * @param data the data
+ * @param free_data the function freeing the data
+ */
+void skip_list_retire(struct skip_list * list, void * data, skip_list_free_f free_data);
+
+/**
+ * Frees all retired data at once, must not run concurrently with any other use of the list
+ * @param list the list
+ */
+void skip_list_reclaim_all(struct skip_list * list);
+
+/**
+ * Frees all nodes and values of the list, must not run concurrently with any other use of the list
+ * @param list the list
+ */
+void skip_list_free(struct skip_list * list);
+
+#endif
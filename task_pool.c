@@ -0,0 +1,325 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "task_pool.h"
+#include "memory.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * The largest number of forked tasks a worker can have outstanding
+ * Fork join recursion over balanced trees stays far below this
+ */
+#define TASK_DEQUE_CAPACITY 256
+
+/**
+ * A forked task, living on the stack of the worker that forked it
+ */
+struct task{
+
+  /**
+   * The function to run
+   */
+  task_f function;
+
+  /**
+   * The argument of the function
+   */
+  void * data;
+
+  /**
+   * Set once a thief has finished running the task
+   */
+  atomic_bool done;
+};
+
+struct task_worker{
+
+  /**
+   * The pool of the worker
+   */
+  struct task_pool * pool;
+
+  /**
+   * Protects the deque
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * The deque of forked tasks, stolen from the top and popped from the bottom
+   */
+  struct task * tasks[TASK_DEQUE_CAPACITY];
+
+  /**
+   * The index of the oldest task
+   */
+  size_t top;
+
+  /**
+   * The index one past the newest task
+   */
+  size_t bottom;
+
+  /**
+   * The state of the generator used to pick victims
+   */
+  uint64_t random;
+};
+
+/**
+ * The worker run by the current thread or NULL
+ */
+static _Thread_local struct task_worker * current_worker = NULL;
+
+/*
+ * Deques
+ */
+
+/**
+ * Pushes a task on the bottom of the deque of a worker
+ * @return false if the deque is full
+ */
+static bool push_task(struct task_worker * worker, struct task * task){
+  bool pushed = false;
+  pthread_mutex_lock(&worker->mutex);
+  if(worker->bottom < TASK_DEQUE_CAPACITY){
+    worker->tasks[worker->bottom++] = task;
+    pushed = true;
+  }
+  pthread_mutex_unlock(&worker->mutex);
+  return pushed;
+}
+
+/**
+ * Pops the newest task of a worker, which should be the task it pushed last
+ * @return false if the task was stolen
+ */
+static bool pop_task(struct task_worker * worker, struct task * task){
+  bool popped = false;
+  pthread_mutex_lock(&worker->mutex);
+  if(worker->bottom > worker->top){
+    assert(worker->tasks[worker->bottom - 1] == task);
+    --worker->bottom;
+    popped = true;
+  }
+  if(worker->bottom == worker->top){
+    worker->top = 0;
+    worker->bottom = 0;
+  }
+  pthread_mutex_unlock(&worker->mutex);
+  return popped;
+}
+
+/**
+ * Takes the oldest task of a worker
+ * @return the task or NULL if the deque is empty
+ */
+static struct task * steal_task(struct task_worker * victim){
+  struct task * task = NULL;
+  pthread_mutex_lock(&victim->mutex);
+  if(victim->top < victim->bottom){
+    task = victim->tasks[victim->top++];
+  }
+  pthread_mutex_unlock(&victim->mutex);
+  return task;
+}
+
+/*
+ * Running tasks
+ */
+
+/**
+ * Returns the next value of a xorshift generator
+ */
+static uint64_t next_random(uint64_t * state){
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+/**
+ * Tries to steal a task from another worker, starting at a random victim, and runs it
+ * @return true if a task was run
+ */
+static bool run_stolen_task(struct task_worker * worker){
+  struct task_pool * pool = worker->pool;
+  size_t start = (size_t)(next_random(&worker->random) % pool->thread_count);
+  for(size_t i = 0; i < pool->thread_count; ++i){
+    struct task_worker * victim = &pool->workers[(start + i) % pool->thread_count];
+    if(victim != worker){
+      struct task * task = steal_task(victim);
+      if(task != NULL){
+	(*task->function)(task->data);
+	atomic_store_explicit(&task->done, true, memory_order_release);
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * The main loop of a worker thread
+ * Sleeps until a task is run on the pool, then steals work until it finishes
+ */
+static void * run_worker(void * data){
+  struct task_worker * worker = (struct task_worker *)data;
+  struct task_pool * pool = worker->pool;
+  current_worker = worker;
+
+  for(;;){
+    pthread_mutex_lock(&pool->mutex);
+    while(!pool->stopping && !atomic_load(&pool->active)){
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    bool stopping = pool->stopping;
+    pthread_mutex_unlock(&pool->mutex);
+    if(stopping){
+      return NULL;
+    }
+
+    while(atomic_load_explicit(&pool->active, memory_order_relaxed)){
+      if(!run_stolen_task(worker)){
+	sched_yield();
+      }
+    }
+  }
+}
+
+void task_pool_fork_join(struct task_pool * pool, task_f first, void * first_data, task_f second, void * second_data){
+  assert(pool != NULL);
+  assert(first != NULL);
+  assert(second != NULL);
+
+  struct task_worker * worker = current_worker;
+  struct task task = {second, second_data, false};
+  if(worker == NULL || worker->pool != pool || !push_task(worker, &task)){
+    (*first)(first_data);
+    (*second)(second_data);
+    return;
+  }
+
+  (*first)(first_data);
+  if(pop_task(worker, &task)){
+    (*second)(second_data);
+  }else{
+    // help out until the thief is done
+    while(!atomic_load_explicit(&task.done, memory_order_acquire)){
+      if(!run_stolen_task(worker)){
+	sched_yield();
+      }
+    }
+  }
+}
+
+void task_pool_run(struct task_pool * pool, task_f task, void * data){
+  assert(pool != NULL);
+  assert(task != NULL);
+
+  if(current_worker != NULL && current_worker->pool == pool){
+    // already running on this pool
+    (*task)(data);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->run_mutex);
+  struct task_worker * previous = current_worker;
+  current_worker = &pool->workers[0];
+
+  pthread_mutex_lock(&pool->mutex);
+  atomic_store(&pool->active, true);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  // every forked task has been joined once the task returns
+  (*task)(data);
+
+  atomic_store(&pool->active, false);
+  current_worker = previous;
+  pthread_mutex_unlock(&pool->run_mutex);
+}
+
+/*
+ * Initialization and destruction
+ */
+
+void task_pool_init(struct task_pool * pool, size_t thread_count){
+  assert(pool != NULL);
+
+  if(thread_count == 0){
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = online > 0 ? (size_t)online : 1;
+  }
+  pool->thread_count = thread_count;
+  pool->workers = malloc_checked(thread_count * sizeof(struct task_worker));
+  pool->threads = malloc_checked(thread_count * sizeof(pthread_t));
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_mutex_init(&pool->run_mutex, NULL);
+  atomic_init(&pool->active, false);
+  pool->stopping = false;
+
+  for(size_t i = 0; i < thread_count; ++i){
+    struct task_worker * worker = &pool->workers[i];
+    worker->pool = pool;
+    pthread_mutex_init(&worker->mutex, NULL);
+    worker->top = 0;
+    worker->bottom = 0;
+    worker->random = 0x9e3779b97f4a7c15ULL * (i + 1);
+  }
+  for(size_t i = 1; i < thread_count; ++i){
+    if(pthread_create(&pool->threads[i], NULL, &run_worker, &pool->workers[i]) != 0){
+      fputs("unable to start thread", stderr);
+      exit(-1);
+    }
+  }
+}
+
+size_t task_pool_get_thread_count(const struct task_pool * pool){
+  assert(pool != NULL);
+  return pool->thread_count;
+}
+
+void task_pool_destroy(struct task_pool * pool){
+  assert(pool != NULL);
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+  for(size_t i = 1; i < pool->thread_count; ++i){
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  for(size_t i = 0; i < pool->thread_count; ++i){
+    pthread_mutex_destroy(&pool->workers[i].mutex);
+  }
+  pthread_mutex_destroy(&pool->run_mutex);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool->threads);
+  free(pool->workers);
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A pool of worker threads running fork join tasks
+ * Every worker owns a deque of forked tasks: it pushes and pops tasks at the bottom,
+ * idle workers steal the oldest, and therefore largest, tasks from the top of the deques of others
+ */
+
+/**
+ * A function run as a task
+ */
+typedef void (*task_f)(void *);
+
+/**
+ * The state of a single worker
+ */
+struct task_worker;
+
+struct task_pool{
+
+  /**
+   * The number of workers, including the thread calling task_pool_run
+   */
+  size_t thread_count;
+
+  /**
+   * The workers, the first of which is taken by the thread calling task_pool_run
+   */
+  struct task_worker * workers;
+
+  /**
+   * The threads of all workers but the first
+   */
+  pthread_t * threads;
+
+  /**
+   * Protects stopping and is held while sleeping on wake
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Signalled when active or stopping changes
+   */
+  pthread_cond_t wake;
+
+  /**
+   * Serializes calls to task_pool_run
+   */
+  pthread_mutex_t run_mutex;
+
+  /**
+   * Whether a task is running, idle workers only look for work while it is
+   */
+  atomic_bool active;
+
+  /**
+   * Whether the workers should exit
+   */
+  bool stopping;
+};
+
+/**
+ * Initializes a task pool and starts its threads or exits the program
+ * @param pool the pool
+ * @param thread_count the number of workers or 0 to use one per online processor
+ */
+void task_pool_init(struct task_pool * pool, size_t thread_count);
+
+/**
+ * Returns the number of workers of a task pool
+ * @param pool the pool
+ * @return the number of workers
+ */
+size_t task_pool_get_thread_count(const struct task_pool * pool);
+
+/**
+ * Runs a task on the pool and waits for it and all tasks it forked to finish
+ * The calling thread takes part as the first worker, concurrent calls are serialized
+ * @param pool the pool
+ * @param task the task
+ * @param data the argument of the task
+ */
+void task_pool_run(struct task_pool * pool, task_f task, void * data);
+
+/**
+ * Runs two tasks, possibly in parallel, and waits for both to finish
+ * The second task is made available to other workers while the calling thread runs the first
+ * Outside of task_pool_run, or when the deque of the worker is full, both tasks run on the calling thread
+ * @param pool the pool
+ * @param first the first task
+ * @param first_data the argument of the first task
+ * @param second the second task
+ * @param second_data the argument of the second task
+ */
+void task_pool_fork_join(struct task_pool * pool, task_f first, void * first_data, task_f second, void * second_data);
+
+/**
+ * Stops the threads and releases all data of a task pool
+ * Does not free the pool struct itself
+ * @param pool the pool
+ */
+void task_pool_destroy(struct task_pool * pool);
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "memory.h"
+#include "unordered_map.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * The control byte of a slot that never held an entry, stops lookups
+ */
+#define EMPTY ((int8_t)-128)
+
+/**
+ * The control byte of a slot whose entry was deleted, lookups continue past it
+ * The control byte of a full slot is the 7 lowest bits of the hash of its key, so it is never negative.
+ */
+#define DELETED ((int8_t)-2)
+
+/**
+ * Returned by find_slot if no slot holds the key
+ */
+#define NOT_FOUND ((size_t)-1)
+
+static void default_free_key(struct unordered_map * map, void * key){}
+
+static void default_free_value(struct unordered_map * map, void * value){}
+
+/*
+ * Hash functions
+ */
+
+/**
+ * The finalizer of MurmurHash3, spreading every bit of the input over the output
+ */
+static inline uint64_t mix(uint64_t hash){
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t unordered_map_hash_string(const struct unordered_map * map, void * key){
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for(const unsigned char * c = (const unsigned char *)key; *c != '\0'; ++c){
+    hash ^= *c;
+    hash *= 0x100000001b3ULL;
+  }
+  return mix(hash);
+}
+
+bool unordered_map_equal_string(const struct unordered_map * map, void * first, void * second){
+  return strcmp((const char *)first, (const char *)second) == 0;
+}
+
+uint64_t unordered_map_hash_pointer(const struct unordered_map * map, void * key){
+  return mix((uint64_t)(uintptr_t)key);
+}
+
+bool unordered_map_equal_pointer(const struct unordered_map * map, void * first, void * second){
+  return first == second;
+}
+
+/*
+ * Groups
+ */
+
+#ifdef __SSE2__
+
+/**
+ * Returns a mask with bit i set if control byte i of a group equals a byte
+ */
+static inline uint32_t match_byte(const int8_t * group, int8_t byte){
+  __m128i control = _mm_load_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(byte)));
+}
+
+/**
+ * Returns a mask with bit i set if slot i of a group is empty or deleted
+ */
+static inline uint32_t match_free(const int8_t * group){
+  return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+}
+
+#else
+
+static inline uint32_t match_byte(const int8_t * group, int8_t byte){
+  uint32_t mask = 0;
+  for(size_t i = 0; i < UNORDERED_MAP_GROUP_SIZE; ++i){
+    mask |= (uint32_t)(group[i] == byte) << i;
+  }
+  return mask;
+}
+
+static inline uint32_t match_free(const int8_t * group){
+  uint32_t mask = 0;
+  for(size_t i = 0; i < UNORDERED_MAP_GROUP_SIZE; ++i){
+    mask |= (uint32_t)(group[i] < 0) << i;
+  }
+  return mask;
+}
+
+#endif
+
+/**
+ * The bits of a hash choosing the first group to probe
+ */
+static inline size_t get_position(uint64_t hash){
+  return (size_t)(hash >> 7);
+}
+
+/**
+ * The bits of a hash stored in the control byte
+ */
+static inline int8_t get_tag(uint64_t hash){
+  return (int8_t)(hash & 0x7f);
+}
+
+/**
+ * A sequence of groups to probe
+ * Steps grow by one group each time, which visits every group once since the number of groups is a power of two
+ */
+struct probe{
+  size_t group;
+  size_t mask;
+  size_t step;
+};
+
+static inline void start_probe(struct probe * probe, const struct unordered_map * map, uint64_t hash){
+  probe->mask = map->capacity / UNORDERED_MAP_GROUP_SIZE - 1;
+  probe->group = get_position(hash) & probe->mask;
+  probe->step = 0;
+}
+
+static inline void next_probe(struct probe * probe){
+  ++probe->step;
+  probe->group = (probe->group + probe->step) & probe->mask;
+}
+
+static inline const int8_t * get_group(const struct unordered_map * map, const struct probe * probe){
+  return map->control + probe->group * UNORDERED_MAP_GROUP_SIZE;
+}
+
+/**
+ * Finds the slot holding a key in a map with at least one group
+ * @return the index of the slot or NOT_FOUND
+ */
+static size_t find_slot(const struct unordered_map * map, void * key, uint64_t hash){
+  struct probe probe;
+  start_probe(&probe, map, hash);
+  int8_t tag = get_tag(hash);
+  for(;;){
+    const int8_t * group = get_group(map, &probe);
+    uint32_t matches = match_byte(group, tag);
+    while(matches != 0){
+      size_t index = probe.group * UNORDERED_MAP_GROUP_SIZE + (size_t)__builtin_ctz(matches);
+      if((*map->equal)(map, map->entries[index].key, key)){
+	return index;
+      }
+      matches &= matches - 1;
+    }
+    // an insert would have used this empty slot, so the key is not further along
+    if(match_byte(group, EMPTY) != 0){
+      return NOT_FOUND;
+    }
+    next_probe(&probe);
+  }
+}
+
+/**
+ * Finds the first empty or deleted slot along the probe sequence of a hash
+ */
+static size_t find_free_slot(const struct unordered_map * map, uint64_t hash){
+  struct probe probe;
+  start_probe(&probe, map, hash);
+  for(;;){
+    uint32_t free_slots = match_free(get_group(map, &probe));
+    if(free_slots != 0){
+      return probe.group * UNORDERED_MAP_GROUP_SIZE + (size_t)__builtin_ctz(free_slots);
+    }
+    next_probe(&probe);
+  }
+}
+
+/**
+ * Returns the number of entries a map may hold before it is rehashed, keeping at least an eighth of the slots empty
+ */
+static inline size_t get_max_load(size_t capacity){
+  return capacity - capacity / 8;
+}
+
+/**
+ * Moves all entries into new arrays of a capacity, dropping the deleted slots
+ */
+static void rehash(struct unordered_map * map, size_t capacity){
+  int8_t * control = map->control;
+  struct unordered_map_entry * entries = map->entries;
+  size_t old_capacity = map->capacity;
+
+  map->control = malloc_aligned_checked(UNORDERED_MAP_GROUP_SIZE, capacity);
+  memset(map->control, EMPTY, capacity);
+  map->entries = malloc_checked(capacity * sizeof(struct unordered_map_entry));
+  map->capacity = capacity;
+  map->growth_left = get_max_load(capacity) - map->size;
+  for(size_t i = 0; i < old_capacity; ++i){
+    if(control[i] >= 0){
+      uint64_t hash = (*map->hash)(map, entries[i].key);
+      size_t index = find_free_slot(map, hash);
+      map->control[index] = get_tag(hash);
+      map->entries[index] = entries[i];
+    }
+  }
+  free(control);
+  free(entries);
+}
+
+void unordered_map_init(struct unordered_map * map, unordered_map_hash_f hash, unordered_map_equal_f equal, unordered_map_free_f free_key, unordered_map_free_f free_value, void * state){
+  assert(map != NULL);
+  assert(hash != NULL);
+  assert(equal != NULL);
+  map->control = NULL;
+  map->entries = NULL;
+  map->capacity = 0;
+  map->size = 0;
+  map->growth_left = 0;
+  map->hash = hash;
+  map->equal = equal;
+  map->free_key = free_key == NULL ? default_free_key : free_key;
+  map->free_value = free_value == NULL ? default_free_value : free_value;
+  map->state = state;
+}
+
+bool unordered_map_insert(struct unordered_map * map, void * key, void * value){
+  assert(map != NULL);
+
+  uint64_t hash = (*map->hash)(map, key);
+  if(map->size != 0){
+    size_t index = find_slot(map, key, hash);
+    if(index != NOT_FOUND){
+      struct unordered_map_entry * entry = &map->entries[index];
+      (*map->free_key)(map, entry->key);
+      (*map->free_value)(map, entry->value);
+      entry->key = key;
+      entry->value = value;
+      return true;
+    }
+  }
+
+  size_t index = map->capacity == 0 ? NOT_FOUND : find_free_slot(map, hash);
+  if(index == NOT_FOUND || (map->growth_left == 0 && map->control[index] == EMPTY)){
+    // grow unless most of the load is deleted slots, which a rehash at the same capacity clears
+    size_t capacity = map->capacity == 0 ? UNORDERED_MAP_GROUP_SIZE : map->capacity;
+    if(map->size + 1 > get_max_load(capacity) / 2){
+      capacity *= 2;
+    }
+    rehash(map, capacity);
+    index = find_free_slot(map, hash);
+  }
+  if(map->control[index] == EMPTY){
+    --map->growth_left;
+  }
+  map->control[index] = get_tag(hash);
+  map->entries[index].key = key;
+  map->entries[index].value = value;
+  ++map->size;
+  return false;
+}
+
+bool unordered_map_delete(struct unordered_map * map, void * key){
+  assert(map != NULL);
+
+  if(map->size == 0){
+    return false;
+  }
+  size_t index = find_slot(map, key, (*map->hash)(map, key));
+  if(index == NOT_FOUND){
+    return false;
+  }
+  (*map->free_key)(map, map->entries[index].key);
+  (*map->free_value)(map, map->entries[index].value);
+  // lookups never probe past a group with an empty slot, so the slot can become empty again
+  if(match_byte(map->control + (index & ~(size_t)(UNORDERED_MAP_GROUP_SIZE - 1)), EMPTY) != 0){
+    map->control[index] = EMPTY;
+    ++map->growth_left;
+  }else{
+    map->control[index] = DELETED;
+  }
+  --map->size;
+  return true;
+}
+
+struct unordered_map_entry * unordered_map_find(const struct unordered_map * map, void * key){
+  assert(map != NULL);
+
+  if(map->size == 0){
+    return NULL;
+  }
+  size_t index = find_slot(map, key, (*map->hash)(map, key));
+  return index == NOT_FOUND ? NULL : &map->entries[index];
+}
+
+void * unordered_map_get(const struct unordered_map * map, void * key){
+  struct unordered_map_entry * entry = unordered_map_find(map, key);
+  return entry == NULL ? NULL : entry->value;
+}
+
+bool unordered_map_is_empty(const struct unordered_map * map){
+  assert(map != NULL);
+  return map->size == 0;
+}
+
+size_t unordered_map_size(const struct unordered_map * map){
+  assert(map != NULL);
+  return map->size;
+}
+
+void unordered_map_apply(struct unordered_map * map, unordered_map_apply_f apply){
+  assert(map != NULL);
+  assert(apply != NULL);
+  for(size_t i = 0; i < map->capacity; ++i){
+    if(map->control[i] >= 0){
+      (*apply)(map, &map->entries[i]);
+    }
+  }
+}
+
+static void free_entry(struct unordered_map * map, struct unordered_map_entry * entry){
+  (*map->free_key)(map, entry->key);
+  (*map->free_value)(map, entry->value);
+}
+
+void unordered_map_free(struct unordered_map * map){
+  assert(map != NULL);
+  if(map->free_key != default_free_key || map->free_value != default_free_value){
+    unordered_map_apply(map, &free_entry);
+  }
+  free(map->control);
+  free(map->entries);
+  map->control = NULL;
+  map->entries = NULL;
+  map->capacity = 0;
+  map->size = 0;
+  map->growth_left = 0;
+}
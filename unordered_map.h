@@ -0,0 +1,153 @@
+/*
+ * This file is part of Algorithms.
+ *
+ * Algorithms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Algorithms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Algorithms.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UNORDERED_MAP_H
+#define UNORDERED_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A hash map with open addressing, after the Swiss tables of Abseil
+ * Every slot has a control byte holding 7 bits of the hash of its key, or marking it empty or deleted.
+ * A lookup compares a group of 16 control bytes at once, with SSE2 where available,
+ * and only compares keys whose control byte matches, so it usually touches one group and one entry.
+ */
+
+/**
+ * The number of slots probed at once
+ */
+#define UNORDERED_MAP_GROUP_SIZE 16
+
+struct unordered_map;
+
+typedef uint64_t (*unordered_map_hash_f)(const struct unordered_map *, void *);
+
+typedef bool (*unordered_map_equal_f)(const struct unordered_map *, void *, void *);
+
+typedef void (*unordered_map_free_f)(struct unordered_map *, void *);
+
+/**
+ * An entry in an unordered map
+ * Entries are stored in an array that is reallocated as the map grows, a pointer to an entry remains valid until the next insert
+ */
+struct unordered_map_entry{
+  void * key;
+  void * value;
+};
+
+typedef void (*unordered_map_apply_f)(struct unordered_map *, struct unordered_map_entry *);
+
+/**
+ * An unordered map
+ */
+struct unordered_map{
+
+  /**
+   * The control bytes of the slots, aligned to a group
+   */
+  int8_t * control;
+
+  /**
+   * The entries of the slots
+   */
+  struct unordered_map_entry * entries;
+
+  /**
+   * The number of slots, 0 or a power of two not smaller than a group
+   */
+  size_t capacity;
+
+  /**
+   * The number of entries in the map
+   */
+  size_t size;
+
+  /**
+   * The number of empty slots that may still be filled before the map is rehashed
+   */
+  size_t growth_left;
+
+  unordered_map_hash_f hash;
+  unordered_map_equal_f equal;
+  unordered_map_free_f free_key;
+  unordered_map_free_f free_value;
+  void * state;
+};
+
+/**
+ * Hashes a null terminated string key
+ */
+uint64_t unordered_map_hash_string(const struct unordered_map * map, void * key);
+
+/**
+ * Compares null terminated string keys for equality
+ */
+bool unordered_map_equal_string(const struct unordered_map * map, void * first, void * second);
+
+/**
+ * Hashes the key pointer itself, for keys that are integers cast to pointers or pointers compared by identity
+ */
+uint64_t unordered_map_hash_pointer(const struct unordered_map * map, void * key);
+
+/**
+ * Compares key pointers for identity
+ */
+bool unordered_map_equal_pointer(const struct unordered_map * map, void * first, void * second);
+
+/**
+ * Initializes an empty map, which allocates no memory until the first insert
+ * @param map the map
+ * @param hash the hash function for keys
+ * @param equal the equality function for keys, equal keys must have equal hashes
+ * @param free_key the free function for keys or NULL
+ * @param free_value the free function for values or NULL
+ * @param state extra state for the map
+ */
+void unordered_map_init(struct unordered_map * map, unordered_map_hash_f hash, unordered_map_equal_f equal, unordered_map_free_f free_key, unordered_map_free_f free_value, void * state);
+
+/**
+ * Inserts an entry, replacing and freeing an entry with an equal key
+ * @return true if an entry was replaced
+ */
+bool unordered_map_insert(struct unordered_map * map, void * key, void * value);
+
+/**
+ * Deletes and frees the entry with a key
+ * @return true if an entry was deleted
+ */
+bool unordered_map_delete(struct unordered_map * map, void * key);
+
+struct unordered_map_entry * unordered_map_find(const struct unordered_map * map, void * key);
+
+void * unordered_map_get(const struct unordered_map * map, void * key);
+
+bool unordered_map_is_empty(const struct unordered_map * map);
+
+size_t unordered_map_size(const struct unordered_map * map);
+
+/**
+ * Applies a function to all entries in no particular order
+ * The function must not insert or delete entries
+ */
+void unordered_map_apply(struct unordered_map * map, unordered_map_apply_f apply);
+
+void unordered_map_free(struct unordered_map * map);
+
+#endif